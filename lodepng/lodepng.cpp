@@ -37,6 +37,17 @@ Rename this file to lodepng.cpp to use it for C++, or to lodepng.c to use it for
 #include <fstream>
 #endif /*LODEPNG_COMPILE_CPP*/
 
+#ifdef LODEPNG_COMPILE_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LODEPNG_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(LODEPNG_SSE2) && defined(__SSSE3__)
+#define LODEPNG_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif /*LODEPNG_COMPILE_SIMD*/
+
 #define VERSION_STRING "20141126"
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1310) /*Visual Studio: A few warning types are not desired here.*/
@@ -63,6 +74,8 @@ lodepng source code. Don't forget to remove "static" if you copypaste them
 from here.*/
 
 #ifdef LODEPNG_COMPILE_ALLOCATORS
+/*with only the statistics compiled in, nothing allocates*/
+#if defined(LODEPNG_COMPILE_ZLIB) || defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_DISK)
 static void* lodepng_malloc(size_t size)
 {
   return malloc(size);
@@ -77,12 +90,28 @@ static void lodepng_free(void* ptr)
 {
   free(ptr);
 }
+#endif /*defined(LODEPNG_COMPILE_ZLIB) || defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_DISK)*/
 #else /*LODEPNG_COMPILE_ALLOCATORS*/
 void* lodepng_malloc(size_t size);
 void* lodepng_realloc(void* ptr, size_t new_size);
 void lodepng_free(void* ptr);
 #endif /*LODEPNG_COMPILE_ALLOCATORS*/
 
+/*The allocations that can grow large name their LodePNGAllocSite, which only
+custom allocators can make use of, see LODEPNG_ALLOC_SITES in the header.*/
+#ifdef LODEPNG_ALLOC_SITES
+#ifdef LODEPNG_COMPILE_ALLOCATORS
+#error "LODEPNG_ALLOC_SITES needs custom allocators, define LODEPNG_NO_COMPILE_ALLOCATORS"
+#endif /*LODEPNG_COMPILE_ALLOCATORS*/
+void* lodepng_malloc_site(size_t size, LodePNGAllocSite site);
+void* lodepng_realloc_site(void* ptr, size_t new_size, LodePNGAllocSite site);
+#define lodepng_malloc_at(size, site) lodepng_malloc_site(size, site)
+#define lodepng_realloc_at(ptr, new_size, site) lodepng_realloc_site(ptr, new_size, site)
+#else /*LODEPNG_ALLOC_SITES*/
+#define lodepng_malloc_at(size, site) lodepng_malloc(size)
+#define lodepng_realloc_at(ptr, new_size, site) lodepng_realloc(ptr, new_size)
+#endif /*LODEPNG_ALLOC_SITES*/
+
 /* ////////////////////////////////////////////////////////////////////////// */
 /* ////////////////////////////////////////////////////////////////////////// */
 /* // Tools for C, and common code for PNG and Zlib.                       // */
@@ -126,6 +155,61 @@ Example: if(!uivector_resizev(&frequencies_ll, 286, 0)) ERROR_BREAK(83);
   return;\
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* / Statistics                                                             / */
+/* ////////////////////////////////////////////////////////////////////////// */
+
+void lodepng_stats_init(LodePNGStats* stats, double (*clock)(void))
+{
+  unsigned i;
+  stats->clock = clock;
+  stats->callback = 0;
+  stats->user = 0;
+  for(i = 0; i < LSP_NUM_PHASES; i++)
+  {
+    stats->time[i] = 0;
+    stats->bytes[i] = 0;
+    stats->count[i] = 0;
+  }
+}
+
+double lodepng_stats_clock(const LodePNGStats* stats)
+{
+  return (stats && stats->clock) ? stats->clock() : 0;
+}
+
+void lodepng_stats_add(LodePNGStats* stats, LodePNGStatsPhase phase, double start, size_t bytes)
+{
+  double end;
+  if(!stats || !stats->clock) return;
+  end = stats->clock();
+  stats->time[phase] += end - start;
+  stats->bytes[phase] += bytes;
+  stats->count[phase]++;
+  if(stats->callback) stats->callback(stats->user, phase, start, end, bytes);
+}
+
+void lodepng_stats_merge(LodePNGStats* dest, const LodePNGStats* source)
+{
+  unsigned i;
+  for(i = 0; i < LSP_NUM_PHASES; i++)
+  {
+    dest->time[i] += source->time[i];
+    dest->bytes[i] += source->bytes[i];
+    dest->count[i] += source->count[i];
+  }
+}
+
+const char* lodepng_stats_phase_name(LodePNGStatsPhase phase)
+{
+  static const char* names[LSP_NUM_PHASES] =
+  {
+    "read", "header", "inflate", "unfilter", "convert", "flip",
+    "check_type", "filter", "deflate", "crc", "write", "cache"
+  };
+  return (unsigned)phase < LSP_NUM_PHASES ? names[phase] : "unknown";
+}
+
 /*
 About uivector, ucvector and string:
 -All of them wrap dynamic arrays or text strings in a similar way.
@@ -157,7 +241,7 @@ static unsigned uivector_reserve(uivector* p, size_t allocsize)
   if(allocsize > p->allocsize)
   {
     size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
-    void* data = lodepng_realloc(p->data, newsize);
+    void* data = lodepng_realloc_at(p->data, newsize, LAS_VECTOR);
     if(data)
     {
       p->allocsize = newsize;
@@ -219,15 +303,17 @@ typedef struct ucvector
   unsigned char* data;
   size_t size; /*used size*/
   size_t allocsize; /*allocated size*/
+  LodePNGAllocSite site; /*what the memory is for, LAS_VECTOR unless set after init*/
 } ucvector;
 
+#if defined(LODEPNG_COMPILE_ZLIB) || defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)
 /*returns 1 if success, 0 if failure ==> nothing done*/
 static unsigned ucvector_reserve(ucvector* p, size_t allocsize)
 {
   if(allocsize > p->allocsize)
   {
     size_t newsize = (allocsize > p->allocsize * 2) ? allocsize : (allocsize * 3 / 2);
-    void* data = lodepng_realloc(p->data, newsize);
+    void* data = lodepng_realloc_at(p->data, newsize, p->site);
     if(data)
     {
       p->allocsize = newsize;
@@ -245,6 +331,7 @@ static unsigned ucvector_resize(ucvector* p, size_t size)
   p->size = size;
   return 1; /*success*/
 }
+#endif /*defined(LODEPNG_COMPILE_ZLIB) || defined(LODEPNG_COMPILE_PNG) || defined(LODEPNG_COMPILE_ENCODER)*/
 
 #ifdef LODEPNG_COMPILE_PNG
 
@@ -259,6 +346,7 @@ static void ucvector_init(ucvector* p)
 {
   p->data = NULL;
   p->size = p->allocsize = 0;
+  p->site = LAS_VECTOR;
 }
 
 #ifdef LODEPNG_COMPILE_DECODER
@@ -280,6 +368,7 @@ static void ucvector_init_buffer(ucvector* p, unsigned char* buffer, size_t size
 {
   p->data = buffer;
   p->allocsize = p->size = size;
+  p->site = LAS_VECTOR;
 }
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
@@ -1109,7 +1198,7 @@ static unsigned getTreeInflateDynamic(HuffmanTree* tree_ll, HuffmanTree* tree_d,
 
 /*inflate a block with dynamic of fixed Huffman tree*/
 static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size_t* bp,
-                                    size_t* pos, size_t inlength, unsigned btype)
+                                    size_t* pos, size_t inlength, unsigned btype, size_t stop)
 {
   unsigned error = 0;
   HuffmanTree tree_ll; /*the huffman tree for literal and length codes*/
@@ -1125,7 +1214,9 @@ static unsigned inflateHuffmanBlock(ucvector* out, const unsigned char* in, size
   while(!error) /*decode all symbols until end reached, breaks at end code*/
   {
     /*code_ll is literal, length or end code*/
-    unsigned code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
+    unsigned code_ll;
+    if(stop && *pos >= stop) break; /*enough is out, the rest of the block isn't needed*/
+    code_ll = huffmanDecodeSymbol(in, bp, &tree_ll, inbitlength);
     if(code_ll <= 255) /*literal symbol*/
     {
       /*ucvector_push_back would do the same, but for some reason the two lines below run 10% faster*/
@@ -1236,11 +1327,10 @@ static unsigned lodepng_inflatev(ucvector* out,
   size_t bp = 0;
   unsigned BFINAL = 0;
   size_t pos = 0; /*byte position in the out buffer*/
+  size_t stop = settings ? settings->stop_after : 0;
   unsigned error = 0;
 
-  (void)settings;
-
-  while(!BFINAL)
+  while(!BFINAL && !(stop && pos >= stop))
   {
     unsigned BTYPE;
     if(bp + 2 >= insize * 8) return 52; /*error, bit pointer will jump past memory*/
@@ -1250,7 +1340,7 @@ static unsigned lodepng_inflatev(ucvector* out,
 
     if(BTYPE == 3) return 20; /*error: invalid BTYPE*/
     else if(BTYPE == 0) error = inflateNoCompression(out, in, &bp, &pos, insize); /*no compression*/
-    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE); /*compression, BTYPE 01 or 10*/
+    else error = inflateHuffmanBlock(out, in, &bp, &pos, insize, BTYPE, stop); /*compression, BTYPE 01 or 10*/
 
     if(error) return error;
   }
@@ -1363,13 +1453,13 @@ typedef struct Hash
 static unsigned hash_init(Hash* hash, unsigned windowsize)
 {
   unsigned i;
-  hash->head = (int*)lodepng_malloc(sizeof(int) * HASH_NUM_VALUES);
-  hash->val = (int*)lodepng_malloc(sizeof(int) * windowsize);
-  hash->chain = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+  hash->head = (int*)lodepng_malloc_at(sizeof(int) * HASH_NUM_VALUES, LAS_HASH);
+  hash->val = (int*)lodepng_malloc_at(sizeof(int) * windowsize, LAS_HASH);
+  hash->chain = (unsigned short*)lodepng_malloc_at(sizeof(unsigned short) * windowsize, LAS_HASH);
 
-  hash->zeros = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
-  hash->headz = (int*)lodepng_malloc(sizeof(int) * (MAX_SUPPORTED_DEFLATE_LENGTH + 1));
-  hash->chainz = (unsigned short*)lodepng_malloc(sizeof(unsigned short) * windowsize);
+  hash->zeros = (unsigned short*)lodepng_malloc_at(sizeof(unsigned short) * windowsize, LAS_HASH);
+  hash->headz = (int*)lodepng_malloc_at(sizeof(int) * (MAX_SUPPORTED_DEFLATE_LENGTH + 1), LAS_HASH);
+  hash->chainz = (unsigned short*)lodepng_malloc_at(sizeof(unsigned short) * windowsize, LAS_HASH);
 
   if(!hash->head || !hash->chain || !hash->val  || !hash->headz|| !hash->chainz || !hash->zeros)
   {
@@ -2135,7 +2225,8 @@ unsigned lodepng_zlib_decompress(unsigned char** out, size_t* outsize, const uns
   error = inflate(out, outsize, in + 2, insize - 2, settings);
   if(error) return error;
 
-  if(!settings->ignore_adler32)
+  /*stopped early (stop_after), the checksum can't be checked*/
+  if(!settings->ignore_adler32 && !(settings->stop_after && *outsize >= settings->stop_after))
   {
     unsigned ADLER32 = lodepng_read32bitInt(&in[insize - 4]);
     unsigned checksum = adler32(*out, (unsigned)(*outsize));
@@ -2277,9 +2368,10 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings)
   settings->custom_zlib = 0;
   settings->custom_inflate = 0;
   settings->custom_context = 0;
+  settings->stop_after = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0, 0};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -2948,82 +3040,87 @@ static void addColorBits(unsigned char* out, size_t index, unsigned bits, unsign
   else out[index * bits / 8] |= in;
 }
 
-typedef struct ColorTree ColorTree;
+typedef struct ColorTable ColorTable;
 
 /*
-One node of a color tree
 This is the data structure used to count the number of unique colors and to get a palette
-index for a color. It's like an octree, but because the alpha channel is used too, each
-node has 16 instead of 8 children.
+index for a color. It's an open addressing hash table keyed on the 32-bit RGBA value, with
+linear probing. All slots are allocated at once in a flat array, sized for the maximum
+amount of colors it will hold so that it stays at most half full.
 */
-struct ColorTree
+struct ColorTable
 {
-  ColorTree* children[16]; /*up to 16 pointers to ColorTree of next level*/
-  int index; /*the payload. Only has a meaningful value if this is in the last level*/
+  unsigned* keys; /*RGBA packed into 32 bits*/
+  int* indices; /*the payload, -1 for an empty slot*/
+  unsigned mask; /*amount of slots minus one, the amount of slots is a power of two*/
 };
 
-static void color_tree_init(ColorTree* tree)
+static unsigned color_table_init(ColorTable* table, unsigned maxcolors)
 {
-  int i;
-  for(i = 0; i < 16; i++) tree->children[i] = 0;
-  tree->index = -1;
+  unsigned i, numslots = 16;
+  while(numslots < maxcolors * 2) numslots *= 2;
+  table->keys = (unsigned*)lodepng_malloc(numslots * sizeof(unsigned));
+  table->indices = (int*)lodepng_malloc(numslots * sizeof(int));
+  table->mask = numslots - 1;
+  if(!table->keys || !table->indices) return 83; /*alloc fail*/
+  for(i = 0; i < numslots; i++) table->indices[i] = -1;
+  return 0;
+}
+
+static void color_table_cleanup(ColorTable* table)
+{
+  lodepng_free(table->keys);
+  lodepng_free(table->indices);
+}
+
+static unsigned color_table_key(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+  return (unsigned)r | ((unsigned)g << 8) | ((unsigned)b << 16) | ((unsigned)a << 24);
 }
 
-static void color_tree_cleanup(ColorTree* tree)
+/*returns the slot of the color if present, or the empty slot where it has to be added*/
+static unsigned color_table_slot(const ColorTable* table, unsigned key)
 {
-  int i;
-  for(i = 0; i < 16; i++)
+  /*Fibonacci hashing, the high bits of the product are mixed best*/
+  unsigned slot = ((key * 2654435761u) & 0xffffffffu) >> 16;
+  for(;;)
   {
-    if(tree->children[i])
-    {
-      color_tree_cleanup(tree->children[i]);
-      lodepng_free(tree->children[i]);
-    }
+    slot &= table->mask;
+    if(table->indices[slot] < 0 || table->keys[slot] == key) return slot;
+    slot++;
   }
 }
 
 /*returns -1 if color not present, its index otherwise*/
-static int color_tree_get(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+static int color_table_get(const ColorTable* table,
+                           unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-  int bit = 0;
-  for(bit = 0; bit < 8; bit++)
-  {
-    int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-    if(!tree->children[i]) return -1;
-    else tree = tree->children[i];
-  }
-  return tree ? tree->index : -1;
+  return table->indices[color_table_slot(table, color_table_key(r, g, b, a))];
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
-static int color_tree_has(ColorTree* tree, unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+static int color_table_has(const ColorTable* table,
+                           unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
-  return color_tree_get(tree, r, g, b, a) >= 0;
+  return color_table_get(table, r, g, b, a) >= 0;
 }
 #endif /*LODEPNG_COMPILE_ENCODER*/
 
-/*color is not allowed to already exist.
-Index should be >= 0 (it's signed to be compatible with using -1 for "doesn't exist")*/
-static void color_tree_add(ColorTree* tree,
-                           unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
+/*The table must have been inited for enough colors. If the color is already present its
+index is replaced. Index should be >= 0 (it's signed to be compatible with using -1 for
+"doesn't exist")*/
+static void color_table_add(ColorTable* table,
+                            unsigned char r, unsigned char g, unsigned char b, unsigned char a, unsigned index)
 {
-  int bit;
-  for(bit = 0; bit < 8; bit++)
-  {
-    int i = 8 * ((r >> bit) & 1) + 4 * ((g >> bit) & 1) + 2 * ((b >> bit) & 1) + 1 * ((a >> bit) & 1);
-    if(!tree->children[i])
-    {
-      tree->children[i] = (ColorTree*)lodepng_malloc(sizeof(ColorTree));
-      color_tree_init(tree->children[i]);
-    }
-    tree = tree->children[i];
-  }
-  tree->index = (int)index;
+  unsigned key = color_table_key(r, g, b, a);
+  unsigned slot = color_table_slot(table, key);
+  table->keys[slot] = key;
+  table->indices[slot] = (int)index;
 }
 
 /*put a pixel, given its RGBA color, into image of any color type*/
 static unsigned rgba8ToPixel(unsigned char* out, size_t i,
-                             const LodePNGColorMode* mode, ColorTree* tree /*for palette*/,
+                             const LodePNGColorMode* mode, const ColorTable* table /*for palette*/,
                              unsigned char r, unsigned char g, unsigned char b, unsigned char a)
 {
   if(mode->colortype == LCT_GREY)
@@ -3055,7 +3152,7 @@ static unsigned rgba8ToPixel(unsigned char* out, size_t i,
   }
   else if(mode->colortype == LCT_PALETTE)
   {
-    int index = color_tree_get(tree, r, g, b, a);
+    int index = color_table_get(table, r, g, b, a);
     if(index < 0) return 82; /*color not in palette*/
     if(mode->bitdepth == 8) out[i] = index;
     else addColorBits(out, i, mode->bitdepth, (unsigned)index);
@@ -3414,30 +3511,157 @@ static void getPixelColorRGBA16(unsigned short* r, unsigned short* g, unsigned s
   }
 }
 
+/*
+Specialized kernels for the 8-bit conversions that are by far the most common in
+practice (decoding to RGB/RGBA, and dropping the alpha channel). They give the
+same result as getPixelColorsRGBA8 for inputs without color key. Each one does the
+bulk with SSE2/SSSE3 if available and finishes the remaining pixels one by one.
+*/
+static void convertRGB8ToRGBA8(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  size_t i = 0;
+#ifdef LODEPNG_SSSE3
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000u);
+  /*16 bytes are loaded for every 4 pixels, so stay 2 pixels away from the end of the input*/
+  for(; i + 6 <= numpixels; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 3));
+    v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+    _mm_storeu_si128((__m128i*)(out + i * 4), v);
+  }
+#endif /*LODEPNG_SSSE3*/
+  for(; i < numpixels; i++)
+  {
+    out[i * 4 + 0] = in[i * 3 + 0];
+    out[i * 4 + 1] = in[i * 3 + 1];
+    out[i * 4 + 2] = in[i * 3 + 2];
+    out[i * 4 + 3] = 255;
+  }
+}
+
+static void convertRGBA8ToRGB8(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  size_t i = 0;
+#ifdef LODEPNG_SSSE3
+  const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  /*16 bytes are stored for every 4 pixels, the 4 extra ones are overwritten by the next
+  iteration or the tail loop, so stay 2 pixels away from the end of the output*/
+  for(; i + 6 <= numpixels; i += 4)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 4));
+    _mm_storeu_si128((__m128i*)(out + i * 3), _mm_shuffle_epi8(v, shuffle));
+  }
+#endif /*LODEPNG_SSSE3*/
+  for(; i < numpixels; i++)
+  {
+    out[i * 3 + 0] = in[i * 4 + 0];
+    out[i * 3 + 1] = in[i * 4 + 1];
+    out[i * 3 + 2] = in[i * 4 + 2];
+  }
+}
+
+static void convertGrey8ToRGBA8(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  size_t i = 0;
+#ifdef LODEPNG_SSE2
+  const __m128i opaque = _mm_set1_epi8(-1);
+  for(; i + 16 <= numpixels; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i gg_lo = _mm_unpacklo_epi8(v, v); /*grey, grey*/
+    __m128i gg_hi = _mm_unpackhi_epi8(v, v);
+    __m128i ga_lo = _mm_unpacklo_epi8(v, opaque); /*grey, 255*/
+    __m128i ga_hi = _mm_unpackhi_epi8(v, opaque);
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 0), _mm_unpacklo_epi16(gg_lo, ga_lo));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_unpackhi_epi16(gg_lo, ga_lo));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 32), _mm_unpacklo_epi16(gg_hi, ga_hi));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 48), _mm_unpackhi_epi16(gg_hi, ga_hi));
+  }
+#endif /*LODEPNG_SSE2*/
+  for(; i < numpixels; i++)
+  {
+    out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i];
+    out[i * 4 + 3] = 255;
+  }
+}
+
+static void convertGreyAlpha8ToRGBA8(unsigned char* out, const unsigned char* in, size_t numpixels)
+{
+  size_t i = 0;
+#ifdef LODEPNG_SSE2
+  const __m128i lowbyte = _mm_set1_epi16(0x00ff);
+  for(; i + 8 <= numpixels; i += 8)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 2)); /*grey, alpha*/
+    __m128i g = _mm_and_si128(v, lowbyte);
+    __m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8)); /*grey, grey*/
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 0), _mm_unpacklo_epi16(gg, v));
+    _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_unpackhi_epi16(gg, v));
+  }
+#endif /*LODEPNG_SSE2*/
+  for(; i < numpixels; i++)
+  {
+    out[i * 4 + 0] = out[i * 4 + 1] = out[i * 4 + 2] = in[i * 2 + 0];
+    out[i * 4 + 3] = in[i * 2 + 1];
+  }
+}
+
+/*returns 1 if one of the specialized kernels above did the conversion, 0 if the
+generic code must be used*/
+static unsigned convertFast8(unsigned char* out, const unsigned char* in,
+                             const LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
+                             size_t numpixels)
+{
+  if(mode_in->bitdepth != 8 || mode_out->bitdepth != 8) return 0;
+
+  if(mode_out->colortype == LCT_RGB && mode_in->colortype == LCT_RGBA)
+  {
+    convertRGBA8ToRGB8(out, in, numpixels);
+    return 1;
+  }
+
+  if(mode_out->colortype != LCT_RGBA || mode_in->key_defined) return 0;
+
+  if(mode_in->colortype == LCT_RGB) convertRGB8ToRGBA8(out, in, numpixels);
+  else if(mode_in->colortype == LCT_GREY) convertGrey8ToRGBA8(out, in, numpixels);
+  else if(mode_in->colortype == LCT_GREY_ALPHA) convertGreyAlpha8ToRGBA8(out, in, numpixels);
+  else return 0;
+  return 1;
+}
+
 unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
                          LodePNGColorMode* mode_out, const LodePNGColorMode* mode_in,
                          unsigned w, unsigned h)
 {
   size_t i;
-  ColorTree tree;
+  ColorTable table = {0, 0, 0}; /*only used for palette output*/
   size_t numpixels = w * h;
 
   if(lodepng_color_mode_equal(mode_out, mode_in))
   {
     size_t numbytes = lodepng_get_raw_size(w, h, mode_in);
-    for(i = 0; i < numbytes; i++) out[i] = in[i];
+    memcpy(out, in, numbytes);
     return 0;
   }
 
+  if(convertFast8(out, in, mode_out, mode_in, numpixels)) return 0;
+
   if(mode_out->colortype == LCT_PALETTE)
   {
     size_t palsize = 1u << mode_out->bitdepth;
+    unsigned error;
     if(mode_out->palettesize < palsize) palsize = mode_out->palettesize;
-    color_tree_init(&tree);
+    error = color_table_init(&table, (unsigned)palsize);
+    if(error)
+    {
+      color_table_cleanup(&table);
+      return error;
+    }
     for(i = 0; i < palsize; i++)
     {
       unsigned char* p = &mode_out->palette[i * 4];
-      color_tree_add(&tree, p[0], p[1], p[2], p[3], i);
+      color_table_add(&table, p[0], p[1], p[2], p[3], i);
     }
   }
 
@@ -3464,16 +3688,16 @@ unsigned lodepng_convert(unsigned char* out, const unsigned char* in,
     for(i = 0; i < numpixels; i++)
     {
       getPixelColorRGBA8(&r, &g, &b, &a, in, i, mode_in);
-      rgba8ToPixel(out, i, mode_out, &tree, r, g, b, a);
+      rgba8ToPixel(out, i, mode_out, &table, r, g, b, a);
     }
   }
 
   if(mode_out->colortype == LCT_PALETTE)
   {
-    color_tree_cleanup(&tree);
+    color_table_cleanup(&table);
   }
 
-  return 0; /*no error (this function currently never has one, but maybe OOM detection added later.)*/
+  return 0; /*no error*/
 }
 
 #ifdef LODEPNG_COMPILE_ENCODER
@@ -3510,6 +3734,135 @@ static unsigned getValueRequiredBits(unsigned char value)
   return 8;
 }
 
+/*returns 1 if any 16-bit sample of the raw image has a different high and low byte*/
+static unsigned getSixteenBitsRequired(const unsigned char* in, size_t numbytes)
+{
+  size_t i = 0;
+#ifdef LODEPNG_SSE2
+  const __m128i highbyte = _mm_set1_epi16((short)0xff00);
+  for(; i + 16 <= numbytes; i += 16)
+  {
+    __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+    __m128i diff = _mm_and_si128(_mm_xor_si128(v, _mm_slli_epi16(v, 8)), highbyte);
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff) return 1;
+  }
+#endif /*LODEPNG_SSE2*/
+  for(; i + 1 < numbytes; i += 2)
+  {
+    if(in[i] != in[i + 1]) return 1;
+  }
+  return 0;
+}
+
+/*
+Determines the colored, alpha and key properties of the profile for 8-bit RGB or RGBA
+input without color key, in wide lanes. Stops as soon as the image is known to be colored
+and to need a full alpha channel. The key is only usable if all alpha values are 0 or 255,
+all transparent pixels have the same RGB, and no opaque pixel has that RGB.
+*/
+static void getColorProfileRGB8(LodePNGColorProfile* profile, const unsigned char* in,
+                                size_t numpixels, unsigned has_alpha)
+{
+  size_t i = 0;
+  size_t keystart = 0; /*index from which pixels were compared with the key*/
+  unsigned colored = 0, alpha = 0, key = 0;
+  unsigned char key_r = 0, key_g = 0, key_b = 0;
+
+  if(!has_alpha)
+  {
+#ifdef LODEPNG_SSE2
+    /*5 pixels per 16 byte load, only the red positions are compared with green and blue*/
+    const __m128i redmask = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, 0);
+    for(; i + 6 <= numpixels; i += 5)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 3));
+      __m128i diff = _mm_or_si128(_mm_xor_si128(v, _mm_srli_si128(v, 1)), _mm_xor_si128(v, _mm_srli_si128(v, 2)));
+      diff = _mm_and_si128(diff, redmask);
+      if(_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xffff) break;
+    }
+#endif /*LODEPNG_SSE2*/
+    for(; i < numpixels; i++)
+    {
+      if(in[i * 3 + 0] != in[i * 3 + 1] || in[i * 3 + 0] != in[i * 3 + 2])
+      {
+        colored = 1;
+        break;
+      }
+    }
+    profile->colored = colored;
+    return;
+  }
+
+#ifdef LODEPNG_SSE2
+  {
+    const __m128i lowbyte = _mm_set1_epi32(255);
+    const __m128i rgbmask = _mm_set1_epi32(0x00ffffff);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i keyv = zero;
+    for(; i + 4 <= numpixels; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 4));
+      __m128i a = _mm_srli_epi32(v, 24);
+      __m128i transparent = _mm_cmpeq_epi32(a, zero);
+      if(!colored)
+      {
+        __m128i diff = _mm_or_si128(_mm_xor_si128(v, _mm_srli_epi32(v, 8)), _mm_xor_si128(v, _mm_srli_epi32(v, 16)));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(diff, lowbyte), zero)) != 0xffff) colored = 1;
+      }
+      if(!alpha)
+      {
+        __m128i binary = _mm_or_si128(transparent, _mm_cmpeq_epi32(a, lowbyte));
+        int tmask = _mm_movemask_ps(_mm_castsi128_ps(transparent));
+        if(_mm_movemask_epi8(binary) != 0xffff) alpha = 1;
+        else if(!key && tmask)
+        {
+          const unsigned char* p = in + (i + (tmask & 1 ? 0 : tmask & 2 ? 1 : tmask & 4 ? 2 : 3)) * 4;
+          key = 1;
+          key_r = p[0]; key_g = p[1]; key_b = p[2];
+          keyv = _mm_set1_epi32((int)color_table_key(key_r, key_g, key_b, 0));
+          keystart = i;
+        }
+        if(key && !alpha)
+        {
+          /*transparent pixels must have the key color, opaque ones must not*/
+          __m128i matchkey = _mm_cmpeq_epi32(_mm_and_si128(v, rgbmask), keyv);
+          if(_mm_movemask_epi8(_mm_xor_si128(matchkey, transparent))) alpha = 1;
+        }
+      }
+      if(colored && alpha) break;
+    }
+  }
+#endif /*LODEPNG_SSE2*/
+
+  for(; i < numpixels && !(colored && alpha); i++)
+  {
+    const unsigned char* p = in + i * 4;
+    if(p[0] != p[1] || p[0] != p[2]) colored = 1;
+    if(alpha) continue;
+    if(p[3] != 0 && p[3] != 255) alpha = 1;
+    else if(!key && p[3] == 0)
+    {
+      key = 1;
+      key_r = p[0]; key_g = p[1]; key_b = p[2];
+      keystart = i;
+    }
+    if(key && !alpha && (p[3] == 0) != (p[0] == key_r && p[1] == key_g && p[2] == key_b)) alpha = 1;
+  }
+
+  /*the opaque pixels before the first transparent one must not have the key color either*/
+  for(i = 0; key && !alpha && i < keystart; i++)
+  {
+    if(in[i * 4 + 0] == key_r && in[i * 4 + 1] == key_g && in[i * 4 + 2] == key_b) alpha = 1;
+  }
+
+  profile->colored = colored;
+  profile->alpha = alpha;
+  profile->key = key;
+  profile->key_r = key_r;
+  profile->key_g = key_g;
+  profile->key_b = key_b;
+}
+
 /*profile must already have been inited with mode.
 It's ok to set some parameters of profile to done already.*/
 unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
@@ -3518,7 +3871,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 {
   unsigned error = 0;
   size_t i;
-  ColorTree tree;
+  ColorTable table;
   size_t numpixels = w * h;
 
   unsigned colored_done = lodepng_is_greyscale_type(mode) ? 1 : 0;
@@ -3530,22 +3883,17 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
   unsigned sixteen = 0;
   if(bpp <= 8) maxnumcolors = bpp == 1 ? 2 : (bpp == 2 ? 4 : (bpp == 4 ? 16 : 256));
 
-  color_tree_init(&tree);
+  error = color_table_init(&table, maxnumcolors);
+  if(error)
+  {
+    color_table_cleanup(&table);
+    return error;
+  }
 
   /*Check if the 16-bit input is truly 16-bit*/
   if(mode->bitdepth == 16)
   {
-    unsigned short r, g, b, a;
-    for(i = 0; i < numpixels; i++)
-    {
-      getPixelColorRGBA16(&r, &g, &b, &a, in, i, mode);
-      if((r & 255u) != ((r >> 8) & 255u) || (g & 255u) != ((g >> 8) & 255u) ||
-         (b & 255u) != ((b >> 8) & 255u) || (a & 255u) != ((a >> 8) & 255u)) /*first and second byte differ*/
-      {
-        sixteen = 1;
-        break;
-      }
-    }
+    sixteen = getSixteenBitsRequired(in, lodepng_get_raw_size(w, h, mode));
   }
 
   if(sixteen)
@@ -3593,6 +3941,15 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
   }
   else /* < 16-bit */
   {
+    if(mode->bitdepth == 8 && !mode->key_defined && !profile->colored && !profile->alpha && !profile->key
+       && (mode->colortype == LCT_RGB || mode->colortype == LCT_RGBA))
+    {
+      /*only the color counting and the greyscale bits are left for the per pixel loop*/
+      getColorProfileRGB8(profile, in, numpixels, mode->colortype == LCT_RGBA);
+      colored_done = alpha_done = 1;
+      if((profile->colored || profile->alpha) && profile->bits < 8) profile->bits = 8;
+    }
+
     for(i = 0; i < numpixels; i++)
     {
       unsigned char r = 0, g = 0, b = 0, a = 0;
@@ -3604,7 +3961,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
         unsigned bits = getValueRequiredBits(r);
         if(bits > profile->bits) profile->bits = bits;
       }
-      bits_done = (profile->bits >= bpp);
+      bits_done = (profile->bits >= bpp || profile->bits >= 8);
 
       if(!colored_done && (r != g || r != b))
       {
@@ -3640,9 +3997,9 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
 
       if(!numcolors_done)
       {
-        if(!color_tree_has(&tree, r, g, b, a))
+        if(!color_table_has(&table, r, g, b, a))
         {
-          color_tree_add(&tree, r, g, b, a, profile->numcolors);
+          color_table_add(&table, r, g, b, a, profile->numcolors);
           if(profile->numcolors < 256)
           {
             unsigned char* p = profile->palette;
@@ -3666,7 +4023,7 @@ unsigned lodepng_get_color_profile(LodePNGColorProfile* profile,
     profile->key_b += (profile->key_b << 8);
   }
 
-  color_tree_cleanup(&tree);
+  color_table_cleanup(&table);
   return error;
 }
 
@@ -4429,17 +4786,17 @@ static unsigned readChunk_pHYs(LodePNGInfo* info, const unsigned char* data, siz
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
-static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
-                          LodePNGState* state,
-                          const unsigned char* in, size_t insize)
+/*reads the header and all chunks into state->info_png, and the IDAT data into idat,
+unless idat is 0*/
+static void readChunks(ucvector* idat, unsigned* w, unsigned* h,
+                       LodePNGState* state,
+                       const unsigned char* in, size_t insize)
 {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
-  ucvector idat; /*the data from idat chunks*/
-  ucvector scanlines;
-  size_t predict;
   size_t numpixels;
+  double start = lodepng_stats_clock(state->stats);
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4447,11 +4804,9 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   unsigned critical_pos = 1; /*1 = after IHDR, 2 = after PLTE, 3 = after IDAT*/
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
 
-  /*provide some proper output values if error will happen*/
-  *out = 0;
-
   state->error = lodepng_inspect(w, h, state, in, insize); /*reads header and resets other parameters in state->info_png*/
   if(state->error) return;
+  lodepng_stats_add(state->stats, LSP_HEADER, start, 33);
 
   numpixels = *w * *h;
 
@@ -4461,7 +4816,6 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   bytes with 16-bit RGBA, the rest is room for filter bytes.*/
   if(numpixels > 268435455) CERROR_RETURN(state->error, 92);
 
-  ucvector_init(&idat);
   chunk = &in[33]; /*first byte of the first chunk after the header*/
 
   /*loop through the chunks, ignoring unknown chunks and stopping at IEND chunk.
@@ -4489,9 +4843,9 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     /*IDAT chunk, containing compressed image data*/
     if(lodepng_chunk_type_equals(chunk, "IDAT"))
     {
-      size_t oldsize = idat.size;
-      if(!ucvector_resize(&idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
-      for(i = 0; i < chunkLength; i++) idat.data[oldsize + i] = data[i];
+      size_t oldsize = idat ? idat->size : 0;
+      if(idat && !ucvector_resize(idat, oldsize + chunkLength)) CERROR_BREAK(state->error, 83 /*alloc fail*/);
+      for(i = 0; idat && i < chunkLength; i++) idat->data[oldsize + i] = data[i];
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
       critical_pos = 3;
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
@@ -4577,15 +4931,48 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
     }
 
-    if(!state->decoder.ignore_crc && !unknown) /*check CRC if wanted, only on known chunk types*/
+    /*check CRC if wanted, only on known chunk types, and on IDAT only if it is read*/
+    if(!state->decoder.ignore_crc && !unknown && (idat || !lodepng_chunk_type_equals(chunk, "IDAT")))
     {
+      start = lodepng_stats_clock(state->stats);
       if(lodepng_chunk_check_crc(chunk)) CERROR_BREAK(state->error, 57); /*invalid CRC*/
+      lodepng_stats_add(state->stats, LSP_CRC, start, chunkLength + 4);
     }
 
     if(!IEND) chunk = lodepng_chunk_next_const(chunk);
   }
+}
+
+unsigned lodepng_inspect_chunks(unsigned* w, unsigned* h, LodePNGState* state,
+                                const unsigned char* in, size_t insize)
+{
+  readChunks(0, w, h, state, in, insize);
+  return state->error;
+}
+
+/*reads the chunks and inflates the IDAT data into scanlines, which still have the filter
+bytes, padding bits and (if interlaced) the 7 reduced images. scanlines must be cleaned up
+by the caller, also on error.*/
+static void decodeScanlines(ucvector* scanlines, unsigned* w, unsigned* h,
+                            LodePNGState* state,
+                            const unsigned char* in, size_t insize)
+{
+  ucvector idat; /*the data from idat chunks*/
+  size_t predict;
+  double start;
+
+  ucvector_init(scanlines);
+  scanlines->site = LAS_SCANLINES;
+  ucvector_init(&idat);
+  idat.site = LAS_IDAT;
+
+  readChunks(&idat, w, h, state, in, insize);
+  if(state->error)
+  {
+    ucvector_cleanup(&idat);
+    return;
+  }
 
-  ucvector_init(&scanlines);
   /*predict output size, to allocate exact size for output buffer to avoid more dynamic allocation.
   If the decompressed size does not match the prediction, the image must be corrupt.*/
   if(state->info_png.interlace_method == 0)
@@ -4606,27 +4993,338 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
     if(*w > 1) predict += lodepng_get_raw_size_idat((*w + 0) / 2, (*h + 1) / 2, color) + (*h + 1) / 2;
     predict += lodepng_get_raw_size_idat((*w + 0) / 1, (*h + 0) / 2, color) + (*h + 0) / 2;
   }
-  if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
+  if(!state->error && !ucvector_reserve(scanlines, predict)) state->error = 83; /*alloc fail*/
   if(!state->error)
   {
-    state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
+    start = lodepng_stats_clock(state->stats);
+    state->error = zlib_decompress(&scanlines->data, &scanlines->size, idat.data,
                                    idat.size, &state->decoder.zlibsettings);
-    if(!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
+    if(!state->error && scanlines->size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
+    lodepng_stats_add(state->stats, LSP_INFLATE, start, scanlines->size);
   }
   ucvector_cleanup(&idat);
+}
+
+static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
+                          LodePNGState* state,
+                          const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  double start;
+
+  /*provide some proper output values if error will happen*/
+  *out = 0;
+
+  decodeScanlines(&scanlines, w, h, state, in, insize);
 
   if(!state->error)
   {
     size_t outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
     ucvector outv;
+    start = lodepng_stats_clock(state->stats);
     ucvector_init(&outv);
+    outv.site = LAS_IMAGE;
     if(!ucvector_resizev(&outv, outsize, 0)) state->error = 83; /*alloc fail*/
     if(!state->error) state->error = postProcessScanlines(outv.data, scanlines.data, *w, *h, &state->info_png);
     *out = outv.data;
+    lodepng_stats_add(state->stats, LSP_UNFILTER, start, outsize);
   }
   ucvector_cleanup(&scanlines);
 }
 
+/*the part of lodepng_decode_into after inflating: each row of the final image is
+written once, to out + y * stride, in the color type of state->info_raw. in is the
+scanlines buffer, and is overwritten.*/
+static unsigned postProcessRows(unsigned char* out, long stride, unsigned char* in,
+                                unsigned w, unsigned h, LodePNGState* state)
+{
+  const LodePNGColorMode* mode_in = &state->info_png.color;
+  unsigned bpp = lodepng_get_bpp(mode_in);
+  size_t linebytes = (w * bpp + 7) / 8;
+  size_t rowbytes = lodepng_get_raw_size(w, 1, &state->info_raw);
+  unsigned same = lodepng_color_mode_equal(&state->info_raw, mode_in);
+  unsigned char* image = 0; /*deinterlaced image, for Adam7*/
+  unsigned char* padded = 0; /*the same with each row starting at a byte, if bpp < 8*/
+  const unsigned char* rows;
+  unsigned char* prevline = 0;
+  unsigned error = 0;
+  unsigned y;
+  double start = lodepng_stats_clock(state->stats);
+
+  if(bpp == 0) return 31; /*error: invalid colortype*/
+
+  if(state->info_png.interlace_method == 0 && same)
+  {
+    /*nothing to convert: unfilter straight into the output rows*/
+    for(y = 0; y < h; y++)
+    {
+      unsigned char* row = out + (long)y * stride;
+      size_t inindex = (1 + linebytes) * y;
+      CERROR_TRY_RETURN(unfilterScanline(row, &in[inindex + 1], prevline, (bpp + 7) / 8, in[inindex], linebytes));
+      prevline = row;
+    }
+    lodepng_stats_add(state->stats, LSP_UNFILTER, start, linebytes * h);
+    return 0;
+  }
+
+  if(state->info_png.interlace_method == 0)
+  {
+    /*unfilter in place, the rows then start at a byte and are linebytes apart*/
+    CERROR_TRY_RETURN(unfilter(in, in, w, h, bpp));
+    rows = in;
+  }
+  else
+  {
+    size_t size = lodepng_get_raw_size(w, h, mode_in);
+    image = (unsigned char*)lodepng_malloc_at(size, LAS_IMAGE);
+    if(!image) return 83; /*alloc fail*/
+    memset(image, 0, size); /*Adam7_deinterlace needs zeros if bpp < 8*/
+    error = postProcessScanlines(image, in, w, h, &state->info_png);
+    rows = image;
+
+    if(!error && (w * bpp) % 8 != 0)
+    {
+      /*the deinterlaced rows aren't byte aligned, move them apart*/
+      size_t ibp = 0, obp, x;
+      padded = (unsigned char*)lodepng_malloc_at(linebytes * h, LAS_IMAGE);
+      if(!padded) error = 83; /*alloc fail*/
+      for(y = 0; !error && y < h; y++)
+      {
+        obp = y * linebytes * 8;
+        for(x = 0; x < w * bpp; x++) setBitOfReversedStream(&obp, padded, readBitFromReversedStream(&ibp, image));
+      }
+      rows = padded;
+    }
+  }
+  lodepng_stats_add(state->stats, LSP_UNFILTER, start, linebytes * h);
+
+  start = lodepng_stats_clock(state->stats);
+  for(y = 0; !error && y < h; y++)
+  {
+    unsigned char* row = out + (long)y * stride;
+    if(same) memcpy(row, &rows[linebytes * y], rowbytes);
+    else error = lodepng_convert(row, &rows[linebytes * y], &state->info_raw, mode_in, w, 1);
+  }
+  lodepng_stats_add(state->stats, LSP_CONVERT, start, rowbytes * h);
+
+  lodepng_free(image);
+  lodepng_free(padded);
+  return error;
+}
+
+unsigned lodepng_decode_into(unsigned char* out, long stride, unsigned w, unsigned h,
+                             LodePNGState* state,
+                             const unsigned char* in, size_t insize)
+{
+  ucvector scanlines;
+  unsigned pngw, pngh;
+
+  decodeScanlines(&scanlines, &pngw, &pngh, state, in, insize);
+  if(!state->error && (pngw != w || pngh != h)) state->error = 94;
+  if(!state->error && !state->decoder.color_convert)
+  {
+    /*the output gets the color type of the PNG, as with lodepng_decode*/
+    state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+  }
+  if(!state->error && !lodepng_color_mode_equal(&state->info_raw, &state->info_png.color)
+     && !(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+     && !(state->info_raw.bitdepth == 8))
+  {
+    state->error = 56; /*unsupported color mode conversion*/
+  }
+  if(!state->error) state->error = postProcessRows(out, stride, scanlines.data, w, h, state);
+  ucvector_cleanup(&scanlines);
+  return state->error;
+}
+
+/*the pixels known after the first passes of Adam7: every ADAM7_GRID_X[passes]-th pixel of
+every ADAM7_GRID_Y[passes]-th row, from the top left (index 0 is not used)*/
+static const unsigned ADAM7_GRID_X[8] = { 8, 8, 4, 4, 2, 2, 1, 1 };
+static const unsigned ADAM7_GRID_Y[8] = { 8, 8, 8, 4, 4, 2, 2, 1 };
+
+/*copies pixel number ipixel of in to pixel number opixel of out, images without padding bits*/
+static void copyPixel(unsigned char* out, size_t opixel, const unsigned char* in, size_t ipixel, unsigned bpp)
+{
+  if(bpp % 8 == 0) memcpy(&out[opixel * (bpp / 8)], &in[ipixel * (bpp / 8)], bpp / 8);
+  else
+  {
+    size_t ibp = ipixel * bpp, obp = opixel * bpp;
+    unsigned b;
+    for(b = 0; b < bpp; b++) setBitOfReversedStream(&obp, out, readBitFromReversedStream(&ibp, in));
+  }
+}
+
+/*the pixel grid of lodepng_decode_preview, in the color type of the PNG. For an Adam7
+image only the data of the first passes is inflated and unfiltered.*/
+static unsigned char* decodePreviewGrid(unsigned* gw, unsigned* gh, unsigned* w, unsigned* h,
+                                        LodePNGState* state, const unsigned char* in, size_t insize,
+                                        unsigned passes)
+{
+  const LodePNGColorMode* color = &state->info_png.color;
+  unsigned sx = ADAM7_GRID_X[passes], sy = ADAM7_GRID_Y[passes];
+  unsigned bpp, i, x, y;
+  unsigned char* grid = 0;
+  unsigned char* image = 0;
+  ucvector idat, scanlines;
+  LodePNGDecompressSettings zlibsettings;
+  unsigned passw[7], passh[7];
+  size_t filter_passstart[8], padded_passstart[8], passstart[8];
+  double start;
+
+  if(lodepng_inspect(w, h, state, in, insize)) return 0;
+  bpp = lodepng_get_bpp(color);
+  *gw = (*w + sx - 1) / sx;
+  *gh = (*h + sy - 1) / sy;
+
+  if(state->info_png.interlace_method == 0)
+  {
+    /*the rows are one after the other, nothing can be left out: decode all, keep the grid*/
+    decodeGeneric(&image, w, h, state, in, insize);
+    if(sx == 1 && sy == 1) return image; /*the grid is the whole image*/
+    if(!state->error) grid = (unsigned char*)lodepng_malloc_at(lodepng_get_raw_size(*gw, *gh, color), LAS_IMAGE);
+    if(!state->error && !grid) state->error = 83; /*alloc fail*/
+    if(grid) memset(grid, 0, lodepng_get_raw_size(*gw, *gh, color));
+    for(y = 0; grid && y < *gh; y++)
+    for(x = 0; x < *gw; x++)
+    {
+      copyPixel(grid, (size_t)y * *gw + x, image, (size_t)y * sy * *w + x * sx, bpp);
+    }
+    lodepng_free(image);
+    return grid;
+  }
+
+  ucvector_init(&idat);
+  idat.site = LAS_IDAT;
+  ucvector_init(&scanlines);
+  scanlines.site = LAS_SCANLINES;
+  readChunks(&idat, w, h, state, in, insize);
+
+  if(!state->error)
+  {
+    /*the passes are one after the other in the inflated data, only the first ones are needed*/
+    Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, *w, *h, bpp);
+    zlibsettings = state->decoder.zlibsettings;
+    /*all 7 passes are the whole stream: inflated to the end, with its checksum*/
+    if(passes < 7) zlibsettings.stop_after = filter_passstart[passes];
+    if(!ucvector_reserve(&scanlines, filter_passstart[passes])) state->error = 83; /*alloc fail*/
+  }
+  if(!state->error)
+  {
+    start = lodepng_stats_clock(state->stats);
+    state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data, idat.size, &zlibsettings);
+    if(!state->error && scanlines.size < filter_passstart[passes]) state->error = 91; /*too little data*/
+    lodepng_stats_add(state->stats, LSP_INFLATE, start, scanlines.size);
+  }
+  ucvector_cleanup(&idat);
+
+  if(!state->error)
+  {
+    start = lodepng_stats_clock(state->stats);
+    grid = (unsigned char*)lodepng_malloc_at(lodepng_get_raw_size(*gw, *gh, color), LAS_IMAGE);
+    if(!grid) state->error = 83; /*alloc fail*/
+    else memset(grid, 0, lodepng_get_raw_size(*gw, *gh, color));
+
+    for(i = 0; !state->error && i < passes; i++)
+    {
+      unsigned char* data = scanlines.data;
+      state->error = unfilter(&data[padded_passstart[i]], &data[filter_passstart[i]], passw[i], passh[i], bpp);
+      if(state->error) break;
+      if(bpp < 8)
+      {
+        removePaddingBits(&data[passstart[i]], &data[padded_passstart[i]], passw[i] * bpp,
+                          ((passw[i] * bpp + 7) / 8) * 8, passh[i]);
+      }
+      /*every pixel of these passes is on the grid*/
+      for(y = 0; y < passh[i]; y++)
+      for(x = 0; x < passw[i]; x++)
+      {
+        size_t gx = (ADAM7_IX[i] + x * ADAM7_DX[i]) / sx, gy = (ADAM7_IY[i] + y * ADAM7_DY[i]) / sy;
+        copyPixel(grid, gy * *gw + gx, &data[passstart[i]], (size_t)y * passw[i] + x, bpp);
+      }
+    }
+    lodepng_stats_add(state->stats, LSP_UNFILTER, start, lodepng_get_raw_size(*gw, *gh, color));
+  }
+  ucvector_cleanup(&scanlines);
+
+  if(state->error)
+  {
+    lodepng_free(grid);
+    grid = 0;
+  }
+  return grid;
+}
+
+unsigned lodepng_decode_preview(unsigned char** out, unsigned* w, unsigned* h,
+                                LodePNGState* state,
+                                const unsigned char* in, size_t insize,
+                                unsigned passes, unsigned upsample)
+{
+  unsigned char* grid;
+  unsigned pngw, pngh, gw, gh, bpp, x, y, sx, sy;
+  size_t rowbytes;
+  double start;
+
+  *out = 0;
+  passes = passes < 1 ? 1 : (passes > 7 ? 7 : passes);
+  sx = ADAM7_GRID_X[passes];
+  sy = ADAM7_GRID_Y[passes];
+  grid = decodePreviewGrid(&gw, &gh, &pngw, &pngh, state, in, insize, passes);
+  if(state->error) return state->error;
+
+  /*the color type of the output, as with lodepng_decode*/
+  if(!state->decoder.color_convert)
+  {
+    state->error = lodepng_color_mode_copy(&state->info_raw, &state->info_png.color);
+  }
+  else if(!lodepng_color_mode_equal(&state->info_raw, &state->info_png.color))
+  {
+    unsigned char* converted;
+    start = lodepng_stats_clock(state->stats);
+    if(!(state->info_raw.colortype == LCT_RGB || state->info_raw.colortype == LCT_RGBA)
+       && !(state->info_raw.bitdepth == 8))
+    {
+      state->error = 56; /*unsupported color mode conversion*/
+    }
+    converted = state->error ? 0 : (unsigned char*)lodepng_malloc_at(lodepng_get_raw_size(gw, gh, &state->info_raw),
+                                                                     LAS_IMAGE);
+    if(!state->error && !converted) state->error = 83; /*alloc fail*/
+    if(!state->error) state->error = lodepng_convert(converted, grid, &state->info_raw, &state->info_png.color, gw, gh);
+    lodepng_free(grid);
+    grid = converted;
+    lodepng_stats_add(state->stats, LSP_CONVERT, start, lodepng_get_raw_size(gw, gh, &state->info_raw));
+  }
+
+  if(state->error || !upsample || (sx == 1 && sy == 1))
+  {
+    if(state->error) lodepng_free(grid);
+    else
+    {
+      *out = grid;
+      *w = gw;
+      *h = gh;
+    }
+    return state->error;
+  }
+
+  /*each pixel of the grid fills the sx by sy block below and right of it*/
+  start = lodepng_stats_clock(state->stats);
+  bpp = lodepng_get_bpp(&state->info_raw);
+  rowbytes = lodepng_get_raw_size(pngw, 1, &state->info_raw);
+  *out = (unsigned char*)lodepng_malloc_at(lodepng_get_raw_size(pngw, pngh, &state->info_raw), LAS_IMAGE);
+  if(!(*out)) state->error = 83; /*alloc fail*/
+  else memset(*out, 0, lodepng_get_raw_size(pngw, pngh, &state->info_raw));
+  for(y = 0; *out && y < pngh; y++)
+  {
+    if(y % sy != 0 && bpp % 8 == 0) memcpy(*out + y * rowbytes, *out + (y - 1) * rowbytes, rowbytes);
+    else for(x = 0; x < pngw; x++) copyPixel(*out, (size_t)y * pngw + x, grid, (size_t)(y / sy) * gw + x / sx, bpp);
+  }
+  lodepng_stats_add(state->stats, LSP_CONVERT, start, lodepng_get_raw_size(pngw, pngh, &state->info_raw));
+  lodepng_free(grid);
+  *w = pngw;
+  *h = pngh;
+  return state->error;
+}
+
 unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize)
@@ -4650,6 +5348,7 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     /*color conversion needed; sort of copy of the data*/
     unsigned char* data = *out;
     size_t outsize;
+    double start = lodepng_stats_clock(state->stats);
 
     /*TODO: check if this works according to the statement in the documentation: "The converter can convert
     from greyscale input color type, to 8-bit greyscale or greyscale with alpha"*/
@@ -4660,7 +5359,7 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     }
 
     outsize = lodepng_get_raw_size(*w, *h, &state->info_raw);
-    *out = (unsigned char*)lodepng_malloc(outsize);
+    *out = (unsigned char*)lodepng_malloc_at(outsize, LAS_IMAGE);
     if(!(*out))
     {
       state->error = 83; /*alloc fail*/
@@ -4668,6 +5367,7 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
     else state->error = lodepng_convert(*out, data, &state->info_raw,
                                         &state->info_png.color, *w, *h);
     lodepng_free(data);
+    lodepng_stats_add(state->stats, LSP_CONVERT, start, outsize);
   }
   return state->error;
 }
@@ -4744,6 +5444,7 @@ void lodepng_state_init(LodePNGState* state)
 #endif /*LODEPNG_COMPILE_ENCODER*/
   lodepng_color_mode_init(&state->info_raw);
   lodepng_info_init(&state->info_png);
+  state->stats = 0;
   state->error = 1;
 }
 
@@ -4876,15 +5577,20 @@ static unsigned addChunk_tRNS(ucvector* out, const LodePNGColorMode* info)
 }
 
 static unsigned addChunk_IDAT(ucvector* out, const unsigned char* data, size_t datasize,
-                              LodePNGCompressSettings* zlibsettings)
+                              LodePNGCompressSettings* zlibsettings, LodePNGStats* stats)
 {
   ucvector zlibdata;
   unsigned error = 0;
+  double start = lodepng_stats_clock(stats);
 
   /*compress with the Zlib compressor*/
   ucvector_init(&zlibdata);
   error = zlib_compress(&zlibdata.data, &zlibdata.size, data, datasize, zlibsettings);
+  lodepng_stats_add(stats, LSP_DEFLATE, start, zlibdata.size);
+  /*creating the chunk is mostly computing its CRC*/
+  start = lodepng_stats_clock(stats);
   if(!error) error = addChunk(out, "IDAT", zlibdata.data, zlibdata.size);
+  lodepng_stats_add(stats, LSP_CRC, start, zlibdata.size + 4);
   ucvector_cleanup(&zlibdata);
 
   return error;
@@ -5432,7 +6138,7 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
   if(info_png->interlace_method == 0)
   {
     *outsize = h + (h * ((w * bpp + 7) / 8)); /*image size plus an extra byte per scanline + possible padding bits*/
-    *out = (unsigned char*)lodepng_malloc(*outsize);
+    *out = (unsigned char*)lodepng_malloc_at(*outsize, LAS_SCANLINES);
     if(!(*out) && (*outsize)) error = 83; /*alloc fail*/
 
     if(!error)
@@ -5440,7 +6146,7 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
       /*non multiple of 8 bits per scanline, padding bits needed per scanline*/
       if(bpp < 8 && w * bpp != ((w * bpp + 7) / 8) * 8)
       {
-        unsigned char* padded = (unsigned char*)lodepng_malloc(h * ((w * bpp + 7) / 8));
+        unsigned char* padded = (unsigned char*)lodepng_malloc_at(h * ((w * bpp + 7) / 8), LAS_SCANLINES);
         if(!padded) error = 83; /*alloc fail*/
         if(!error)
         {
@@ -5465,10 +6171,10 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
     Adam7_getpassvalues(passw, passh, filter_passstart, padded_passstart, passstart, w, h, bpp);
 
     *outsize = filter_passstart[7]; /*image size plus an extra byte per scanline + possible padding bits*/
-    *out = (unsigned char*)lodepng_malloc(*outsize);
+    *out = (unsigned char*)lodepng_malloc_at(*outsize, LAS_SCANLINES);
     if(!(*out)) error = 83; /*alloc fail*/
 
-    adam7 = (unsigned char*)lodepng_malloc(passstart[7]);
+    adam7 = (unsigned char*)lodepng_malloc_at(passstart[7], LAS_SCANLINES);
     if(!adam7 && passstart[7]) error = 83; /*alloc fail*/
 
     if(!error)
@@ -5480,7 +6186,7 @@ static unsigned preProcessScanlines(unsigned char** out, size_t* outsize, const
       {
         if(bpp < 8)
         {
-          unsigned char* padded = (unsigned char*)lodepng_malloc(padded_passstart[i + 1] - padded_passstart[i]);
+          unsigned char* padded = (unsigned char*)lodepng_malloc_at(padded_passstart[i + 1] - padded_passstart[i], LAS_SCANLINES);
           if(!padded) ERROR_BREAK(83); /*alloc fail*/
           addPaddingBits(padded, &adam7[passstart[i]],
                          ((passw[i] * bpp + 7) / 8) * 8, passw[i] * bpp, passh[i]);
@@ -5552,6 +6258,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
   ucvector outv;
   unsigned char* data = 0; /*uncompressed version of the IDAT chunk data*/
   size_t datasize = 0;
+  double start;
 
   /*provide some proper output values if error will happen*/
   *out = 0;
@@ -5568,6 +6275,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     return state->error;
   }
 
+  start = lodepng_stats_clock(state->stats);
   if(state->encoder.auto_convert)
   {
     state->error = lodepng_auto_choose_color(&info.color, image, w, h, &state->info_raw);
@@ -5593,16 +6301,25 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     unsigned char* converted;
     size_t size = (w * h * lodepng_get_bpp(&info.color) + 7) / 8;
 
-    converted = (unsigned char*)lodepng_malloc(size);
+    converted = (unsigned char*)lodepng_malloc_at(size, LAS_IMAGE);
     if(!converted && size) state->error = 83; /*alloc fail*/
     if(!state->error)
     {
       state->error = lodepng_convert(converted, image, &info.color, &state->info_raw, w, h);
     }
+    lodepng_stats_add(state->stats, LSP_CONVERT, start, size);
+    start = lodepng_stats_clock(state->stats);
     if(!state->error) preProcessScanlines(&data, &datasize, converted, w, h, &info, &state->encoder);
     lodepng_free(converted);
   }
-  else preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+  else
+  {
+    /*only choosing the color type, if auto_convert is on*/
+    lodepng_stats_add(state->stats, LSP_CONVERT, start, 0);
+    start = lodepng_stats_clock(state->stats);
+    preProcessScanlines(&data, &datasize, image, w, h, &info, &state->encoder);
+  }
+  lodepng_stats_add(state->stats, LSP_FILTER, start, datasize);
 
   ucvector_init(&outv);
   while(!state->error) /*while only executed once, to break on error*/
@@ -5654,7 +6371,7 @@ unsigned lodepng_encode(unsigned char** out, size_t* outsize,
     }
 #endif /*LODEPNG_COMPILE_ANCILLARY_CHUNKS*/
     /*IDAT (multiple IDAT chunks must be consecutive)*/
-    state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings);
+    state->error = addChunk_IDAT(&outv, data, datasize, &state->encoder.zlibsettings, state->stats);
     if(state->error) break;
 #ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
     /*tIME*/
@@ -5905,6 +6622,7 @@ const char* lodepng_error_text(unsigned code)
     case 91: return "invalid decompressed idat size";
     case 92: return "too many pixels, not supported";
     case 93: return "zero width or height is invalid";
+    case 94: return "lodepng_decode_into: the given size is not the size of the image";
   }
   return "unknown error code";
 }
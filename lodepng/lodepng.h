@@ -69,9 +69,18 @@ the custom_zlib field of the compress and decompress settings*/
 #ifndef LODEPNG_NO_COMPILE_ERROR_TEXT
 #define LODEPNG_COMPILE_ERROR_TEXT
 #endif
+/*SSE2/SSSE3 fast paths for the common 8-bit color conversions. They are only used
+when the compiler targets those instruction sets (e.g. x86-64, or -mssse3), the
+portable loops are used otherwise.*/
+#ifndef LODEPNG_NO_COMPILE_SIMD
+#define LODEPNG_COMPILE_SIMD
+#endif
 /*Compile the default allocators (C's free, malloc and realloc). If you disable this,
 you can define the functions lodepng_free, lodepng_malloc and lodepng_realloc in your
-source files with custom allocators.*/
+source files with custom allocators. If you also define LODEPNG_ALLOC_SITES, the
+allocations that can grow large call lodepng_malloc_site and lodepng_realloc_site
+instead, which then have to be defined as well, and which are told what the memory
+is for (see LodePNGAllocSite), e.g. for accounting.*/
 #ifndef LODEPNG_NO_COMPILE_ALLOCATORS
 #define LODEPNG_COMPILE_ALLOCATORS
 #endif
@@ -82,6 +91,66 @@ source files with custom allocators.*/
 #endif
 #endif
 
+/*The phases of decoding and encoding (and of a program around it) that LodePNGStats keeps apart.*/
+typedef enum LodePNGStatsPhase
+{
+  LSP_READ = 0, /*reading the input file, not done by LodePNG itself*/
+  LSP_HEADER = 1, /*parsing the header*/
+  LSP_INFLATE = 2, /*decompressing the IDAT data*/
+  LSP_UNFILTER = 3, /*unfiltering and deinterlacing the scanlines*/
+  LSP_CONVERT = 4, /*color conversion, including choosing the color type when encoding with auto_convert*/
+  LSP_FLIP = 5, /*flipping the rows or swapping the channels, not done by LodePNG itself*/
+  LSP_CHECK_TYPE = 6, /*telling what kind of image it is, not done by LodePNG itself*/
+  LSP_FILTER = 7, /*filtering and interlacing the scanlines*/
+  LSP_DEFLATE = 8, /*compressing the IDAT data*/
+  LSP_CRC = 9, /*checking or generating the chunk CRCs*/
+  LSP_WRITE = 10, /*writing the output file, not done by LodePNG itself*/
+  LSP_CACHE = 11, /*hashing the input and using a conversion cache, not done by LodePNG itself*/
+  LSP_NUM_PHASES = 12
+} LodePNGStatsPhase;
+
+/*
+Time spent and bytes produced per phase. Let the stats field of a LodePNGState point to
+one of these to have lodepng_decode and lodepng_encode add to it, the totals then sum
+up over all images decoded or encoded with it. LodePNG has no portable clock of its own,
+so it only measures if the clock is set. With stats NULL the cost is one test per phase.
+*/
+typedef struct LodePNGStats
+{
+  double (*clock)(void); /*returns the time in seconds, preferably from a monotonic clock*/
+  double time[LSP_NUM_PHASES]; /*total seconds spent in each phase*/
+  size_t bytes[LSP_NUM_PHASES]; /*total bytes output by each phase (for LSP_CRC: bytes checksummed)*/
+  unsigned count[LSP_NUM_PHASES]; /*how many times each phase ran*/
+  /*if set, called at the end of every phase with its start and end time, e.g. to record
+  a trace. user is passed on to it and not used by LodePNG otherwise*/
+  void (*callback)(void* user, LodePNGStatsPhase phase, double start, double end, size_t bytes);
+  void* user;
+} LodePNGStats;
+
+/*sets the totals to zero, the clock to the given function (which may be NULL) and no callback*/
+void lodepng_stats_init(LodePNGStats* stats, double (*clock)(void));
+/*the current time of the clock of stats, or 0 if stats is NULL or has no clock*/
+double lodepng_stats_clock(const LodePNGStats* stats);
+/*adds the time since start (a value returned by lodepng_stats_clock) and the bytes to a phase*/
+void lodepng_stats_add(LodePNGStats* stats, LodePNGStatsPhase phase, double start, size_t bytes);
+/*adds the totals of source to those of dest, e.g. to sum up the stats of several threads*/
+void lodepng_stats_merge(LodePNGStats* dest, const LodePNGStats* source);
+/*short lowercase name of a phase, such as "inflate" or "check_type"*/
+const char* lodepng_stats_phase_name(LodePNGStatsPhase phase);
+
+/*What an allocation is for, passed to lodepng_malloc_site and lodepng_realloc_site if
+LODEPNG_ALLOC_SITES is defined. Everything not listed here goes through lodepng_malloc.*/
+typedef enum LodePNGAllocSite
+{
+  LAS_OTHER = 0, /*small allocations: huffman trees, palettes, text, ...*/
+  LAS_VECTOR = 1, /*the growing vectors of the zlib encoder and decoder, and the PNG file itself*/
+  LAS_HASH = 2, /*the LZ77 hash tables of the encoder*/
+  LAS_IDAT = 3, /*the compressed image data, gathered from the IDAT chunks when decoding*/
+  LAS_SCANLINES = 4, /*the filtered scanlines, before compression or after decompression*/
+  LAS_IMAGE = 5, /*the decoded image, or a color converted copy of the image*/
+  LAS_NUM_SITES = 6
+} LodePNGAllocSite;
+
 #ifdef LODEPNG_COMPILE_PNG
 /*The PNG color types (also used for raw).*/
 typedef enum LodePNGColorType
@@ -265,6 +334,11 @@ struct LodePNGDecompressSettings
                              const LodePNGDecompressSettings*);
 
   const void* custom_context; /*optional custom settings for custom functions*/
+
+  /*if not 0, inflating stops once this many bytes are out (default: 0). The rest of the
+  data is neither decompressed nor checked, the Adler32 checksum included. Not used by
+  custom_zlib and custom_inflate.*/
+  size_t stop_after;
 };
 
 extern const LodePNGDecompressSettings lodepng_default_decompress_settings;
@@ -625,6 +699,7 @@ typedef struct LodePNGState
 #endif /*LODEPNG_COMPILE_ENCODER*/
   LodePNGColorMode info_raw; /*specifies the format in which you would like to get the raw pixel buffer*/
   LodePNGInfo info_png; /*info of the PNG image obtained after decoding*/
+  LodePNGStats* stats; /*if not NULL, decoding and encoding add their time and bytes per phase to it*/
   unsigned error;
 #ifdef LODEPNG_COMPILE_CPP
   //For the lodepng::State subclass.
@@ -647,6 +722,38 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize);
 
+/*
+Same as lodepng_decode, but decodes into a buffer given by the caller instead of
+allocating one, for example straight into a file mapping. w and h must be the size
+of the image (see lodepng_inspect). Row y goes to out + y * stride, in the color type
+of state->info_raw, and takes lodepng_get_raw_size(w, 1, &state->info_raw) bytes.
+A negative stride stores the image bottom-up: out then points to the first row of
+the image, which is the last one in memory. Each row is written once; without
+interlacing or color conversion it is unfiltered right into its place.
+*/
+unsigned lodepng_decode_into(unsigned char* out, long stride, unsigned w, unsigned h,
+                             LodePNGState* state,
+                             const unsigned char* in, size_t insize);
+
+/*
+Decodes a small preview of the image, for thumbnails: the pixels that are known after
+the first passes (1 to 7) of Adam7 interlacing. That is every 8th pixel of every 8th row
+after pass 1, every 4th of every 8th after pass 2, every 4th of every 4th after pass 3,
+every 2nd of every 4th after pass 4, every 2nd of every 2nd after pass 5, every pixel of
+every 2nd row after pass 6, and the whole image after pass 7, counted from the top left.
+If upsample is 0, out is just those pixels, and w and h are the size of that small image.
+Else out is the full size image, with each of them filling the block down and right of
+it (as a browser shows an interlaced PNG while it loads), and w and h are the size of the
+PNG. The color type of out is that of lodepng_decode.
+For an Adam7 PNG, only the data of those passes is inflated and unfiltered, which after
+pass 1 is 1/64 of the pixels. A PNG without interlacing is decoded whole, then the same
+pixels are taken from it.
+*/
+unsigned lodepng_decode_preview(unsigned char** out, unsigned* w, unsigned* h,
+                                LodePNGState* state,
+                                const unsigned char* in, size_t insize,
+                                unsigned passes, unsigned upsample);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the header chunk of the PNG, such as width, height and color type. The
@@ -655,6 +762,15 @@ information is placed in the info_png field of the LodePNGState.
 unsigned lodepng_inspect(unsigned* w, unsigned* h,
                          LodePNGState* state,
                          const unsigned char* in, size_t insize);
+
+/*
+Like lodepng_inspect, but reads all chunks (palette, transparency, text...) into
+info_png, only the image data itself is not decoded (nor its CRCs checked). For
+deciding the output of lodepng_decode_into from what the PNG contains.
+*/
+unsigned lodepng_inspect_chunks(unsigned* w, unsigned* h,
+                                LodePNGState* state,
+                                const unsigned char* in, size_t insize);
 #endif /*LODEPNG_COMPILE_DECODER*/
 
 
@@ -1560,6 +1676,24 @@ yyyymmdd.
 Some changes aren't backwards compatible. Those are indicated with a (!)
 symbol.
 
+*) 19 okt 2026: lodepng_decode_preview: decodes only the first passes of an Adam7
+    image, for thumbnails. LodePNGDecompressSettings stop_after stops inflating once
+    enough data is out.
+*) 19 okt 2026: lodepng_decode_into: decode into a caller's buffer with any row
+    stride, also negative for bottom-up images. lodepng_inspect_chunks reads all
+    chunks but not the image.
+*) 19 okt 2026: LSP_CACHE phase, for programs that cache conversions.
+*) 19 okt 2026: LODEPNG_ALLOC_SITES: custom allocators can be told what the large
+    allocations are for (vectors, hash tables, idat, scanlines, image).
+*) 19 okt 2026: LodePNGStats can call back at the end of every phase, for tracing.
+*) 19 okt 2026: LodePNGStats: optional time and byte counts per phase of decoding
+    and encoding, through the new stats field of LodePNGState.
+*) 19 okt 2026: Vectorized color profile pass for 8-bit RGB/RGBA and 16-bit input,
+    with early exit once every reducible property is ruled out.
+*) 19 okt 2026: Replaced the 16-ary color tree used for palette lookup and color
+    counting by a flat open addressing hash table.
+*) 19 okt 2026: SSE2/SSSE3 fast paths in lodepng_convert for RGB8<->RGBA8,
+    grey8 and grey-alpha8 to RGBA8. Equal color modes are copied with memcpy.
 *) 23 aug 2014: Reduced needless memory usage of decoder.
 *) 28 jun 2014: Removed fix_png setting, always support palette OOB for
     simplicity. Made ColorProfile public.
@@ -0,0 +1,402 @@
+/*
+ * lodepng_microbench.cpp - times the kernels of lodepng, one at a time
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The lodepng library it measures is by Lode Vandevenne, see "lodepng.h"
+ * for its license and copyright. The lodepng library URL is:
+ * <http://lodev.org/lodepng/>.
+ */
+
+//g++ lodepng_microbench.cpp -Wall -Wextra -std=c++11 -O3
+//g++ lodepng_microbench.cpp -Wall -Wextra -std=c++11 -O3 && ./a.out --reps 31 --filter convert
+
+/*
+Times the individual kernels of lodepng (checksums, huffman decoding, the
+scanline filters, LZ77 match finding and the color conversions) in isolation,
+so a change to one of them can be measured without the noise of a whole
+encode or decode. Unlike lodepng_benchmark.cpp this needs no SDL: it uses
+std::chrono::steady_clock and includes lodepng.cpp itself, which makes the
+static functions reachable. Every kernel is run a few times to warm up the
+caches, then timed for a number of repetitions; the median, the 10th and
+90th percentile and the throughput at the median are reported.
+*/
+
+#include "lodepng.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_WARMUP 3 //untimed runs of each kernel before the measurement
+#define NUM_REPS 15 //default number of timed runs, change with --reps
+
+//size of the synthetic test image, 2048x512 RGBA is 4 MiB
+static const unsigned W = 2048;
+static const unsigned H = 512;
+
+static int num_reps = NUM_REPS;
+static std::string name_filter;
+static bool json = false;
+static bool first_result = true;
+
+//the kernels write their results here so the compiler can't throw them away
+static volatile unsigned sink;
+
+////////////////////////////////////////////////////////////////////////////////
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+  double pos = p * (sorted.size() - 1);
+  size_t lo = (size_t)pos;
+  size_t hi = lo + 1 < sorted.size() ? lo + 1 : lo;
+  return sorted[lo] + (sorted[hi] - sorted[lo]) * (pos - lo);
+}
+
+static void report(const std::string& name, size_t bytes, std::vector<double>& times)
+{
+  std::sort(times.begin(), times.end());
+  double median = percentile(times, 0.5);
+  double p10 = percentile(times, 0.1);
+  double p90 = percentile(times, 0.9);
+  double mbps = median > 0 ? bytes / median / 1000000.0 : 0;
+
+  if(json)
+  {
+    printf("%s\n  {\"kernel\": \"%s\", \"bytes\": %lu, \"reps\": %d, "
+           "\"median_us\": %.2f, \"p10_us\": %.2f, \"p90_us\": %.2f, \"mb_per_s\": %.1f}",
+           first_result ? "" : ",", name.c_str(), (unsigned long)bytes, (int)times.size(),
+           median * 1e6, p10 * 1e6, p90 * 1e6, mbps);
+  }
+  else
+  {
+    printf("%-28s %10.2f %10.2f %10.2f %10.1f\n", name.c_str(), median * 1e6, p10 * 1e6, p90 * 1e6, mbps);
+  }
+  first_result = false;
+}
+
+//runs f NUM_WARMUP times untimed, then num_reps times timed. bytes is the amount
+//of data one call of f processes, used for the throughput.
+template<typename F>
+static void bench(const std::string& name, size_t bytes, F f)
+{
+  if(!name_filter.empty() && name.find(name_filter) == std::string::npos) return;
+
+  for(int i = 0; i < NUM_WARMUP; i++) f();
+
+  std::vector<double> times;
+  for(int i = 0; i < num_reps; i++)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    times.push_back(std::chrono::duration<double>(end - start).count());
+  }
+
+  report(name, bytes, times);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+//a smooth gradient with a little noise, roughly what a texture looks like
+static void generateImage(std::vector<unsigned char>& image, unsigned w, unsigned h)
+{
+  unsigned seed = 12345;
+  image.resize(w * h * 4);
+  for(unsigned y = 0; y < h; y++)
+  for(unsigned x = 0; x < w; x++)
+  {
+    size_t i = 4 * (y * w + x);
+    seed = seed * 1103515245u + 12345u;
+    unsigned noise = (seed >> 16) & 7;
+    image[i + 0] = (unsigned char)((x * 255 / w + noise) & 255);
+    image[i + 1] = (unsigned char)((y * 255 / h + noise) & 255);
+    image[i + 2] = (unsigned char)(((x + y) * 127 / (w + h) + noise) & 255);
+    image[i + 3] = (unsigned char)(255 - ((x / 64) & 1) * noise);
+  }
+}
+
+static void benchChecksums(const std::vector<unsigned char>& image)
+{
+  const unsigned char* data = &image[0];
+  unsigned size = (unsigned)image.size();
+
+  bench("crc32", size, [&]() { sink = lodepng_crc32(data, size); });
+  bench("adler32", size, [&]() { sink = adler32(data, size); });
+}
+
+static void benchHuffman(const std::vector<unsigned char>& image)
+{
+  //encode the bytes of the image as fixed tree literals, which gives a stream
+  //of codes of 8 and 9 bits, and decode them symbol by symbol
+  const size_t numsymbols = 1 << 20;
+  HuffmanTree tree;
+  ucvector stream;
+  size_t bp = 0;
+
+  HuffmanTree_init(&tree);
+  generateFixedLitLenTree(&tree);
+  ucvector_init(&stream);
+  for(size_t i = 0; i < numsymbols; i++)
+  {
+    unsigned symbol = image[i];
+    addHuffmanSymbol(&bp, &stream, HuffmanTree_getCode(&tree, symbol), HuffmanTree_getLength(&tree, symbol));
+  }
+  size_t inbitlength = bp;
+
+  bench("huffmanDecodeSymbol", numsymbols, [&]()
+  {
+    size_t pos = 0;
+    unsigned sum = 0;
+    for(size_t i = 0; i < numsymbols; i++) sum += huffmanDecodeSymbol(stream.data, &pos, &tree, inbitlength);
+    sink = sum;
+  });
+
+  ucvector_cleanup(&stream);
+  HuffmanTree_cleanup(&tree);
+
+  //whole inflate of a filtered image, once with fixed and once with dynamic blocks
+  for(unsigned btype = 1; btype <= 2; btype++)
+  {
+    LodePNGCompressSettings compress;
+    LodePNGDecompressSettings decompress;
+    unsigned char* deflated = 0;
+    size_t deflatedsize = 0;
+
+    lodepng_compress_settings_init(&compress);
+    lodepng_decompress_settings_init(&decompress);
+    compress.btype = btype;
+    if(lodepng_deflate(&deflated, &deflatedsize, &image[0], image.size(), &compress))
+    {
+      std::cout << "deflate failed" << std::endl;
+      continue;
+    }
+
+    bench(btype == 1 ? "inflate fixed" : "inflate dynamic", image.size(), [&]()
+    {
+      unsigned char* out = 0;
+      size_t outsize = 0;
+      sink = lodepng_inflate(&out, &outsize, deflated, deflatedsize, &decompress);
+      free(out);
+    });
+
+    free(deflated);
+  }
+}
+
+static void benchFilters(const std::vector<unsigned char>& image)
+{
+  const size_t linebytes = W * 4;
+  std::vector<unsigned char> out(image.size());
+
+  for(unsigned char type = 0; type < 5; type++)
+  {
+    std::string name = std::string("filterScanline ") + (char)('0' + type);
+    bench(name, image.size(), [&]()
+    {
+      for(unsigned y = 0; y < H; y++)
+      {
+        const unsigned char* prevline = y ? &image[(y - 1) * linebytes] : 0;
+        filterScanline(&out[y * linebytes], &image[y * linebytes], prevline, linebytes, 4, type);
+      }
+      sink = out[out.size() / 2];
+    });
+  }
+
+  //unfilter data that was filtered with the same type, as a decoder sees it
+  std::vector<unsigned char> filtered(image.size());
+  for(unsigned char type = 0; type < 5; type++)
+  {
+    for(unsigned y = 0; y < H; y++)
+    {
+      const unsigned char* prevline = y ? &image[(y - 1) * linebytes] : 0;
+      filterScanline(&filtered[y * linebytes], &image[y * linebytes], prevline, linebytes, 4, type);
+    }
+
+    std::string name = std::string("unfilterScanline ") + (char)('0' + type);
+    bench(name, image.size(), [&]()
+    {
+      for(unsigned y = 0; y < H; y++)
+      {
+        const unsigned char* precon = y ? &out[(y - 1) * linebytes] : 0;
+        unfilterScanline(&out[y * linebytes], &filtered[y * linebytes], precon, 4, type, linebytes);
+      }
+      sink = out[out.size() / 2];
+    });
+  }
+
+  bench("paethPredictor", image.size() - linebytes - 4, [&]()
+  {
+    const unsigned char* data = &image[0];
+    unsigned sum = 0;
+    for(size_t i = linebytes + 4; i < image.size(); i++)
+    {
+      sum += paethPredictor(data[i - 4], data[i - linebytes], data[i - linebytes - 4]);
+    }
+    sink = sum;
+  });
+}
+
+static void benchLZ77(const std::vector<unsigned char>& image)
+{
+  //LZ77 runs on the filtered data, so filter it the way the encoder would for truecolor
+  const size_t linebytes = W * 4;
+  const size_t size = 1 << 20; //the chains make this slow, so only use part of the image
+  std::vector<unsigned char> filtered(image.size());
+  for(unsigned y = 0; y < H; y++)
+  {
+    const unsigned char* prevline = y ? &image[(y - 1) * linebytes] : 0;
+    filterScanline(&filtered[y * linebytes], &image[y * linebytes], prevline, linebytes, 4, 4);
+  }
+  const unsigned char* data = &filtered[0];
+
+  bench("getHash", size, [&]()
+  {
+    unsigned sum = 0;
+    for(size_t i = 0; i < size; i++) sum += getHash(data, size, i);
+    sink = sum;
+  });
+
+  Hash hash;
+  if(hash_init(&hash, DEFAULT_WINDOWSIZE))
+  {
+    std::cout << "hash_init failed" << std::endl;
+    return;
+  }
+
+  bench("encodeLZ77", size, [&]()
+  {
+    uivector out;
+    unsigned i;
+    //start from a clean hash every time, as a new lodepng_deflate call does
+    for(i = 0; i < HASH_NUM_VALUES; i++) hash.head[i] = -1;
+    for(i = 0; i < DEFAULT_WINDOWSIZE; i++) hash.val[i] = -1;
+    for(i = 0; i < DEFAULT_WINDOWSIZE; i++) hash.chain[i] = i;
+    for(i = 0; i <= MAX_SUPPORTED_DEFLATE_LENGTH; i++) hash.headz[i] = -1;
+    for(i = 0; i < DEFAULT_WINDOWSIZE; i++) hash.chainz[i] = i;
+    uivector_init(&out);
+    sink = encodeLZ77(&out, &hash, data, 0, size, DEFAULT_WINDOWSIZE, 3, 128, 1);
+    uivector_cleanup(&out);
+  });
+
+  hash_cleanup(&hash);
+}
+
+static void benchConvert(const std::vector<unsigned char>& image, LodePNGColorType typeout, unsigned bitout,
+                         LodePNGColorType typein, unsigned bitin, const std::string& name)
+{
+  LodePNGColorMode modein, modeout;
+  lodepng_color_mode_init(&modein);
+  lodepng_color_mode_init(&modeout);
+  modein.colortype = typein;
+  modein.bitdepth = bitin;
+  modeout.colortype = typeout;
+  modeout.bitdepth = bitout;
+
+  const size_t numpixels = W * H;
+  std::vector<unsigned char> in(lodepng_get_raw_size(W, H, &modein));
+  std::vector<unsigned char> out(lodepng_get_raw_size(W, H, &modeout));
+
+  //make an input in the right mode from the RGBA test image
+  LodePNGColorMode rgba;
+  lodepng_color_mode_init(&rgba);
+  if(typein == LCT_PALETTE || typeout == LCT_PALETTE)
+  {
+    //a palette of 256 colors with every pixel of the input in it
+    for(unsigned i = 0; i < 256; i++)
+    {
+      lodepng_palette_add(&modein, (unsigned char)((i & 15) * 16), (unsigned char)(i & 0xf0), (unsigned char)(255 - i), 255);
+    }
+    for(size_t i = 0; i < numpixels; i++)
+    {
+      unsigned index = image[i * 4] ^ image[i * 4 + 1];
+      const unsigned char* p = &modein.palette[index * 4];
+      if(typein == LCT_PALETTE) in[i] = (unsigned char)index;
+      else for(unsigned c = 0; c < 4; c++) in[i * 4 + c] = p[c];
+    }
+    if(typeout == LCT_PALETTE)
+    {
+      lodepng_color_mode_copy(&modeout, &modein);
+      modeout.colortype = typeout;
+      modeout.bitdepth = bitout;
+      lodepng_palette_clear(&modein);
+    }
+  }
+  else if(lodepng_convert(&in[0], &image[0], &modein, &rgba, W, H))
+  {
+    std::cout << "can't make input for " << name << std::endl;
+    return;
+  }
+
+  bench(name, in.size(), [&]() { sink = lodepng_convert(&out[0], &in[0], &modeout, &modein, W, H); });
+
+  lodepng_color_mode_cleanup(&modein);
+  lodepng_color_mode_cleanup(&modeout);
+  lodepng_color_mode_cleanup(&rgba);
+}
+
+static void benchConverts(const std::vector<unsigned char>& image)
+{
+  benchConvert(image, LCT_RGBA, 8, LCT_RGBA, 8, "convert RGBA8 to RGBA8");
+  benchConvert(image, LCT_RGBA, 8, LCT_RGB, 8, "convert RGB8 to RGBA8");
+  benchConvert(image, LCT_RGB, 8, LCT_RGBA, 8, "convert RGBA8 to RGB8");
+  benchConvert(image, LCT_RGBA, 8, LCT_GREY, 8, "convert GREY8 to RGBA8");
+  benchConvert(image, LCT_RGBA, 8, LCT_GREY_ALPHA, 8, "convert GA8 to RGBA8");
+  benchConvert(image, LCT_RGBA, 8, LCT_RGBA, 16, "convert RGBA16 to RGBA8");
+  benchConvert(image, LCT_RGBA, 8, LCT_PALETTE, 8, "convert PAL8 to RGBA8");
+  benchConvert(image, LCT_PALETTE, 8, LCT_RGBA, 8, "convert RGBA8 to PAL8");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    if(arg == "--reps" && i + 1 < argc) num_reps = atoi(argv[++i]);
+    else if(arg == "--filter" && i + 1 < argc) name_filter = argv[++i];
+    else if(arg == "--json") json = true;
+    else
+    {
+      std::cout << "usage: " << argv[0] << " [--reps N] [--filter NAME] [--json]" << std::endl;
+      return 1;
+    }
+  }
+  if(num_reps < 1) num_reps = 1;
+
+  std::vector<unsigned char> image;
+  generateImage(image, W, H);
+
+  if(json) printf("[");
+  else printf("%-28s %10s %10s %10s %10s\n", "kernel", "median us", "p10 us", "p90 us", "MB/s");
+
+  benchChecksums(image);
+  benchHuffman(image);
+  benchFilters(image);
+  benchLZ77(image);
+  benchConverts(image);
+
+  if(json) printf("\n]\n");
+  return 0;
+}
@@ -683,6 +683,51 @@ void testColorConvert()
   colorConvertTest("11111111 11111111 11111111 00000000 00000000 00000000", LCT_RGB, 1, "10", LCT_GREY, 1);
 }
 
+//Compares the 8-bit conversion fast paths against the expected result, for sizes that
+//exercise both the vectorized part and the remaining tail pixels.
+void doColorConvertFastPathTest(LodePNGColorType type_in, LodePNGColorType type_out)
+{
+  LodePNGColorMode mode_in, mode_out;
+  lodepng_color_mode_init(&mode_in);
+  lodepng_color_mode_init(&mode_out);
+  mode_in.colortype = type_in;
+  mode_out.colortype = type_out;
+  unsigned channels_in = lodepng_get_channels(&mode_in);
+  unsigned channels_out = lodepng_get_channels(&mode_out);
+
+  for(unsigned w = 1; w < 40; w++)
+  {
+    std::vector<unsigned char> in(w * channels_in);
+    for(size_t i = 0; i < in.size(); i++) in[i] = (unsigned char)(i * 37 + w);
+    std::vector<unsigned char> out(w * channels_out + 16, 123);
+    assertNoPNGError(lodepng_convert(&out[0], &in[0], &mode_out, &mode_in, w, 1));
+
+    for(unsigned i = 0; i < w; i++)
+    {
+      const unsigned char* p = &in[i * channels_in];
+      unsigned char r, g, b, a;
+      if(channels_in >= 3) { r = p[0]; g = p[1]; b = p[2]; }
+      else r = g = b = p[0];
+      a = channels_in == 4 ? p[3] : channels_in == 2 ? p[1] : 255;
+      assertEquals((int)r, (int)out[i * channels_out + 0], "fast path red");
+      assertEquals((int)g, (int)out[i * channels_out + 1], "fast path green");
+      assertEquals((int)b, (int)out[i * channels_out + 2], "fast path blue");
+      if(channels_out == 4) assertEquals((int)a, (int)out[i * channels_out + 3], "fast path alpha");
+    }
+    for(size_t i = w * channels_out; i < out.size(); i++) assertEquals(123, (int)out[i], "fast path overrun");
+  }
+}
+
+void testColorConvertFastPaths()
+{
+  std::cout << "testColorConvertFastPaths" << std::endl;
+  doColorConvertFastPathTest(LCT_RGB, LCT_RGBA);
+  doColorConvertFastPathTest(LCT_RGBA, LCT_RGB);
+  doColorConvertFastPathTest(LCT_GREY, LCT_RGBA);
+  doColorConvertFastPathTest(LCT_GREY_ALPHA, LCT_RGBA);
+  doColorConvertFastPathTest(LCT_RGBA, LCT_RGBA);
+}
+
 //This tests color conversions from any color model to any color model, with any bit depth
 //But it tests only with colors black and white, because that are the only colors every single model supports
 void testColorConvert2()
@@ -1115,6 +1160,35 @@ void testRGBToPaletteConvert()
   doRGBAToPaletteTest(&palette[0], 257, LCT_RGBA);
 }
 
+//Colors that only differ in one channel must still get their own palette index and
+//be counted separately.
+void testPaletteLookupDistinctColors()
+{
+  std::cout << "testPaletteLookupDistinctColors" << std::endl;
+  LodePNGColorMode mode_in, mode_out;
+  lodepng_color_mode_init(&mode_in);
+  lodepng_color_mode_init(&mode_out);
+  mode_in.colortype = LCT_RGBA;
+  mode_out.colortype = LCT_PALETTE;
+  for(int i = 0; i < 256; i++) lodepng_palette_add(&mode_out, (i & 15) * 16, 0, 0, 255 - (i >> 4));
+
+  std::vector<unsigned char> image(256 * 4 * 3);
+  for(size_t i = 0; i < image.size() / 4; i++)
+  {
+    for(int c = 0; c < 4; c++) image[i * 4 + c] = mode_out.palette[((i * 7) & 255) * 4 + c];
+  }
+  std::vector<unsigned char> indices(image.size() / 4);
+  assertNoPNGError(lodepng_convert(&indices[0], &image[0], &mode_out, &mode_in, (unsigned)indices.size(), 1));
+  for(size_t i = 0; i < indices.size(); i++) assertEquals((int)((i * 7) & 255), (int)indices[i], "palette index");
+
+  LodePNGColorProfile profile;
+  lodepng_color_profile_init(&profile);
+  assertNoPNGError(lodepng_get_color_profile(&profile, &image[0], (unsigned)indices.size(), 1, &mode_in));
+  assertEquals(256, profile.numcolors, "numcolors");
+
+  lodepng_color_mode_cleanup(&mode_out);
+}
+
 void testColorKeyConvert()
 {
   std::cout << "testColorKeyConvert" << std::endl;
@@ -1665,6 +1739,366 @@ void testAutoColorModel(const std::vector<unsigned char>& colors, unsigned inbit
   else { for(size_t i = 0; i < colors.size() / 2; i++) ASSERT_EQUALS(colors[i * 2], decoded[i]); }
 }
 
+//The vectorized profile of 8-bit RGBA input must agree with the per pixel profile
+//of the same colors given as 16-bit input.
+void doColorProfileCompareTest(const std::vector<unsigned char>& colors, bool rgb)
+{
+  size_t num = colors.size() / 4;
+  LodePNGColorMode mode8, mode16;
+  lodepng_color_mode_init(&mode8);
+  lodepng_color_mode_init(&mode16);
+  mode8.colortype = mode16.colortype = rgb ? LCT_RGB : LCT_RGBA;
+  mode16.bitdepth = 16;
+  unsigned channels = rgb ? 3 : 4;
+
+  std::vector<unsigned char> image8, image16;
+  for(size_t i = 0; i < num; i++)
+  for(unsigned c = 0; c < channels; c++)
+  {
+    image8.push_back(colors[i * 4 + c]);
+    image16.push_back(colors[i * 4 + c]);
+    image16.push_back(colors[i * 4 + c]);
+  }
+
+  LodePNGColorProfile p8, p16;
+  lodepng_color_profile_init(&p8);
+  lodepng_color_profile_init(&p16);
+  assertNoPNGError(lodepng_get_color_profile(&p8, &image8[0], (unsigned)num, 1, &mode8));
+  assertNoPNGError(lodepng_get_color_profile(&p16, &image16[0], (unsigned)num, 1, &mode16));
+  assertEquals(p16.colored, p8.colored, "profile colored");
+  assertEquals(p16.alpha, p8.alpha, "profile alpha");
+  assertEquals(p16.key, p8.key, "profile key");
+  if(p16.key && !p16.alpha)
+  {
+    assertEquals(p16.key_r, p8.key_r, "profile key_r");
+    assertEquals(p16.key_g, p8.key_g, "profile key_g");
+    assertEquals(p16.key_b, p8.key_b, "profile key_b");
+  }
+  assertEquals(p16.numcolors, p8.numcolors, "profile numcolors");
+  assertEquals(p16.bits, p8.bits, "profile bits");
+}
+
+void testColorProfileVectorized()
+{
+  std::cout << "testColorProfileVectorized" << std::endl;
+  for(int pattern = 0; pattern < 7; pattern++)
+  for(size_t num = 1; num < 40; num += 3)
+  {
+    std::vector<unsigned char> colors;
+    for(size_t i = 0; i < num * 300; i++)
+    {
+      unsigned char v = (unsigned char)(i * 17 % 256);
+      bool last = i + 1 == num * 300;
+      switch(pattern)
+      {
+        case 0: addColor(colors, v, v, v, 255); break; //grey, opaque
+        case 1: addColor(colors, v, v, v, i % 7 == 3 ? 0 : 255); break; //alpha needed, keys differ
+        case 2: addColor(colors, 10, 20, 30, 255); break; //single color
+        case 3: if(i % 5 == 4) addColor(colors, 1, 2, 3, 0); else addColor(colors, v, 0, 0, 255); break; //key
+        case 4: addColor(colors, 50, 50, last ? 51 : 50, 255); break; //colored only at the end
+        case 5: addColor(colors, 50, 50, 50, last ? 254 : 255); break; //alpha only at the end
+        case 6: if(i % 5 == 4) addColor(colors, 1, 2, 3, 0); else addColor(colors, last ? 1 : 0, last ? 2 : 0, 3, 255); break;
+      }
+    }
+    doColorProfileCompareTest(colors, false);
+    if(pattern == 0 || pattern == 2 || pattern == 4) doColorProfileCompareTest(colors, true);
+  }
+
+  //an opaque pixel with the key color before the first transparent one rules out the key
+  std::vector<unsigned char> colors;
+  addColor(colors, 1, 2, 3, 255);
+  for(int i = 0; i < 20; i++) addColor(colors, 1, 2, 3, 0);
+  LodePNGColorMode mode;
+  lodepng_color_mode_init(&mode);
+  LodePNGColorProfile profile;
+  lodepng_color_profile_init(&profile);
+  assertNoPNGError(lodepng_get_color_profile(&profile, &colors[0], (unsigned)colors.size() / 4, 1, &mode));
+  assertEquals(1, profile.alpha, "opaque key color");
+}
+
+//a clock that ticks one second every time it's read
+static double stats_ticks = 0;
+static double tickClock()
+{
+  return stats_ticks += 1;
+}
+
+//counts the phases reported to the stats callback
+static void countPhase(void* user, LodePNGStatsPhase phase, double start, double end, size_t)
+{
+  if(end == start + 1) ((unsigned*)user)[phase]++;
+}
+
+void testStats()
+{
+  std::cout << "testStats" << std::endl;
+  Image image;
+  generateTestImage(image, 40, 30, LCT_RGBA, 8);
+
+  LodePNGStats stats;
+  lodepng_stats_init(&stats, tickClock);
+
+  lodepng::State state;
+  state.stats = &stats;
+  state.encoder.auto_convert = 0;
+  state.info_png.color.colortype = LCT_RGB;
+  std::vector<unsigned char> png;
+  assertNoPNGError(lodepng::encode(png, image.data, image.width, image.height, state));
+  ASSERT_EQUALS(1, stats.count[LSP_CONVERT]);
+  ASSERT_EQUALS(40 * 30 * 3, stats.bytes[LSP_CONVERT]);
+  ASSERT_EQUALS(1, stats.count[LSP_FILTER]);
+  ASSERT_EQUALS(30 * (40 * 3 + 1), stats.bytes[LSP_FILTER]);
+  ASSERT_EQUALS(1, stats.count[LSP_DEFLATE]);
+  ASSERT_EQUALS(1, stats.count[LSP_CRC]);
+  ASSERT_EQUALS(0, stats.count[LSP_INFLATE]);
+  ASSERT_EQUALS(1.0, stats.time[LSP_FILTER]);
+
+  std::vector<unsigned char> decoded;
+  unsigned w, h;
+  state.info_raw.colortype = LCT_RGBA;
+  assertNoPNGError(lodepng::decode(decoded, w, h, state, png));
+  ASSERT_EQUALS(1, stats.count[LSP_HEADER]);
+  ASSERT_EQUALS(1, stats.count[LSP_INFLATE]);
+  ASSERT_EQUALS(30 * (40 * 3 + 1), stats.bytes[LSP_INFLATE]);
+  ASSERT_EQUALS(40 * 30 * 3, stats.bytes[LSP_UNFILTER]);
+  ASSERT_EQUALS(2, stats.count[LSP_CONVERT]);
+  ASSERT_EQUALS(40 * 30 * 3 + 40 * 30 * 4, stats.bytes[LSP_CONVERT]);
+  ASSERT_EQUALS(0, stats.count[LSP_READ]);
+
+  //the chunk CRCs are checked when decoding, IHDR is not counted since lodepng_inspect reads it
+  ASSERT_EQUALS(true, stats.count[LSP_CRC] > 2);
+
+  LodePNGStats total;
+  lodepng_stats_init(&total, 0);
+  lodepng_stats_merge(&total, &stats);
+  lodepng_stats_merge(&total, &stats);
+  ASSERT_EQUALS(2 * stats.bytes[LSP_DEFLATE], total.bytes[LSP_DEFLATE]);
+  ASSERT_EQUALS(std::string("check_type"), std::string(lodepng_stats_phase_name(LSP_CHECK_TYPE)));
+
+  //the callback sees every phase, with the same start and end as the totals
+  unsigned phases[LSP_NUM_PHASES] = {0};
+  lodepng_stats_init(&stats, tickClock);
+  stats.callback = countPhase;
+  stats.user = phases;
+  assertNoPNGError(lodepng::decode(decoded, w, h, state, png));
+  for(int i = 0; i < LSP_NUM_PHASES; i++) ASSERT_EQUALS(stats.count[i], phases[i]);
+  ASSERT_EQUALS(1, phases[LSP_INFLATE]);
+
+  //without a clock nothing is counted
+  lodepng_stats_init(&stats, 0);
+  assertNoPNGError(lodepng::decode(decoded, w, h, state, png));
+  ASSERT_EQUALS(0, stats.count[LSP_INFLATE]);
+}
+
+//decodes with lodepng_decode_into, top-down with padded rows and bottom-up, and
+//compares every row with what lodepng_decode gives
+void doDecodeIntoTest(LodePNGColorType type, unsigned bitdepth, unsigned interlace,
+                      LodePNGColorType rawtype, unsigned rawdepth, unsigned w, unsigned h)
+{
+  Image image;
+  generateTestImage(image, w, h, type, bitdepth);
+  lodepng::State state;
+  state.encoder.auto_convert = 0;
+  state.info_png.interlace_method = interlace;
+  state.info_png.color.colortype = type;
+  state.info_png.color.bitdepth = bitdepth;
+  state.info_raw.colortype = type;
+  state.info_raw.bitdepth = bitdepth;
+  if(type == LCT_PALETTE)
+  {
+    for(unsigned i = 0; i < (1u << bitdepth); i++)
+    {
+      lodepng_palette_add(&state.info_png.color, i * 16, 255 - i, i * 3, 255);
+      lodepng_palette_add(&state.info_raw, i * 16, 255 - i, i * 3, 255);
+    }
+  }
+  std::vector<unsigned char> png;
+  assertNoPNGError(lodepng::encode(png, image.data, w, h, state));
+
+  std::vector<unsigned char> expected;
+  unsigned ew, eh;
+  state.info_raw.colortype = rawtype;
+  state.info_raw.bitdepth = rawdepth;
+  assertNoPNGError(lodepng::decode(expected, ew, eh, state, png));
+
+  size_t rowbytes = lodepng_get_raw_size(w, 1, &state.info_raw);
+  size_t rowbits = lodepng_get_bpp(&state.info_raw) * w;
+  long stride = (long)rowbytes + 3;
+  for(int bottomup = 0; bottomup < 2; bottomup++)
+  {
+    std::vector<unsigned char> out(stride * h, 0);
+    unsigned char* first = bottomup ? &out[stride * (h - 1)] : &out[0];
+    assertNoPNGError(lodepng_decode_into(first, bottomup ? -stride : stride, w, h, &state, &png[0], png.size()));
+    for(unsigned y = 0; y < h; y++)
+    {
+      const unsigned char* row = first + (bottomup ? -stride : stride) * (long)y;
+      for(size_t bit = 0; bit < rowbits; bit++)
+      {
+        size_t ebit = y * rowbits + bit;
+        ASSERT_EQUALS((expected[ebit / 8] >> (7 - ebit % 8)) & 1, (row[bit / 8] >> (7 - bit % 8)) & 1);
+      }
+      ASSERT_EQUALS(0, row[rowbytes]); //the padding is left alone
+    }
+  }
+
+  //the size must match
+  std::vector<unsigned char> out(rowbytes * h * 2);
+  ASSERT_EQUALS(94, lodepng_decode_into(&out[0], rowbytes, w + 1, h, &state, &png[0], png.size()));
+}
+
+void testDecodeInto()
+{
+  std::cout << "testDecodeInto" << std::endl;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    doDecodeIntoTest(LCT_RGBA, 8, interlace, LCT_RGBA, 8, 13, 11);
+    doDecodeIntoTest(LCT_RGB, 8, interlace, LCT_RGB, 8, 13, 11);
+    doDecodeIntoTest(LCT_RGB, 8, interlace, LCT_RGBA, 8, 13, 11);
+    doDecodeIntoTest(LCT_RGBA, 8, interlace, LCT_RGB, 8, 13, 11);
+    doDecodeIntoTest(LCT_RGBA, 16, interlace, LCT_RGBA, 8, 9, 7);
+    doDecodeIntoTest(LCT_GREY, 1, interlace, LCT_GREY, 1, 13, 11);
+    doDecodeIntoTest(LCT_GREY, 2, interlace, LCT_RGB, 8, 13, 11);
+    doDecodeIntoTest(LCT_PALETTE, 4, interlace, LCT_RGBA, 8, 5, 3);
+    doDecodeIntoTest(LCT_PALETTE, 4, interlace, LCT_PALETTE, 4, 5, 3);
+    doDecodeIntoTest(LCT_GREY_ALPHA, 8, interlace, LCT_RGBA, 8, 1, 1);
+  }
+
+  //lodepng_inspect_chunks also finds the chunks after IDAT, such as compressed text
+  Image image;
+  generateTestImage(image, 4, 4, LCT_RGB, 8);
+  lodepng::State state;
+  state.info_raw.colortype = LCT_RGB;
+  lodepng_add_text(&state.info_png, "key", "value");
+  std::vector<unsigned char> png;
+  assertNoPNGError(lodepng::encode(png, image.data, 4, 4, state));
+  unsigned w, h;
+  assertNoPNGError(lodepng_inspect_chunks(&w, &h, &state, &png[0], png.size()));
+  ASSERT_EQUALS(4, w);
+  ASSERT_EQUALS(1, state.info_png.text_num);
+  ASSERT_EQUALS(std::string("value"), std::string(state.info_png.text_strings[0]));
+}
+
+//the bits of pixel i of an image without padding bits
+static unsigned getPixelBits(const std::vector<unsigned char>& image, size_t i, size_t bit, unsigned bpp)
+{
+  size_t b = i * bpp + bit;
+  return (image[b / 8] >> (7 - b % 8)) & 1;
+}
+
+//decodes previews after every pass, raw and upsampled, and compares them with the pixels
+//of the whole image that they must be
+void doDecodePreviewTest(LodePNGColorType type, unsigned bitdepth, unsigned interlace,
+                         LodePNGColorType rawtype, unsigned rawdepth, unsigned w, unsigned h)
+{
+  static const unsigned gridx[8] = {8, 8, 4, 4, 2, 2, 1, 1};
+  static const unsigned gridy[8] = {8, 8, 8, 4, 4, 2, 2, 1};
+  Image image;
+  generateTestImage(image, w, h, type, bitdepth);
+  lodepng::State state;
+  state.encoder.auto_convert = 0;
+  state.info_png.interlace_method = interlace;
+  state.info_png.color.colortype = type;
+  state.info_png.color.bitdepth = bitdepth;
+  state.info_raw.colortype = type;
+  state.info_raw.bitdepth = bitdepth;
+  if(type == LCT_PALETTE)
+  {
+    for(unsigned i = 0; i < (1u << bitdepth); i++)
+    {
+      lodepng_palette_add(&state.info_png.color, i * 16, 255 - i, i * 3, 255);
+      lodepng_palette_add(&state.info_raw, i * 16, 255 - i, i * 3, 255);
+    }
+  }
+  std::vector<unsigned char> png;
+  assertNoPNGError(lodepng::encode(png, image.data, w, h, state));
+
+  std::vector<unsigned char> expected;
+  unsigned ew, eh;
+  state.info_raw.colortype = rawtype;
+  state.info_raw.bitdepth = rawdepth;
+  assertNoPNGError(lodepng::decode(expected, ew, eh, state, png));
+  unsigned bpp = lodepng_get_bpp(&state.info_raw);
+
+  for(unsigned passes = 1; passes <= 7; passes++)
+  for(unsigned upsample = 0; upsample < 2; upsample++)
+  {
+    unsigned char* out;
+    unsigned pw, ph;
+    unsigned sx = gridx[passes], sy = gridy[passes];
+    assertNoPNGError(lodepng_decode_preview(&out, &pw, &ph, &state, &png[0], png.size(), passes, upsample));
+    ASSERT_EQUALS(upsample ? w : (w + sx - 1) / sx, pw);
+    ASSERT_EQUALS(upsample ? h : (h + sy - 1) / sy, ph);
+    std::vector<unsigned char> preview(out, out + lodepng_get_raw_size(pw, ph, &state.info_raw));
+    free(out);
+    for(unsigned y = 0; y < ph; y++)
+    for(unsigned x = 0; x < pw; x++)
+    {
+      //the pixel of the whole image it shows
+      size_t e = upsample ? (y - y % sy) * w + (x - x % sx) : (y * sy) * w + x * sx;
+      for(unsigned bit = 0; bit < bpp; bit++)
+      {
+        ASSERT_EQUALS(getPixelBits(expected, e, bit, bpp), getPixelBits(preview, y * pw + x, bit, bpp));
+      }
+    }
+  }
+}
+
+void testDecodePreview()
+{
+  std::cout << "testDecodePreview" << std::endl;
+  for(unsigned interlace = 0; interlace < 2; interlace++)
+  {
+    doDecodePreviewTest(LCT_RGBA, 8, interlace, LCT_RGBA, 8, 37, 29);
+    doDecodePreviewTest(LCT_RGB, 8, interlace, LCT_RGBA, 8, 16, 16);
+    doDecodePreviewTest(LCT_RGBA, 16, interlace, LCT_RGBA, 8, 9, 7);
+    doDecodePreviewTest(LCT_GREY, 1, interlace, LCT_GREY, 1, 13, 11);
+    doDecodePreviewTest(LCT_GREY, 2, interlace, LCT_RGB, 8, 13, 11);
+    doDecodePreviewTest(LCT_PALETTE, 4, interlace, LCT_PALETTE, 4, 5, 3);
+    doDecodePreviewTest(LCT_GREY_ALPHA, 8, interlace, LCT_RGBA, 8, 1, 1);
+    doDecodePreviewTest(LCT_RGB, 8, interlace, LCT_RGB, 8, 3, 20);
+  }
+
+  //pass 1 of a large interlaced image inflates only a part of the data
+  Image image;
+  generateTestImage(image, 256, 256, LCT_RGBA, 8);
+  lodepng::State state;
+  state.info_png.interlace_method = 1;
+  std::vector<unsigned char> png;
+  assertNoPNGError(lodepng::encode(png, image.data, 256, 256, state));
+  LodePNGStats stats;
+  lodepng_stats_init(&stats, tickClock);
+  state.stats = &stats;
+  unsigned char* out;
+  unsigned w, h;
+  assertNoPNGError(lodepng_decode_preview(&out, &w, &h, &state, &png[0], png.size(), 1, 0));
+  free(out);
+  ASSERT_EQUALS(32, w);
+  assertTrue(stats.bytes[LSP_INFLATE] < 256 * 257 * 4 / 8, "pass 1 inflates less than an eighth");
+
+  //all 7 passes are a full decode: a wrong Adler32 (the 4 bytes before the IDAT CRC and IEND) is found
+  png[png.size() - 17] ^= 1;
+  state.stats = 0;
+  state.decoder.ignore_crc = 1;
+  ASSERT_EQUALS(0, lodepng_decode_preview(&out, &w, &h, &state, &png[0], png.size(), 6, 0));
+  free(out);
+  ASSERT_EQUALS(58, lodepng_decode_preview(&out, &w, &h, &state, &png[0], png.size(), 7, 0));
+
+  //stop_after: the start of the data, without the Adler32 check
+  std::vector<unsigned char> data(100000);
+  for(size_t i = 0; i < data.size(); i++) data[i] = (unsigned char)(i * i / 7);
+  std::vector<unsigned char> zlib;
+  assertNoError(lodepng::compress(zlib, data));
+  LodePNGDecompressSettings settings;
+  lodepng_decompress_settings_init(&settings);
+  settings.stop_after = 1000;
+  unsigned char* part = 0;
+  size_t partsize = 0;
+  assertNoError(lodepng_zlib_decompress(&part, &partsize, &zlib[0], zlib.size(), &settings));
+  assertTrue(partsize >= 1000 && partsize < data.size(), "stopped early");
+  for(size_t i = 0; i < partsize; i++) ASSERT_EQUALS(data[i], part[i]);
+  free(part);
+}
+
 void testAutoColorModels()
 {
   std::vector<unsigned char> grey1;
@@ -1775,10 +2209,16 @@ void doMain()
   testColorKeyConvert();
   testColorConvert();
   testColorConvert2();
+  testColorConvertFastPaths();
   testPaletteToPaletteConvert();
   testRGBToPaletteConvert();
+  testPaletteLookupDistinctColors();
   test16bitColorEndianness();
   testAutoColorModels();
+  testColorProfileVectorized();
+  testStats();
+  testDecodeInto();
+  testDecodePreview();
 
   //Zlib
   testCompressZlib();
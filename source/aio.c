@@ -0,0 +1,835 @@
+/*
+ * aio.c - reading and writing the image files, and the --aio option:
+ * in a batch, the next files are read while the current one converts,
+ * and finished outputs are written while the next one converts. Uses
+ * io_uring on Linux, else a few threads doing pread and pwrite. Outputs
+ * of a known size are made in a mapped file. Shared by the converters,
+ * needs alloc.c, cache.c and walk.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// without --aio, aio_read () and aio_write () simply read and write the
+// whole file with stdio. with it, aio_next () takes over getting the file
+// names (from -r or stdin) and keeps the next AIO_AHEAD files being read,
+// and aio_write () returns as soon as the write is started. a failed
+// write is reported when it is done, with the name of the file.
+//
+// an output whose size is known up front (mbm, tga) is made with
+// aio_create (), which gives the mapping of a preallocated file to put
+// the pixels in, and aio_commit (). one whose size is only bounded (an
+// rle tga) is made at the bound and cut with aio_trim (). every output
+// (and every copy from the cache) is first written to a hidden temporary
+// file next to it, which is renamed over the output when complete, so a
+// failed conversion never leaves half a file (or overwrites a good one).
+// not so on windows, where the output is written directly with stdio.
+//
+// the return values are the error numbers of the converters: 1 malloc,
+// 2 open for read, 3 open for write, 4 read image, 5 write image.
+
+#define AIO_AHEAD 8 // files read ahead
+#define AIO_WRITES 16 // writes in flight before aio_write () waits
+#define AIO_THREADS 4 // for pread and pwrite, without io_uring
+
+#define AIO_OFF 0
+#define AIO_URING 1
+#define AIO_POOL 2
+
+uint32_t aio_mode = AIO_OFF;
+uint32_t aio_want = AIO_OFF;
+
+// returns 1 if arg is --aio, --aio=uring or --aio=threads
+int aio_option (const char *arg)
+{
+	if (strcmp (arg, "--aio") == 0) {
+		aio_want = AIO_URING; // if it can be had
+
+	} else if (strcmp (arg, "--aio=uring") == 0) {
+		aio_want = AIO_URING;
+
+	} else if (strcmp (arg, "--aio=threads") == 0) {
+		aio_want = AIO_POOL;
+
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+int aio_read_stdio (const char *name, unsigned char **buf, uint32_t *size)
+{
+	uint32_t io_size;
+	FILE *file = fopen (name, "rb");
+
+	if (! file) {
+		return 2;
+	}
+
+	fseek (file, 0, SEEK_END);
+	*size = ftell (file);
+	fseek (file, 0, SEEK_SET);
+	*buf = (unsigned char *) lodepng_malloc (*size ? *size : 1);
+
+	if (! *buf) {
+		fclose (file);
+		return 1;
+	}
+
+	io_size = fread (*buf, sizeof (char), *size, file);
+	fclose (file);
+
+	if (io_size != *size) {
+		lodepng_free (*buf);
+		*buf = NULL;
+		return 4;
+	}
+
+	return 0;
+}
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// one file being read or written
+typedef struct aio_job {
+	char *name;
+	char *temp; // for writes, renamed to name when done
+	int fd;
+	int write;
+	unsigned char *buf;
+	uint64_t size;
+	uint64_t done; // bytes so far
+	int error; // converter error number, 0 if fine
+	int finished;
+	struct iovec iov;
+} aio_job;
+
+aio_job aio_reads[AIO_AHEAD];
+uint32_t aio_head = 0;
+uint32_t aio_used = 0;
+uint32_t aio_eof = 0;
+
+aio_job aio_writes[AIO_WRITES];
+uint32_t aio_write_next = 0;
+uint32_t aio_failed = 0;
+
+// the thread pool: jobs to do, and a condition for the finished ones
+aio_job *aio_queue[AIO_AHEAD + AIO_WRITES];
+uint32_t aio_queue_head = 0;
+uint32_t aio_queue_used = 0;
+pthread_mutex_t aio_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t aio_work = PTHREAD_COND_INITIALIZER;
+pthread_cond_t aio_done = PTHREAD_COND_INITIALIZER;
+
+// a job that has transferred len more bytes (0 or less: failed)
+void aio_progress (aio_job *job, long len)
+{
+	if (len <= 0) {
+		job->error = job->write ? 5 : 4;
+		job->finished = 1;
+		return;
+	}
+
+	job->done += len;
+	job->finished = (job->done == job->size);
+}
+
+void *aio_thread (void *arg)
+{
+	aio_job *job;
+	ssize_t len;
+	(void) arg;
+
+	while (1) {
+		pthread_mutex_lock (&aio_lock);
+
+		while (! aio_queue_used) {
+			pthread_cond_wait (&aio_work, &aio_lock);
+		}
+
+		job = aio_queue[aio_queue_head];
+		aio_queue_head = (aio_queue_head + 1) % (AIO_AHEAD + AIO_WRITES);
+		aio_queue_used--;
+		pthread_mutex_unlock (&aio_lock);
+
+		do {
+			len = job->write ? pwrite (job->fd, job->buf + job->done, job->size - job->done, job->done)
+				: pread (job->fd, job->buf + job->done, job->size - job->done, job->done);
+
+			if ((len < 0) && (errno == EINTR)) {
+				continue;
+			}
+
+			pthread_mutex_lock (&aio_lock);
+			aio_progress (job, len);
+
+			if (job->finished) {
+				pthread_cond_broadcast (&aio_done);
+			}
+
+			pthread_mutex_unlock (&aio_lock);
+		} while (! job->finished);
+	}
+
+	return NULL;
+}
+
+#ifdef __linux__
+
+// an io_uring, set up with the raw system calls, no liburing needed
+int aio_ring = -1;
+unsigned *aio_sq_head, *aio_sq_tail, *aio_sq_mask, *aio_sq_array;
+unsigned *aio_cq_head, *aio_cq_tail, *aio_cq_mask;
+struct io_uring_sqe *aio_sqes;
+struct io_uring_cqe *aio_cqes;
+
+int aio_uring_setup (void)
+{
+	struct io_uring_params p;
+	unsigned char *sq, *cq;
+	size_t sq_size, cq_size;
+
+	memset (&p, 0, sizeof (p));
+	aio_ring = syscall (__NR_io_uring_setup, 2 * (AIO_AHEAD + AIO_WRITES), &p);
+
+	if (aio_ring < 0) {
+		return 0;
+	}
+
+	sq_size = p.sq_off.array + (p.sq_entries * sizeof (unsigned));
+	cq_size = p.cq_off.cqes + (p.cq_entries * sizeof (struct io_uring_cqe));
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		sq_size = cq_size = (sq_size > cq_size) ? sq_size : cq_size;
+	}
+
+	sq = (unsigned char *) mmap (NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio_ring, IORING_OFF_SQ_RING);
+	cq = (p.features & IORING_FEAT_SINGLE_MMAP) ? sq
+		: (unsigned char *) mmap (NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio_ring, IORING_OFF_CQ_RING);
+	aio_sqes = (struct io_uring_sqe *) mmap (NULL, p.sq_entries * sizeof (struct io_uring_sqe),
+		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio_ring, IORING_OFF_SQES);
+
+	if ((sq == MAP_FAILED) || (cq == MAP_FAILED) || (aio_sqes == MAP_FAILED)) {
+		close (aio_ring);
+		aio_ring = -1;
+		return 0;
+	}
+
+	aio_sq_head = (unsigned *) (sq + p.sq_off.head);
+	aio_sq_tail = (unsigned *) (sq + p.sq_off.tail);
+	aio_sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+	aio_sq_array = (unsigned *) (sq + p.sq_off.array);
+	aio_cq_head = (unsigned *) (cq + p.cq_off.head);
+	aio_cq_tail = (unsigned *) (cq + p.cq_off.tail);
+	aio_cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+	aio_cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+	return 1;
+}
+
+// queues the rest of a job. readv and writev are there since the first
+// kernel with io_uring.
+void aio_uring_submit (aio_job *job)
+{
+	unsigned tail = * aio_sq_tail;
+	unsigned index = tail & *aio_sq_mask;
+	struct io_uring_sqe *sqe = &aio_sqes[index];
+
+	job->iov.iov_base = job->buf + job->done;
+	job->iov.iov_len = job->size - job->done;
+	memset (sqe, 0, sizeof (*sqe));
+	sqe->opcode = job->write ? IORING_OP_WRITEV : IORING_OP_READV;
+	sqe->fd = job->fd;
+	sqe->addr = (uintptr_t) &job->iov;
+	sqe->len = 1;
+	sqe->off = job->done;
+	sqe->user_data = (uintptr_t) job;
+	aio_sq_array[index] = index;
+	__atomic_store_n (aio_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	while ((syscall (__NR_io_uring_enter, aio_ring, 1, 0, 0, NULL, 0) < 0) && (errno == EINTR)) {
+	}
+}
+
+// takes the finished requests, waiting for one if there are none
+void aio_uring_reap (void)
+{
+	struct io_uring_cqe *cqe;
+	aio_job *job;
+	unsigned head = *aio_cq_head;
+
+	if (head == __atomic_load_n (aio_cq_tail, __ATOMIC_ACQUIRE)) {
+		syscall (__NR_io_uring_enter, aio_ring, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+	}
+
+	while (head != __atomic_load_n (aio_cq_tail, __ATOMIC_ACQUIRE)) {
+		cqe = &aio_cqes[head & *aio_cq_mask];
+		job = (aio_job *) (uintptr_t) cqe->user_data;
+
+		if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+			aio_uring_submit (job);
+
+		} else {
+			aio_progress (job, cqe->res);
+
+			if (! job->finished) {
+				aio_uring_submit (job); // short read or write
+			}
+		}
+
+		head++;
+		__atomic_store_n (aio_cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+#endif
+
+// starts a transfer
+void aio_submit (aio_job *job)
+{
+	job->done = 0;
+	job->error = 0;
+	job->finished = (job->size == 0);
+
+	if (job->finished) {
+		return;
+	}
+
+#ifdef __linux__
+	if (aio_mode == AIO_URING) {
+		aio_uring_submit (job);
+		return;
+	}
+#endif
+
+	pthread_mutex_lock (&aio_lock);
+	aio_queue[(aio_queue_head + aio_queue_used) % (AIO_AHEAD + AIO_WRITES)] = job;
+	aio_queue_used++;
+	pthread_cond_signal (&aio_work);
+	pthread_mutex_unlock (&aio_lock);
+}
+
+void aio_wait (aio_job *job)
+{
+#ifdef __linux__
+	if (aio_mode == AIO_URING) {
+		while (! job->finished) {
+			aio_uring_reap ();
+		}
+
+		return;
+	}
+#endif
+
+	pthread_mutex_lock (&aio_lock);
+
+	while (! job->finished) {
+		pthread_cond_wait (&aio_done, &aio_lock);
+	}
+
+	pthread_mutex_unlock (&aio_lock);
+}
+
+// sets up io_uring or the threads, if --aio was given
+void aio_start (void)
+{
+	pthread_t thread;
+	uint32_t n;
+
+	if (! aio_want) {
+		return;
+	}
+
+#ifdef __linux__
+	if ((aio_want == AIO_URING) && aio_uring_setup ()) {
+		aio_mode = AIO_URING;
+		return;
+	}
+#endif
+
+	for (n = 0; n < AIO_THREADS; n++) {
+		if (pthread_create (&thread, NULL, aio_thread, NULL) != 0) {
+			break;
+		}
+
+		pthread_detach (thread);
+	}
+
+	aio_mode = n ? AIO_POOL : AIO_OFF;
+}
+
+// the next file name, from -r or stdin, while keeping the files after it
+// being read. 0 when there are no more.
+int aio_next (char *filename, int limit)
+{
+	char name[bufsz];
+	struct stat st;
+	aio_job *job;
+	int len;
+
+	if (! aio_mode) {
+		return walk_next (filename, limit);
+	}
+
+	while ((aio_used < AIO_AHEAD) && (! aio_eof)) {
+		if (walk_root) {
+			aio_eof = ! walk_next (name, bufsz);
+
+		} else {
+			// like readline (): no line ending or trailing blanks
+			aio_eof = ! fgets (name, bufsz, stdin);
+
+			for (len = strlen (name); (len > 0) && ((unsigned char) name[len - 1] <= 0x20); len--) {
+				name[len - 1] = 0;
+			}
+
+			aio_eof |= ! *name;
+		}
+
+		if (aio_eof) {
+			break;
+		}
+
+		job = &aio_reads[(aio_head + aio_used) % AIO_AHEAD];
+		aio_used++;
+		memset (job, 0, sizeof (*job));
+		job->name = strdup (name);
+		job->fd = open (name, O_RDONLY | O_CLOEXEC);
+		job->finished = 1;
+
+		if ((job->fd < 0) || (fstat (job->fd, &st) != 0)) {
+			job->error = 2;
+			continue;
+		}
+
+		job->size = st.st_size;
+		job->buf = (unsigned char *) lodepng_malloc (job->size ? job->size : 1);
+
+		if (! job->buf) {
+			job->error = 1;
+			continue;
+		}
+
+		aio_submit (job);
+	}
+
+	if (! aio_used) {
+		return 0;
+	}
+
+	snprintf (filename, limit, "%s", aio_reads[aio_head].name ? aio_reads[aio_head].name : "");
+	return 1;
+}
+
+// gives the whole file, in a buffer to free with lodepng_free ()
+int aio_read (const char *name, unsigned char **buf, uint32_t *size)
+{
+	aio_job *job = &aio_reads[aio_head];
+	int error;
+
+	if ((! aio_mode) || (! aio_used) || (! job->name) || (strcmp (job->name, name) != 0)) {
+		return aio_read_stdio (name, buf, size);
+	}
+
+	aio_wait (job);
+	aio_head = (aio_head + 1) % AIO_AHEAD;
+	aio_used--;
+
+	if (job->fd >= 0) {
+		close (job->fd);
+	}
+
+	free (job->name);
+	job->name = NULL;
+	error = job->error;
+
+	if (error) {
+		lodepng_free (job->buf);
+		return error;
+	}
+
+	*buf = job->buf;
+	*size = job->size;
+	return 0;
+}
+
+// creates the temporary file for name, in the same folder so that it
+// can be renamed, and puts its name in temp. returns the descriptor or -1.
+int aio_temp (const char *name, char *temp)
+{
+	static mode_t mask = 0777;
+	static int have_mask = 0;
+	const char *base = strrchr (name, '/');
+	int fd;
+
+	if (! have_mask) {
+		mask = umask (0);
+		umask (mask);
+		have_mask = 1;
+	}
+
+	base = base ? (base + 1) : name;
+	snprintf (temp, bufsz, "%.*s.%s.XXXXXX", (int) (base - name), name, base);
+	fd = mkstemp (temp);
+
+	if (fd >= 0) {
+		fchmod (fd, 0666 & ~mask); // as fopen would have made it
+	}
+
+	return fd;
+}
+
+// puts a complete temporary file in place, or removes a failed one
+int aio_rename (const char *temp, const char *name, int error)
+{
+	if ((! error) && (rename (temp, name) != 0)) {
+		error = 5;
+	}
+
+	if (error) {
+		unlink (temp);
+	}
+
+	return error;
+}
+
+int aio_write_fd (int fd, const unsigned char *buf, uint64_t size)
+{
+	uint64_t done = 0;
+	ssize_t len;
+
+	while (done < size) {
+		len = write (fd, buf + done, size - done);
+
+		if (len > 0) {
+			done += len;
+
+		} else if ((len == 0) || (errno != EINTR)) {
+			return 5;
+		}
+	}
+
+	return 0;
+}
+
+// ends a write: closes it and tells if it failed
+void aio_write_end (aio_job *job)
+{
+	aio_wait (job);
+
+	if ((close (job->fd) != 0) && (! job->error)) {
+		job->error = 5;
+	}
+
+	job->error = aio_rename (job->temp, job->name, job->error);
+
+	if (job->error) {
+		fprintf (stderr, "\n%s: write image failed\n", job->name);
+		fflush (stderr);
+		aio_failed++;
+	}
+
+	lodepng_free (job->buf);
+	free (job->name);
+	free (job->temp);
+	job->name = NULL;
+	job->temp = NULL;
+}
+
+// writes buf to the file and frees it. with --aio only starts the write,
+// unless the output goes into the cache, which reads it right away.
+int aio_write (const char *name, unsigned char *buf, uint32_t size)
+{
+	aio_job *job = &aio_writes[aio_write_next];
+	char temp[bufsz];
+	int error, fd;
+
+	if (! aio_mode) {
+		fd = aio_temp (name, temp);
+
+		if (fd < 0) {
+			lodepng_free (buf);
+			return 3;
+		}
+
+		error = aio_write_fd (fd, buf, size);
+		lodepng_free (buf);
+
+		if (close (fd) != 0) {
+			error = 5;
+		}
+
+		return aio_rename (temp, name, error);
+	}
+
+	// the slots are used in turn, the oldest write has to be done first
+	aio_write_next = (aio_write_next + 1) % AIO_WRITES;
+
+	if (job->name) {
+		aio_write_end (job);
+	}
+
+	job->fd = aio_temp (name, temp);
+
+	if (job->fd < 0) {
+		lodepng_free (buf);
+		return 3;
+	}
+
+	job->name = strdup (name);
+	job->temp = strdup (temp);
+	job->write = 1;
+	job->buf = buf;
+	job->size = size;
+	aio_submit (job);
+
+	if (cache_index) {
+		aio_write_end (job);
+	}
+
+	return 0;
+}
+
+// the output being made with aio_create ()
+char aio_out_name[bufsz];
+char aio_out_temp[bufsz];
+int aio_out_fd = -1;
+unsigned char *aio_out = NULL;
+uint64_t aio_out_size = 0;
+uint64_t aio_out_used = 0;
+int aio_out_mapped = 0;
+
+// removes an output that won't be completed
+void aio_discard (void)
+{
+	if (aio_out_fd < 0) {
+		return;
+	}
+
+	if (aio_out && aio_out_mapped) {
+		munmap (aio_out, aio_out_size);
+
+	} else {
+		lodepng_free (aio_out);
+	}
+
+	close (aio_out_fd);
+	unlink (aio_out_temp);
+	aio_out = NULL;
+	aio_out_fd = -1;
+}
+
+// a buffer to make an output of a known size in: the mapping of the
+// temporary file. the space is allocated first, else a full disk would
+// only show when the pixels are stored (as SIGBUS). other than on linux,
+// a buffer that is written out by aio_commit (). NULL if it failed.
+unsigned char *aio_create (const char *name, uint32_t size)
+{
+	aio_discard ();
+	aio_out_fd = aio_temp (name, aio_out_temp);
+
+	if (aio_out_fd < 0) {
+		return NULL;
+	}
+
+	snprintf (aio_out_name, bufsz, "%s", name);
+	aio_out_size = size;
+	aio_out_used = size;
+	aio_out_mapped = 0;
+
+#ifdef __linux__
+	if ((posix_fallocate (aio_out_fd, 0, size) == 0) && (size > 0)) {
+		aio_out = (unsigned char *) mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, aio_out_fd, 0);
+		aio_out_mapped = (aio_out != MAP_FAILED);
+	}
+#endif
+
+	if (! aio_out_mapped) {
+		aio_out = (unsigned char *) lodepng_malloc (size ? size : 1);
+	}
+
+	if (! aio_out) {
+		aio_discard ();
+	}
+
+	return aio_out;
+}
+
+// the output of aio_create () only needs the first size bytes
+void aio_trim (uint32_t size)
+{
+	if (size < aio_out_size) {
+		aio_out_used = size;
+	}
+}
+
+// puts the output of aio_create () in place of the file
+int aio_commit (void)
+{
+	int error = 0;
+
+	if (aio_out_fd < 0) {
+		return 5;
+	}
+
+	if (aio_out_mapped) {
+		munmap (aio_out, aio_out_size); // the page cache has it already
+
+		if ((aio_out_used < aio_out_size) && (ftruncate (aio_out_fd, aio_out_used) != 0)) {
+			error = 5;
+		}
+
+	} else {
+		error = aio_write_fd (aio_out_fd, aio_out, aio_out_used);
+		lodepng_free (aio_out);
+	}
+
+	if (close (aio_out_fd) != 0) {
+		error = 5;
+	}
+
+	aio_out = NULL;
+	aio_out_fd = -1;
+	return aio_rename (aio_out_temp, aio_out_name, error);
+}
+
+// waits for every write, at the end of a run
+void aio_finish (void)
+{
+	uint32_t n;
+
+	for (n = 0; aio_mode && (n < AIO_WRITES); n++) {
+		if (aio_writes[n].name) {
+			aio_write_end (&aio_writes[n]);
+		}
+	}
+
+	// files read ahead that weren't used, if the loop ended early
+	while (aio_mode && aio_used) {
+		aio_wait (&aio_reads[aio_head]);
+
+		if (aio_reads[aio_head].fd >= 0) {
+			close (aio_reads[aio_head].fd);
+		}
+
+		lodepng_free (aio_reads[aio_head].buf);
+		free (aio_reads[aio_head].name);
+		aio_reads[aio_head].name = NULL;
+		aio_head = (aio_head + 1) % AIO_AHEAD;
+		aio_used--;
+	}
+}
+
+#else // windows: --aio is accepted, the files are read and written with stdio
+
+// writes and frees buf
+int aio_write_stdio (const char *name, unsigned char *buf, uint32_t size)
+{
+	uint32_t io_size;
+	FILE *file = fopen (name, "wb");
+
+	if (! file) {
+		lodepng_free (buf);
+		return 3;
+	}
+
+	io_size = fwrite (buf, sizeof (char), size, file);
+	lodepng_free (buf);
+
+	if ((fclose (file) != 0) || (io_size != size)) {
+		return 5;
+	}
+
+	return 0;
+}
+
+void aio_start (void)
+{
+	if (aio_want) {
+		fprintf (stderr, "\n--aio is not supported on windows\n");
+		fflush (stderr);
+	}
+}
+
+int aio_next (char *filename, int limit)
+{
+	return walk_next (filename, limit);
+}
+
+int aio_read (const char *name, unsigned char **buf, uint32_t *size)
+{
+	return aio_read_stdio (name, buf, size);
+}
+
+int aio_write (const char *name, unsigned char *buf, uint32_t size)
+{
+	return aio_write_stdio (name, buf, size);
+}
+
+char aio_out_name[bufsz];
+unsigned char *aio_out = NULL;
+uint32_t aio_out_size = 0;
+uint32_t aio_out_used = 0;
+
+void aio_discard (void)
+{
+	lodepng_free (aio_out);
+	aio_out = NULL;
+}
+
+unsigned char *aio_create (const char *name, uint32_t size)
+{
+	aio_discard ();
+	snprintf (aio_out_name, bufsz, "%s", name);
+	aio_out_size = size;
+	aio_out_used = size;
+	aio_out = (unsigned char *) lodepng_malloc (size ? size : 1);
+	return aio_out;
+}
+
+void aio_trim (uint32_t size)
+{
+	if (size < aio_out_size) {
+		aio_out_used = size;
+	}
+}
+
+int aio_commit (void)
+{
+	unsigned char *buf = aio_out;
+
+	aio_out = NULL;
+	return buf ? aio_write_stdio (aio_out_name, buf, aio_out_used) : 5;
+}
+
+void aio_finish (void)
+{
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * alloc.c - memory accounting for --stats. The converters build lodepng
+ * with LODEPNG_NO_COMPILE_ALLOCATORS and LODEPNG_ALLOC_SITES, so all of
+ * its allocations come here, and they allocate their own image buffers
+ * with lodepng_malloc () too. Shared by the converters.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+// every block starts with its size. 16 bytes keep the alignment malloc gives.
+#define MEM_HEADER 16
+
+typedef struct mem_stats {
+	int64_t current; // bytes allocated now (a block freed by another thread can make it negative)
+	int64_t peak; // most bytes allocated at once
+	uint64_t allocs; // number of allocations
+	uint64_t grows[LAS_NUM_SITES]; // reallocs that made a block larger, by site
+	uint64_t grow_bytes[LAS_NUM_SITES]; // bytes they added
+} mem_stats;
+
+const char *mem_site_name[LAS_NUM_SITES] = { "other", "vector", "hash", "idat", "scanlines", "image" };
+
+// the counts of the calling thread, since its last mem_file_begin ()
+THREAD_LOCAL mem_stats mem;
+
+void *lodepng_malloc_site (size_t size, LodePNGAllocSite site)
+{
+	unsigned char *p = (unsigned char *) malloc (size + MEM_HEADER);
+	(void) site;
+
+	if (! p) {
+		return NULL;
+	}
+
+	* ((size_t *) p) = size;
+	mem.allocs++;
+	mem.current += size;
+	mem.peak = (mem.current > mem.peak) ? mem.current : mem.peak;
+	return (p + MEM_HEADER);
+}
+
+void *lodepng_realloc_site (void *ptr, size_t new_size, LodePNGAllocSite site)
+{
+	unsigned char *p;
+	size_t old_size;
+
+	if (! ptr) {
+		return lodepng_malloc_site (new_size, site);
+	}
+
+	p = ((unsigned char *) ptr - MEM_HEADER);
+	old_size = * ((size_t *) p);
+	p = (unsigned char *) realloc (p, new_size + MEM_HEADER);
+
+	if (! p) {
+		return NULL;
+	}
+
+	* ((size_t *) p) = new_size;
+	mem.current += ((int64_t) new_size - (int64_t) old_size);
+	mem.peak = (mem.current > mem.peak) ? mem.current : mem.peak;
+
+	if (new_size > old_size) {
+		mem.grows[site]++;
+		mem.grow_bytes[site] += (new_size - old_size);
+	}
+
+	return (p + MEM_HEADER);
+}
+
+void *lodepng_malloc (size_t size)
+{
+	return lodepng_malloc_site (size, LAS_OTHER);
+}
+
+void *lodepng_realloc (void *ptr, size_t new_size)
+{
+	return lodepng_realloc_site (ptr, new_size, LAS_OTHER);
+}
+
+void lodepng_free (void *ptr)
+{
+	unsigned char *p;
+
+	if (ptr) {
+		p = ((unsigned char *) ptr - MEM_HEADER);
+		mem.current -= * ((size_t *) p);
+		free (p);
+	}
+}
+
+// starts counting for a new file. what is still allocated stays counted.
+void mem_file_begin (void)
+{
+	int site;
+
+	mem.peak = mem.current;
+	mem.allocs = 0;
+
+	for (site = 0; site < LAS_NUM_SITES; site++) {
+		mem.grows[site] = 0;
+		mem.grow_bytes[site] = 0;
+	}
+}
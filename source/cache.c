@@ -0,0 +1,549 @@
+/*
+ * cache.c - the --cache=DIR option: remembers the output of every
+ * conversion under a hash of its input bytes and the converter options,
+ * so that converting an unchanged file again only costs reading and
+ * hashing it. Shared by the converters, needs alloc.c and stats.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// DIR/index is one file, mapped into memory by every process using the
+// cache: a header and an open addressed table of slots. a slot is taken
+// with a compare and swap on its key and published by storing the key,
+// so lookups take no lock, from any thread or process. entries are never
+// removed, when the table is full new conversions are simply not cached.
+//
+// DIR/objects holds the outputs, named by the hash of their bytes, so
+// equal outputs are kept once. they are read only, a hit copies them to
+// the output file with a reflink where the file system can, else with a
+// plain copy, or with a hard link if --cache-link was given, each made
+// under a temporary name and renamed over the output.
+
+#include <stdatomic.h>
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#endif
+
+#define CACHE_MAGIC 0x4548434143424D4DULL // "MBMCACHE"
+#define CACHE_VERSION 1
+#define CACHE_SLOTS (1 << 18) // 8 MB of index, a sparse file until used
+#define CACHE_PROBES 64
+
+// slot keys 0 and 1 are never a hash: free and being written
+#define CACHE_FREE 0
+#define CACHE_BUSY 1
+
+typedef struct cache_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t slots;
+	uint64_t reserved[6];
+} cache_header;
+
+typedef struct cache_slot {
+	_Atomic uint64_t key; // hash of input and options
+	uint64_t in_size; // input bytes, checked on lookup
+	uint64_t out_hash; // names the object
+	uint64_t out_size;
+} cache_slot;
+
+char *cache_dir = NULL;
+uint32_t cache_link = 0;
+
+cache_header *cache_index = NULL;
+cache_slot *cache_slots = NULL;
+uint64_t cache_seed; // hash of the tool, its options and its build
+
+atomic_uint cache_hits = 0;
+atomic_uint cache_misses = 0;
+
+THREAD_LOCAL uint64_t cache_key = 0; // of the file being converted
+THREAD_LOCAL uint64_t cache_in_size = 0;
+THREAD_LOCAL uint64_t cache_size = 0; // output bytes of the last hit
+
+// xxh64 by yann collet: fast, and good enough to tell files apart
+#define CACHE_P1 0x9E3779B185EBCA87ULL
+#define CACHE_P2 0xC2B2AE3D27D4EB4FULL
+#define CACHE_P3 0x165667B19E3779F9ULL
+#define CACHE_P4 0x85EBCA77C2B2AE63ULL
+#define CACHE_P5 0x27D4EB2F165667C5ULL
+
+#define cache_rotl(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint64_t cache_round (uint64_t acc, uint64_t input)
+{
+	acc += input * CACHE_P2;
+	acc = cache_rotl (acc, 31);
+	return (acc * CACHE_P1);
+}
+
+uint64_t cache_merge (uint64_t acc, uint64_t val)
+{
+	acc ^= cache_round (0, val);
+	return ((acc * CACHE_P1) + CACHE_P4);
+}
+
+uint64_t cache_read64 (const unsigned char *p)
+{
+	uint64_t v;
+	memcpy (&v, p, sizeof (v)); // little endian, like the files
+	return v;
+}
+
+uint64_t cache_hash (const unsigned char *data, size_t size, uint64_t seed)
+{
+	const unsigned char *end = (data + size);
+	uint64_t v1, v2, v3, v4, h;
+	uint32_t v;
+
+	if (size >= 32) {
+		v1 = seed + CACHE_P1 + CACHE_P2;
+		v2 = seed + CACHE_P2;
+		v3 = seed;
+		v4 = seed - CACHE_P1;
+
+		while (data <= (end - 32)) {
+			v1 = cache_round (v1, cache_read64 (data));
+			v2 = cache_round (v2, cache_read64 (data + 8));
+			v3 = cache_round (v3, cache_read64 (data + 16));
+			v4 = cache_round (v4, cache_read64 (data + 24));
+			data += 32;
+		}
+
+		h = cache_rotl (v1, 1) + cache_rotl (v2, 7) + cache_rotl (v3, 12) + cache_rotl (v4, 18);
+		h = cache_merge (h, v1);
+		h = cache_merge (h, v2);
+		h = cache_merge (h, v3);
+		h = cache_merge (h, v4);
+
+	} else {
+		h = seed + CACHE_P5;
+	}
+
+	h += (uint64_t) size;
+
+	while (data + 8 <= end) {
+		h ^= cache_round (0, cache_read64 (data));
+		h = (cache_rotl (h, 27) * CACHE_P1) + CACHE_P4;
+		data += 8;
+	}
+
+	if (data + 4 <= end) {
+		memcpy (&v, data, sizeof (v));
+		h ^= (uint64_t) v * CACHE_P1;
+		h = (cache_rotl (h, 23) * CACHE_P2) + CACHE_P3;
+		data += 4;
+	}
+
+	while (data < end) {
+		h ^= (*data++) * CACHE_P5;
+		h = cache_rotl (h, 11) * CACHE_P1;
+	}
+
+	h ^= h >> 33;
+	h *= CACHE_P2;
+	h ^= h >> 29;
+	h *= CACHE_P3;
+	h ^= h >> 32;
+	return h;
+}
+
+// returns 1 if arg is --cache=DIR or --cache-link
+int cache_option (const char *arg)
+{
+	if (strncmp (arg, "--cache=", 8) == 0) {
+		cache_dir = (char *) arg + 8;
+		return 1;
+	}
+
+	if (strcmp (arg, "--cache-link") == 0) {
+		cache_link = 1;
+		return 1;
+	}
+
+	return 0;
+}
+
+#ifndef _WIN32
+
+// maps DIR/index, creating the cache if it isn't there yet. tool and
+// option tell the converters (and their settings) apart.
+void cache_open (const char *tool, uint32_t option)
+{
+	char path[bufsz];
+	char temp[bufsz];
+	cache_header header;
+	size_t size = sizeof (cache_header) + ((size_t) CACHE_SLOTS * sizeof (cache_slot));
+	void *map;
+	int fd;
+
+	if (! cache_dir) {
+		return;
+	}
+
+	cache_seed = cache_hash ((const unsigned char *) tool, strlen (tool), option);
+	cache_seed = cache_hash ((const unsigned char *) __DATE__ __TIME__, strlen (__DATE__ __TIME__), cache_seed);
+
+	snprintf (path, bufsz, "%s/objects", cache_dir);
+	mkdir (cache_dir, 0777);
+	mkdir (path, 0777);
+	snprintf (path, bufsz, "%s/index", cache_dir);
+	fd = open (path, O_RDWR);
+
+	if (fd < 0) {
+		// made under a temporary name and linked into place, so other
+		// processes never see a half made index. if one of them was
+		// quicker, its index is used.
+		snprintf (temp, bufsz, "%s/index.XXXXXX", cache_dir);
+		fd = mkstemp (temp);
+
+		if (fd >= 0) {
+			memset (&header, 0, sizeof (header));
+			header.magic = CACHE_MAGIC;
+			header.version = CACHE_VERSION;
+			header.slots = CACHE_SLOTS;
+
+			if ((fchmod (fd, 0644) != 0) || (ftruncate (fd, size) != 0) || (write (fd, &header, sizeof (header)) != sizeof (header))) {
+				close (fd);
+				fd = -1;
+
+			} else {
+				close (fd);
+				link (temp, path);
+				fd = open (path, O_RDWR);
+			}
+
+			unlink (temp);
+		}
+	}
+
+	if (fd < 0) {
+		fprintf (stderr, "\ncan't open cache %s\n", path);
+		fflush (stderr);
+		cache_dir = NULL;
+		return;
+	}
+
+	map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+
+	if ((map == MAP_FAILED) || (((cache_header *) map)->magic != CACHE_MAGIC)
+		|| (((cache_header *) map)->version != CACHE_VERSION) || (((cache_header *) map)->slots != CACHE_SLOTS)) {
+		if (map != MAP_FAILED) {
+			munmap (map, size);
+		}
+
+		fprintf (stderr, "\n%s is not a cache index\n", path);
+		fflush (stderr);
+		cache_dir = NULL;
+		return;
+	}
+
+	cache_index = (cache_header *) map;
+	cache_slots = (cache_slot *) (cache_index + 1);
+}
+
+// returns the slot holding key, NULL if there is none
+cache_slot *cache_find (uint64_t key, uint64_t in_size)
+{
+	cache_slot *slot;
+	uint64_t found;
+	uint32_t n;
+
+	for (n = 0; n < CACHE_PROBES; n++) {
+		slot = &cache_slots[(key + n) & (CACHE_SLOTS - 1)];
+		found = atomic_load_explicit (&slot->key, memory_order_acquire);
+
+		if (found == CACHE_FREE) {
+			return NULL;
+		}
+
+		if ((found == key) && (slot->in_size == in_size)) {
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+// in aio.c, which is included after this file
+int aio_temp (const char *name, char *temp);
+int aio_rename (const char *temp, const char *name, int error);
+
+// copies the object to the output: reflink, hard link or plain copy. like
+// a conversion, it is made as a temporary file renamed over the output,
+// so the output is never missing or partial, and stays if this fails.
+int cache_copy (const char *object, const char *outfile, uint64_t size)
+{
+	char temp[bufsz];
+	unsigned char data[bufsz];
+	ssize_t len;
+	uint64_t done = 0;
+	int in, out;
+	int cloned = 0;
+	int linked;
+
+	out = aio_temp (outfile, temp);
+
+	if (out < 0) {
+		return 0;
+	}
+
+	if (cache_link) {
+		// the link takes the name of the temporary file
+		close (out);
+		unlink (temp);
+
+		if (link (object, temp) == 0) {
+			linked = (rename (temp, outfile) == 0);
+			unlink (temp); // still there if outfile already was this link
+			return linked;
+		}
+
+		out = aio_temp (outfile, temp);
+
+		if (out < 0) {
+			return 0;
+		}
+	}
+
+	in = open (object, O_RDONLY);
+
+	if (in < 0) {
+		close (out);
+		aio_rename (temp, outfile, 3);
+		return 0;
+	}
+
+#ifdef FICLONE
+	cloned = (ioctl (out, FICLONE, in) == 0);
+#endif
+
+	if (cloned) {
+		done = size;
+	}
+
+	while (done < size) {
+		len = read (in, data, bufsz);
+
+		if ((len <= 0) || (write (out, data, len) != len)) {
+			break;
+		}
+
+		done += len;
+	}
+
+	close (in);
+
+	if ((close (out) != 0) || (done != size)) {
+		aio_rename (temp, outfile, 5);
+		return 0;
+	}
+
+	return (aio_rename (temp, outfile, 0) == 0);
+}
+
+// hashes the input. returns 1 if its output was in the cache and has
+// been written to outfile, 0 if it has to be converted.
+int cache_fetch (const unsigned char *data, size_t size, const char *outfile)
+{
+	char object[bufsz];
+	struct stat st;
+	cache_slot *slot;
+	double start;
+
+	cache_key = 0;
+
+	if (! cache_index) {
+		return 0;
+	}
+
+	start = lodepng_stats_clock (&stats);
+	cache_key = cache_hash (data, size, cache_seed);
+	cache_key = (cache_key <= CACHE_BUSY) ? (cache_key + 2) : cache_key;
+	cache_in_size = size;
+	slot = cache_find (cache_key, size);
+
+	if (slot) {
+		snprintf (object, bufsz, "%s/objects/%016" PRIx64, cache_dir, slot->out_hash);
+
+		if ((stat (object, &st) == 0) && ((uint64_t) st.st_size == slot->out_size)
+			&& cache_copy (object, outfile, slot->out_size)) {
+			cache_size = slot->out_size;
+			atomic_fetch_add (&cache_hits, 1);
+			lodepng_stats_add (&stats, LSP_CACHE, start, cache_size);
+			return 1;
+		}
+	}
+
+	atomic_fetch_add (&cache_misses, 1);
+	lodepng_stats_add (&stats, LSP_CACHE, start, 0);
+	return 0;
+}
+
+// adds the output just written for the input given to cache_fetch ()
+void cache_store (const char *outfile)
+{
+	char object[bufsz];
+	char temp[bufsz];
+	struct stat st;
+	cache_slot *slot;
+	unsigned char *data = NULL;
+	uint64_t out_hash, expected;
+	uint32_t n;
+	double start;
+	int fd, obj;
+	int cloned = 0;
+
+	if ((! cache_index) || (! cache_key)) {
+		return;
+	}
+
+	start = lodepng_stats_clock (&stats);
+	fd = open (outfile, O_RDONLY);
+
+	if ((fd < 0) || (fstat (fd, &st) != 0)) {
+		if (fd >= 0) {
+			close (fd);
+		}
+
+		return;
+	}
+
+	if (st.st_size) {
+		data = (unsigned char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (data == MAP_FAILED) {
+			close (fd);
+			return;
+		}
+	}
+
+	out_hash = cache_hash (data, st.st_size, 0);
+	snprintf (object, bufsz, "%s/objects/%016" PRIx64, cache_dir, out_hash);
+
+	if (access (object, F_OK) != 0) {
+		snprintf (temp, bufsz, "%s/objects/.XXXXXX", cache_dir);
+		obj = mkstemp (temp);
+
+		if (obj >= 0) {
+#ifdef FICLONE
+			cloned = (ioctl (obj, FICLONE, fd) == 0);
+#endif
+
+			if ((! cloned) && st.st_size && (write (obj, data, st.st_size) != st.st_size)) {
+				close (obj);
+				obj = -1;
+			}
+
+			if ((obj >= 0) && (fchmod (obj, 0444) == 0) && (close (obj) == 0)) {
+				rename (temp, object);
+			}
+
+			unlink (temp); // only left if something failed
+		}
+	}
+
+	if (data) {
+		munmap (data, st.st_size);
+	}
+
+	close (fd);
+
+	if (access (object, F_OK) != 0) {
+		return;
+	}
+
+	for (n = 0; n < CACHE_PROBES; n++) {
+		slot = &cache_slots[(cache_key + n) & (CACHE_SLOTS - 1)];
+		expected = CACHE_FREE;
+
+		if (atomic_compare_exchange_strong (&slot->key, &expected, CACHE_BUSY)) {
+			slot->in_size = cache_in_size;
+			slot->out_hash = out_hash;
+			slot->out_size = st.st_size;
+			atomic_store_explicit (&slot->key, cache_key, memory_order_release);
+			break;
+		}
+
+		if ((expected == cache_key) && (slot->in_size == cache_in_size)) {
+			break; // another process was quicker
+		}
+	}
+
+	cache_key = 0;
+	lodepng_stats_add (&stats, LSP_CACHE, start, st.st_size);
+}
+
+void cache_close (void)
+{
+	if (! cache_index) {
+		return;
+	}
+
+	if (stats_mode == STATS_TABLE) { // the json has the cache phase
+		fprintf (stderr, "\ncache: %u hits, %u misses\n", atomic_load (&cache_hits), atomic_load (&cache_misses));
+		fflush (stderr);
+	}
+
+	munmap (cache_index, sizeof (cache_header) + ((size_t) CACHE_SLOTS * sizeof (cache_slot)));
+	cache_index = NULL;
+	cache_slots = NULL;
+}
+
+#else // the cache needs mmap and links, windows converts every time
+
+void cache_open (const char *tool, uint32_t option)
+{
+	(void) tool;
+	(void) option;
+
+	if (cache_dir) {
+		fprintf (stderr, "\n--cache is not supported on windows\n");
+		fflush (stderr);
+	}
+}
+
+int cache_fetch (const unsigned char *data, size_t size, const char *outfile)
+{
+	(void) data;
+	(void) size;
+	(void) outfile;
+	return 0;
+}
+
+void cache_store (const char *outfile)
+{
+	(void) outfile;
+}
+
+void cache_close (void)
+{
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * check_type.c - decides the "type" field (normal map or not) of 32 bit
+ * Kerbal Space Program textures. Shared by png2mbm and tga2mbm.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CHECK_TYPE_SSE2
+#endif
+
+// average red/blue difference (of the pixels where they differ)
+// below which a texture is a normal map
+#define NORMAL_DELTA 8
+
+// sampling mode: default percentage of rows, least number of rows,
+// and the confidence bound in standard errors (about 99.9% two sided)
+#define SAMPLE_PERCENT 5
+#define SAMPLE_MIN_ROWS 32
+#define SAMPLE_Z 3.29
+
+// sums |r-b| and counts the pixels with r != b over a run of rgba (or bgra) pixels
+void rb_delta (const unsigned char *buf, uint32_t pixels, uint64_t *delta, uint64_t *count)
+{
+	uint32_t x = 0;
+	uint32_t r, b;
+
+#ifdef CHECK_TYPE_SSE2
+	const __m128i lowbyte = _mm_set1_epi32 (0xFF);
+	__m128i sum = _mm_setzero_si128 ();
+	__m128i same = _mm_setzero_si128 ();
+	uint64_t sums[2];
+	uint32_t equal[4];
+
+	for (x = 0; (x + 4) <= pixels; x += 4) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *) (buf + (x * 4)));
+		__m128i rv = _mm_and_si128 (v, lowbyte);
+		__m128i bv = _mm_and_si128 (_mm_srli_epi32 (v, 16), lowbyte);
+		// only the low byte of each lane is non-zero, so the byte wise
+		// sum of absolute differences is the sum of |r-b|
+		sum = _mm_add_epi64 (sum, _mm_sad_epu8 (rv, bv));
+		same = _mm_sub_epi32 (same, _mm_cmpeq_epi32 (rv, bv));
+	}
+
+	_mm_storeu_si128 ((__m128i *) sums, sum);
+	_mm_storeu_si128 ((__m128i *) equal, same);
+	*delta += (sums[0] + sums[1]);
+	*count += (x - ((uint64_t) equal[0] + equal[1] + equal[2] + equal[3]));
+#endif
+
+	for (; x < pixels; x++) {
+		r = * (buf + (x * 4) + 0);
+		b = * (buf + (x * 4) + 2);
+
+		if (r != b) {
+			(*count)++;
+			*delta += (r < b) ? (b - r) : (r - b);
+		}
+	}
+}
+
+// stratified sampling: the rows are split into bands and one row at a
+// (fixed) pseudo random position is taken from each band. each row gives
+// the mean of (|r-b| - NORMAL_DELTA) over its pixels, counting pixels with
+// r == b as zero. the texture is a normal map if the mean over the whole
+// image is below zero. returns -1 if the estimate is within SAMPLE_Z
+// standard errors of zero, so the caller has to look at every pixel.
+int check_type_sampled (const unsigned char *buf, uint32_t width, uint32_t height, uint32_t percent)
+{
+	uint32_t rows, band, row, seed = 0x4D424D31;
+	uint64_t delta, count, total = 0;
+	double mean, sum = 0.0, sumsq = 0.0, var, m;
+
+	rows = (uint32_t) (((uint64_t) height * percent) / 100);
+
+	if (rows < SAMPLE_MIN_ROWS) {
+		rows = SAMPLE_MIN_ROWS;
+	}
+
+	if ((rows * 2) > height) {
+		return -1; // not worth it, the full pass is almost as fast
+	}
+
+	for (band = 0; band < rows; band++) {
+		uint32_t first = (uint32_t) (((uint64_t) height * band) / rows);
+		uint32_t last = (uint32_t) (((uint64_t) height * (band + 1)) / rows);
+		seed = (seed * 1103515245) + 12345;
+		row = first + ((seed >> 8) % (last - first));
+		delta = count = 0;
+		rb_delta (buf + ((size_t) row * width * 4), width, &delta, &count);
+		m = ((double) delta - ((double) NORMAL_DELTA * count)) / width;
+		sum += m;
+		sumsq += (m * m);
+		total += count;
+	}
+
+	if (! total) {
+		return -1; // sampled rows all have r == b, which says little
+	}
+
+	mean = sum / rows;
+	// variance of the mean, with finite population correction
+	var = ((sumsq - (sum * mean)) / (rows - 1)) / rows;
+	var *= (1.0 - ((double) rows / height));
+
+	if ((mean * mean) <= (SAMPLE_Z * SAMPLE_Z * var)) {
+		return -1;
+	}
+
+	return (mean < 0.0) ? 1 : 0;
+}
+
+// returns 1 for a normal map, 0 otherwise. buf holds width * height
+// rgba (or bgra) pixels. if sample is non-zero, first tries to decide
+// from that percentage of the rows.
+uint32_t check_type (const unsigned char *buf, uint32_t width, uint32_t height, uint32_t sample)
+{
+	uint64_t delta = 0;
+	uint64_t count = 0;
+	int result;
+
+	if (sample) {
+		result = check_type_sampled (buf, width, height, sample);
+
+		if (result >= 0) {
+			return (uint32_t) result;
+		}
+	}
+
+	rb_delta (buf, (width * height), &delta, &count);
+
+	// same as (delta / count) < NORMAL_DELTA, without the rounding
+	return ((count == 0) || (delta < (NORMAL_DELTA * count))) ? 1 : 0;
+}
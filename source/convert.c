@@ -0,0 +1,365 @@
+/*
+ * convert.c - converts Kerbal Space Program textures, png and tga images
+ * into each other in memory. Shared by mbmconv and mbmd, after tga.c and
+ * check_type.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// where the pixels and the output go is up to the program: make () is
+// asked for the memory of the pixels (CONVERT_PIXELS) and of an mbm or
+// tga output file (CONVERT_FILE), which may be the mapping of the output
+// file itself. the pixels of an mbm output are made right in its file.
+// a png output is made by lodepng, the program writes and frees it.
+//
+// usage:
+//
+//   convert_job job;
+//
+//   memset (&job, 0, sizeof (job));
+//   job.in = buf; job.in_size = size;
+//   job.from = convert_sniff (buf, size); job.to = FMT_PNG;
+//   job.make = my_make; job.arg = my_data;
+//   erc = convert_decode (&job);
+//   erc = erc ? erc : convert_encode (&job);
+//   write job.file_size bytes at job.file, and lodepng_free () a png
+//
+// the return values are the error numbers of mbmconv, convert_error[].
+
+// the formats, as input and output
+#define FMT_NONE 0
+#define FMT_MBM 1
+#define FMT_PNG 2
+#define FMT_TGA 3
+
+// what make () is asked for
+#define CONVERT_PIXELS 0
+#define CONVERT_FILE 1
+
+const char *convert_error[] = {
+	"",
+	"malloc",
+	"open for read",
+	"open for write",
+	"read image",
+	"write image",
+	"header check",
+	"image type",
+	"image convert",
+	"image decode",
+	"input type",
+	"image size",
+};
+
+typedef struct convert_job {
+	// set by the program
+	const unsigned char *in; // the input file
+	size_t in_size;
+	uint32_t from; // FMT_MBM, FMT_PNG or FMT_TGA
+	uint32_t to;
+	uint32_t sample; // rows looked at by check_type (), 0 for all
+	uint32_t rle; // an rle tga output
+	uint32_t interlace; // an adam7 png output
+	LodePNGStats *stats; // or NULL
+	unsigned char *(*make) (void *arg, uint32_t what, size_t size);
+	void *arg;
+
+	// set by convert_decode () and convert_encode ()
+	uint32_t width;
+	uint32_t height;
+	uint32_t type;
+	uint32_t bits;
+	uint32_t bytes;
+	uint32_t bpl;
+	uint32_t imgsize;
+	unsigned char *pixels; // bottom row first, top row first for a png output
+	unsigned char *file; // the output file
+	size_t file_size;
+	unsigned png_error; // of lodepng, for errors 8 and 9
+} convert_job;
+
+// tells the format of a file from its first bytes. tga has no magic
+// number, a header it can be read with (and only 0 or 1 as color map
+// type) is taken as one.
+uint32_t convert_sniff (const unsigned char *buf, size_t size)
+{
+	const unsigned char png_sig[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	tga_info check;
+
+	if ((size >= mbm_ofs) && (* ((uint32_t *) (buf + magic_ofs)) == MAGIC)) {
+		return FMT_MBM;
+	}
+
+	if ((size >= (png_ihdr + 4)) && (memcmp (buf, png_sig, 8) == 0)
+		&& (lodepng_read32bitInt (buf + png_ihdr) == IHDR)) {
+		return FMT_PNG;
+	}
+
+	if ((tga_header (&check, buf, size) == 0) && (buf[ColorMapType] <= 1)
+		&& check.width && check.height) {
+		return FMT_TGA;
+	}
+
+	return FMT_NONE;
+}
+
+// sets bpl and imgsize for the width, height and bytes. returns 0, or 11
+// if the pixels are more than an mbm (its size 32 bit) can hold.
+int convert_size (convert_job *job)
+{
+	uint64_t size = ((uint64_t) job->width * job->height * job->bytes);
+
+	if ((size > TGA_MBM_MAX) || (((uint64_t) job->width * job->bytes) > TGA_MBM_MAX)) {
+		return 11;
+	}
+
+	job->bpl = (job->width * job->bytes);
+	job->imgsize = (uint32_t) size;
+	return 0;
+}
+
+// gets the memory for the pixels: for an mbm output, the pixels of the
+// output file itself. returns 0 or the error number.
+int convert_pixels (convert_job *job)
+{
+	if (job->to == FMT_MBM) {
+		job->file_size = (job->imgsize + mbm_ofs);
+		job->file = job->make (job->arg, CONVERT_FILE, job->file_size);
+		job->pixels = job->file ? (job->file + mbm_ofs) : NULL;
+		return job->pixels ? 0 : 3;
+	}
+
+	job->pixels = job->make (job->arg, CONVERT_PIXELS, (job->imgsize ? job->imgsize : 1));
+	return job->pixels ? 0 : 1;
+}
+
+// decodes the input into pixels: rows bottom first for mbm and tga
+// outputs, top first for png. returns 0 or the error number.
+int convert_decode (convert_job *job)
+{
+	LodePNGState state;
+	tga_info tga;
+	uint32_t topdown = (job->to == FMT_PNG);
+	uint32_t erc, n, y;
+	double start = lodepng_stats_clock (job->stats);
+
+	if (job->from == FMT_MBM) {
+		job->width = * ((uint32_t *) (job->in + width_ofs));
+		job->height = * ((uint32_t *) (job->in + height_ofs));
+		job->type = * ((uint32_t *) (job->in + type_ofs));
+		job->bits = * ((uint32_t *) (job->in + bits_ofs));
+
+		if ((job->bits != 24) && (job->bits != 32)) {
+			return 7;
+		}
+
+		job->bytes = (job->bits / 8);
+		erc = convert_size (job);
+
+		if (erc) {
+			return erc;
+		}
+
+		if ((job->in_size - mbm_ofs) < job->imgsize) {
+			return 4;
+		}
+
+		lodepng_stats_add (job->stats, LSP_HEADER, start, mbm_ofs);
+
+		// a tga output is made from the pixels of the input as they are
+		if (! topdown) {
+			job->pixels = (unsigned char *) (job->in + mbm_ofs);
+			return 0;
+		}
+
+		start = lodepng_stats_clock (job->stats);
+		erc = convert_pixels (job);
+
+		if (erc) {
+			return erc;
+		}
+
+		for (y = 0; y < job->height; y++) {
+			memcpy ((job->pixels + ((size_t) job->bpl * y)),
+				(job->in + mbm_ofs + ((size_t) job->bpl * (job->height - 1 - y))), job->bpl);
+		}
+
+		lodepng_stats_add (job->stats, LSP_FLIP, start, job->imgsize);
+		return 0;
+	}
+
+	if (job->from == FMT_TGA) {
+		erc = tga_header (&tga, job->in, job->in_size);
+
+		if (erc) {
+			return erc;
+		}
+
+		job->width = tga.width;
+		job->height = tga.height;
+		job->bits = tga.bits;
+		job->bytes = tga.bytes;
+		erc = convert_size (job);
+
+		if (erc) {
+			return erc;
+		}
+
+		lodepng_stats_add (job->stats, LSP_HEADER, start, tga.pixel_ofs);
+		start = lodepng_stats_clock (job->stats);
+		erc = convert_pixels (job);
+
+		if (erc) {
+			return erc;
+		}
+
+		// the same kernels as tga2mbm, told the tga is upside down for a png
+		tga.top ^= topdown;
+
+		if (tga.imgtype == TGA_TRUECOLOR_RLE) {
+			erc = tga_rle_to_mbm (job->pixels, (job->in + tga.pixel_ofs), (job->in_size - tga.pixel_ofs), &tga);
+
+		} else {
+			tga_to_mbm (job->pixels, (job->in + tga.pixel_ofs), &tga);
+		}
+
+		lodepng_stats_add (job->stats, LSP_FLIP, start, job->imgsize);
+		return erc;
+	}
+
+	lodepng_state_init (&state);
+	state.stats = job->stats;
+	job->png_error = lodepng_inspect_chunks (&job->width, &job->height, &state, job->in, job->in_size);
+
+	if (job->png_error) {
+		lodepng_state_cleanup (&state);
+		return 9;
+	}
+
+	// like png2mbm: an alpha channel if the png can have one, or if
+	// mbm2png noted that the original mbm had one
+	job->bits = lodepng_can_have_alpha (&state.info_png.color) ? 32 : 24;
+
+	for (n = 0; n < state.info_png.text_num; n++) {
+		if ((strcmp (state.info_png.text_keys[n], BITS_KEY) == 0)
+			&& (atoi (state.info_png.text_strings[n]) == 32)) {
+			job->bits = 32;
+		}
+	}
+
+	job->bytes = (job->bits / 8);
+	state.info_raw.colortype = (job->bytes == 4) ? LCT_RGBA : LCT_RGB;
+	state.info_raw.bitdepth = 8;
+	erc = convert_size (job);
+
+	if (! erc) {
+		erc = convert_pixels (job);
+	}
+
+	if (erc) {
+		lodepng_state_cleanup (&state);
+		return erc;
+	}
+
+	job->png_error = lodepng_decode_into ((job->pixels + (topdown ? 0 : ((size_t) job->bpl * (job->height - 1)))),
+		(topdown ? (long) job->bpl : -((long) job->bpl)), job->width, job->height, &state, job->in, job->in_size);
+	lodepng_state_cleanup (&state);
+	return job->png_error ? 9 : 0;
+}
+
+// encodes the pixels as the output, into job->file. returns 0 or the
+// error number.
+int convert_encode (convert_job *job)
+{
+	LodePNGState state;
+	tga_info tga;
+	uint64_t size;
+	double start;
+
+	if (job->to == FMT_MBM) {
+		if (job->bytes == 4) {
+			start = lodepng_stats_clock (job->stats);
+			job->type = check_type (job->pixels, job->width, job->height, job->sample);
+			lodepng_stats_add (job->stats, LSP_CHECK_TYPE, start, job->imgsize);
+
+		} else {
+			job->type = 0;
+		}
+
+		* ((uint32_t *) (job->file + magic_ofs)) = MAGIC;
+		* ((uint32_t *) (job->file + width_ofs)) = job->width;
+		* ((uint32_t *) (job->file + height_ofs)) = job->height;
+		* ((uint32_t *) (job->file + type_ofs)) = job->type;
+		* ((uint32_t *) (job->file + bits_ofs)) = job->bits;
+		return 0;
+	}
+
+	if (job->to == FMT_TGA) {
+		// the header has 16 bits for each side, and the file 32 for its size
+		size = job->rle ? (uint64_t) tga_rle_bound (job->width, job->height, job->bytes) : job->imgsize;
+
+		if ((job->width > 0xFFFF) || (job->height > 0xFFFF) || ((size + tga_ofs) > 0xFFFFFFFFULL)) {
+			return 11;
+		}
+
+		start = lodepng_stats_clock (job->stats);
+		job->file_size = (size_t) (size + tga_ofs);
+		job->file = job->make (job->arg, CONVERT_FILE, job->file_size);
+
+		if (! job->file) {
+			return 3;
+		}
+
+		memset (job->file, 0, tga_ofs);
+		* ((uint8_t *) (job->file + ImageType)) = job->rle ? TGA_TRUECOLOR_RLE : TGA_TRUECOLOR;
+		* ((uint16_t *) (job->file + Width)) = job->width;
+		* ((uint16_t *) (job->file + Height)) = job->height;
+		* ((uint8_t *) (job->file + PixelDepth)) = job->bits;
+
+		if (job->rle) {
+			job->file_size = (tga_rle_from_mbm ((job->file + tga_ofs), job->pixels, job->width, job->height, job->bytes) + tga_ofs);
+
+		} else {
+			// swapping red and blue back is the same as swapping them there
+			tga.width = job->width;
+			tga.height = job->height;
+			tga.bytes = job->bytes;
+			tga.top = 0;
+			tga.right = 0;
+			tga_to_mbm ((job->file + tga_ofs), job->pixels, &tga);
+		}
+
+		lodepng_stats_add (job->stats, LSP_FLIP, start, job->imgsize);
+		return 0;
+	}
+
+	lodepng_state_init (&state);
+	state.stats = job->stats;
+	state.info_png.interlace_method = job->interlace;
+	state.info_raw.colortype = (job->bytes == 3) ? LCT_RGB : LCT_RGBA;
+	lodepng_add_text (&state.info_png, BITS_KEY, (job->bytes == 3) ? "24" : "32");
+	job->png_error = lodepng_encode (&job->file, &job->file_size, job->pixels, job->width, job->height, &state);
+	lodepng_state_cleanup (&state);
+
+	if (job->png_error) {
+		lodepng_free (job->file);
+		job->file = NULL;
+		return 8;
+	}
+
+	return 0;
+}
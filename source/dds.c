@@ -0,0 +1,501 @@
+/*
+ * dds.c - compresses Kerbal Space Program textures to BC1 (DXT1) and BC3
+ * (DXT5) blocks and writes the DDS header. Used by mbm2dds.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// each 4x4 block of pixels becomes two 565 colors and a 2 bit index per
+// pixel (bc1, 8 bytes), plus for bc3 two alpha values and a 3 bit index
+// per pixel (16 bytes). the ends are taken from the bounding box of the
+// block (inset a little, along the diagonal the colors follow), and each
+// pixel gets the nearest of the 4 (or 8) values between them. the rows
+// of blocks are shared out among threads.
+//
+// the rows stay in mbm order, bottom first, which is how ksp loads dds
+// textures (other viewers show them upside down).
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DDS_SSE2
+#endif
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define DDS_HEADER 128 // "DDS " and the header
+#define DDS_BC1 8 // bytes per block
+#define DDS_BC3 16
+#define DDS_THREADS 32 // most threads for one texture
+#define DDS_MIN_BLOCKS 1024 // fewest blocks worth a thread
+
+// what a thread compresses: block rows first, first + step, ...
+typedef struct dds_job {
+	unsigned char *out;
+	const unsigned char *in;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes; // of an mbm pixel, 3 or 4
+	uint32_t format; // DDS_BC1 or DDS_BC3
+	uint32_t normal; // dxt5nm: x in alpha, y in green
+	uint32_t first;
+	uint32_t step;
+} dds_job;
+
+void dds_put32 (unsigned char *out, uint32_t value)
+{
+	out[0] = (value & 0xFF);
+	out[1] = ((value >> 8) & 0xFF);
+	out[2] = ((value >> 16) & 0xFF);
+	out[3] = ((value >> 24) & 0xFF);
+}
+
+// the size of the blocks of one texture
+size_t dds_size (uint32_t width, uint32_t height, uint32_t format)
+{
+	return ((size_t) ((width + 3) / 4) * ((height + 3) / 4) * format);
+}
+
+// writes "DDS " and the header of a texture with levels mip levels
+void dds_header (unsigned char *out, uint32_t width, uint32_t height, uint32_t format, uint32_t levels)
+{
+	memset (out, 0, DDS_HEADER);
+	memcpy (out, "DDS ", 4);
+	dds_put32 (out + 4, 124); // header size
+	// caps, height, width, pixel format, linear size (and mip count)
+	dds_put32 (out + 8, 0x00081007 | ((levels > 1) ? 0x00020000 : 0));
+	dds_put32 (out + 12, height);
+	dds_put32 (out + 16, width);
+	dds_put32 (out + 20, (uint32_t) dds_size (width, height, format));
+	dds_put32 (out + 28, levels);
+	dds_put32 (out + 76, 32); // pixel format size
+	dds_put32 (out + 80, 0x04); // four cc
+	memcpy (out + 84, (format == DDS_BC1) ? "DXT1" : "DXT5", 4);
+	// texture (and complex, mipmap)
+	dds_put32 (out + 108, 0x00001000 | ((levels > 1) ? 0x00400008 : 0));
+}
+
+// copies the 4x4 block at (bx, by) into 16 rgba pixels, repeating the
+// last column and row past the edge of the texture. a normal map keeps
+// x in alpha and y in green, and has y in red and blue as well (it
+// mostly is already), so all of the color block goes to y.
+void dds_block_get (unsigned char *block, const dds_job *job, uint32_t bx, uint32_t by)
+{
+	const unsigned char *px;
+	uint32_t i, j, x, y;
+
+	for (j = 0; j < 4; j++) {
+		y = ((by * 4) + j);
+		y = (y < job->height) ? y : (job->height - 1);
+
+		for (i = 0; i < 4; i++, block += 4) {
+			x = ((bx * 4) + i);
+			x = (x < job->width) ? x : (job->width - 1);
+			px = (job->in + ((((size_t) y * job->width) + x) * job->bytes));
+			block[0] = job->normal ? px[1] : px[0];
+			block[1] = px[1];
+			block[2] = job->normal ? px[1] : px[2];
+			block[3] = (job->bytes == 4) ? px[3] : 0xFF;
+		}
+	}
+}
+
+// the smallest and largest value of each channel of a block
+void dds_minmax (const unsigned char *block, unsigned char *lo, unsigned char *hi)
+{
+#ifdef DDS_SSE2
+	__m128i a = _mm_loadu_si128 ((const __m128i *) (block + 0));
+	__m128i b = _mm_loadu_si128 ((const __m128i *) (block + 16));
+	__m128i c = _mm_loadu_si128 ((const __m128i *) (block + 32));
+	__m128i d = _mm_loadu_si128 ((const __m128i *) (block + 48));
+	__m128i mn = _mm_min_epu8 (_mm_min_epu8 (a, b), _mm_min_epu8 (c, d));
+	__m128i mx = _mm_max_epu8 (_mm_max_epu8 (a, b), _mm_max_epu8 (c, d));
+	int32_t v;
+
+	// fold the four pixels of each register into one
+	mn = _mm_min_epu8 (mn, _mm_shuffle_epi32 (mn, _MM_SHUFFLE (2, 3, 0, 1)));
+	mn = _mm_min_epu8 (mn, _mm_shuffle_epi32 (mn, _MM_SHUFFLE (1, 0, 3, 2)));
+	mx = _mm_max_epu8 (mx, _mm_shuffle_epi32 (mx, _MM_SHUFFLE (2, 3, 0, 1)));
+	mx = _mm_max_epu8 (mx, _mm_shuffle_epi32 (mx, _MM_SHUFFLE (1, 0, 3, 2)));
+	v = _mm_cvtsi128_si32 (mn);
+	memcpy (lo, &v, 4);
+	v = _mm_cvtsi128_si32 (mx);
+	memcpy (hi, &v, 4);
+#else
+	uint32_t n, k;
+
+	memcpy (lo, block, 4);
+	memcpy (hi, block, 4);
+
+	for (n = 4; n < 64; n += 4) {
+		for (k = 0; k < 4; k++) {
+			lo[k] = (block[n + k] < lo[k]) ? block[n + k] : lo[k];
+			hi[k] = (block[n + k] > hi[k]) ? block[n + k] : hi[k];
+		}
+	}
+#endif
+}
+
+// the position of each pixel along the line from p0 to p1, as a level
+// from 0 (p0) to steps (p1)
+void dds_levels (uint32_t *level, const unsigned char *block, const int *p0, const int *p1, uint32_t steps)
+{
+	int d[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	int dd = ((d[0] * d[0]) + (d[1] * d[1]) + (d[2] * d[2]));
+	int base = ((p0[0] * d[0]) + (p0[1] * d[1]) + (p0[2] * d[2]));
+	float scale = ((float) steps / (float) dd);
+	uint32_t n = 0;
+	int t;
+
+#ifdef DDS_SSE2
+	const __m128i zero = _mm_setzero_si128 ();
+	const __m128i dir = _mm_set_epi16 (0, d[2], d[1], d[0], 0, d[2], d[1], d[0]);
+	const __m128 scales = _mm_set1_ps (scale);
+	const __m128i top = _mm_set1_epi32 ((int) steps);
+	__m128i px, lo, hi, dot, q;
+
+	for (; n < 16; n += 4) {
+		px = _mm_loadu_si128 ((const __m128i *) (block + (n * 4)));
+		// dot products of rgb with the direction: one madd gives r*dr + g*dg
+		// and b*db per pixel, the pairs are added up after
+		lo = _mm_madd_epi16 (_mm_unpacklo_epi8 (px, zero), dir);
+		hi = _mm_madd_epi16 (_mm_unpackhi_epi8 (px, zero), dir);
+		dot = _mm_add_epi32 (
+			_mm_castps_si128 (_mm_shuffle_ps (_mm_castsi128_ps (lo), _mm_castsi128_ps (hi), _MM_SHUFFLE (2, 0, 2, 0))),
+			_mm_castps_si128 (_mm_shuffle_ps (_mm_castsi128_ps (lo), _mm_castsi128_ps (hi), _MM_SHUFFLE (3, 1, 3, 1))));
+		dot = _mm_sub_epi32 (dot, _mm_set1_epi32 (base));
+		q = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (_mm_cvtepi32_ps (dot), scales), _mm_set1_ps (0.5f)));
+		// clamp to 0 ... steps
+		q = _mm_and_si128 (q, _mm_cmpgt_epi32 (q, zero));
+		q = _mm_or_si128 (_mm_and_si128 (_mm_cmpgt_epi32 (q, top), top), _mm_andnot_si128 (_mm_cmpgt_epi32 (q, top), q));
+		_mm_storeu_si128 ((__m128i *) (level + n), q);
+	}
+#endif
+
+	for (; n < 16; n++) {
+		t = ((block[(n * 4) + 0] * d[0]) + (block[(n * 4) + 1] * d[1]) + (block[(n * 4) + 2] * d[2])) - base;
+		t = (int) (((float) t * scale) + 0.5f);
+		level[n] = (t < 0) ? 0 : ((t > (int) steps) ? steps : (uint32_t) t);
+	}
+}
+
+uint32_t dds_565 (const int *rgb)
+{
+	return ((((rgb[0] * 31) + 127) / 255) << 11) | ((((rgb[1] * 63) + 127) / 255) << 5) | (((rgb[2] * 31) + 127) / 255);
+}
+
+void dds_888 (uint32_t c, int *rgb)
+{
+	rgb[0] = (((c >> 11) & 0x1F) << 3) | ((c >> 13) & 0x07);
+	rgb[1] = (((c >> 5) & 0x3F) << 2) | ((c >> 9) & 0x03);
+	rgb[2] = ((c & 0x1F) << 3) | ((c >> 2) & 0x07);
+}
+
+// the indices of a block for the colors c0 > c1 (565), and their squared
+// error. level gets the level of each pixel, from 0 (c0) to 3 (c1).
+uint32_t dds_color_fit (const unsigned char *block, uint32_t c0, uint32_t c1, uint32_t *level, uint32_t *err)
+{
+	// index of each level: c0, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1, c1
+	const uint32_t order[4] = { 0, 2, 3, 1 };
+	int p0[3], p1[3], pal[4][3];
+	uint32_t bits = 0;
+	uint32_t n, k;
+	int e;
+
+	dds_888 (c0, p0);
+	dds_888 (c1, p1);
+
+	for (k = 0; k < 3; k++) {
+		pal[0][k] = p0[k];
+		pal[1][k] = (((2 * p0[k]) + p1[k]) / 3);
+		pal[2][k] = ((p0[k] + (2 * p1[k])) / 3);
+		pal[3][k] = p1[k];
+	}
+
+	dds_levels (level, block, p0, p1, 3);
+	*err = 0;
+
+	for (n = 0; n < 16; n++) {
+		bits |= (order[level[n]] << (n * 2));
+
+		for (k = 0; k < 3; k++) {
+			e = (block[(n * 4) + k] - pal[level[n]][k]);
+			*err += (e * e);
+		}
+	}
+
+	return bits;
+}
+
+// the two ends that fit the pixels best (least squares) for the levels
+// they got. returns 0 if they all got the same level.
+int dds_refine (const unsigned char *block, const uint32_t *level, int *e0, int *e1)
+{
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f };
+	float bx[3] = { 0.0f, 0.0f, 0.0f };
+	float a, b, det, v;
+	uint32_t n, k;
+
+	for (n = 0; n < 16; n++) {
+		a = ((float) (3 - level[n]) / 3.0f);
+		b = ((float) level[n] / 3.0f);
+		aa += (a * a);
+		bb += (b * b);
+		ab += (a * b);
+
+		for (k = 0; k < 3; k++) {
+			ax[k] += (a * block[(n * 4) + k]);
+			bx[k] += (b * block[(n * 4) + k]);
+		}
+	}
+
+	det = ((aa * bb) - (ab * ab));
+
+	if (det < 0.5f) {
+		return 0;
+	}
+
+	for (k = 0; k < 3; k++) {
+		v = (((ax[k] * bb) - (bx[k] * ab)) / det) + 0.5f;
+		e0[k] = (v < 0.0f) ? 0 : ((v > 255.0f) ? 255 : (int) v);
+		v = (((bx[k] * aa) - (ax[k] * ab)) / det) + 0.5f;
+		e1[k] = (v < 0.0f) ? 0 : ((v > 255.0f) ? 255 : (int) v);
+	}
+
+	return 1;
+}
+
+// the bc1 color block (8 bytes) of 16 rgba pixels
+void dds_color_block (unsigned char *out, const unsigned char *block, const unsigned char *lo, const unsigned char *hi)
+{
+	int mean[3] = { 0, 0, 0 };
+	int mx[3], mn[3];
+	int cov_rg = 0, cov_bg = 0;
+	int k, inset;
+	uint32_t level[16];
+	uint32_t c0, c1, r0, r1, swap;
+	uint32_t bits = 0, err, rbits, rerr;
+	uint32_t n;
+
+	for (n = 0; n < 64; n += 4) {
+		for (k = 0; k < 3; k++) {
+			mean[k] += block[n + k];
+		}
+	}
+
+	for (n = 0; n < 64; n += 4) {
+		cov_rg += (((block[n + 0] * 16) - mean[0]) * ((block[n + 1] * 16) - mean[1]));
+		cov_bg += (((block[n + 2] * 16) - mean[2]) * ((block[n + 1] * 16) - mean[1]));
+	}
+
+	for (k = 0; k < 3; k++) {
+		mx[k] = hi[k];
+		mn[k] = lo[k];
+	}
+
+	// the colors run along one of the diagonals of their box: red and
+	// blue go down where green goes up if they vary against it
+	if (cov_rg < 0) {
+		mx[0] = lo[0];
+		mn[0] = hi[0];
+	}
+
+	if (cov_bg < 0) {
+		mx[2] = lo[2];
+		mn[2] = hi[2];
+	}
+
+	// the ends of the box are seldom hit, moving them in a sixteenth
+	// brings the levels closer to the pixels
+	for (k = 0; k < 3; k++) {
+		inset = (mx[k] - mn[k]) / 16;
+		mx[k] -= inset;
+		mn[k] += inset;
+	}
+
+	c0 = dds_565 (mx);
+	c1 = dds_565 (mn);
+
+	// c0 > c1 selects the four color mode
+	if (c0 < c1) {
+		swap = c0; c0 = c1; c1 = swap;
+	}
+
+	if (c0 != c1) {
+		bits = dds_color_fit (block, c0, c1, level, &err);
+
+		// once more with the ends fitted to the levels, if that is better
+		if (err && dds_refine (block, level, mx, mn)) {
+			r0 = dds_565 (mx);
+			r1 = dds_565 (mn);
+
+			if (r0 < r1) {
+				swap = r0; r0 = r1; r1 = swap;
+			}
+
+			if (r0 != r1) {
+				rbits = dds_color_fit (block, r0, r1, level, &rerr);
+
+				if (rerr < err) {
+					c0 = r0;
+					c1 = r1;
+					bits = rbits;
+				}
+			}
+		}
+	}
+
+	out[0] = (c0 & 0xFF);
+	out[1] = (c0 >> 8);
+	out[2] = (c1 & 0xFF);
+	out[3] = (c1 >> 8);
+	dds_put32 (out + 4, bits);
+}
+
+// the bc3 alpha block (8 bytes) of 16 rgba pixels
+void dds_alpha_block (unsigned char *out, const unsigned char *block, uint32_t lo, uint32_t hi)
+{
+	// index of each level from a0 (the largest) to a1 (the smallest)
+	const uint32_t order[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+	uint64_t bits = 0;
+	uint32_t n, range = (hi - lo);
+
+	if (range) {
+		for (n = 0; n < 16; n++) {
+			bits |= ((uint64_t) order[(((hi - block[(n * 4) + 3]) * 7) + (range / 2)) / range] << (n * 3));
+		}
+	}
+
+	out[0] = hi;
+	out[1] = lo;
+
+	for (n = 0; n < 6; n++) {
+		out[2 + n] = ((bits >> (n * 8)) & 0xFF);
+	}
+}
+
+// compresses the block rows of a job
+void dds_rows (const dds_job *job)
+{
+	unsigned char block[64];
+	unsigned char lo[4], hi[4];
+	unsigned char *out;
+	uint32_t bw = ((job->width + 3) / 4);
+	uint32_t bh = ((job->height + 3) / 4);
+	uint32_t bx, by;
+
+	for (by = job->first; by < bh; by += job->step) {
+		out = (job->out + ((size_t) by * bw * job->format));
+
+		for (bx = 0; bx < bw; bx++) {
+			dds_block_get (block, job, bx, by);
+			dds_minmax (block, lo, hi);
+
+			if (job->format == DDS_BC3) {
+				dds_alpha_block (out, block, lo[3], hi[3]);
+				out += 8;
+			}
+
+			dds_color_block (out, block, lo, hi);
+			out += 8;
+		}
+	}
+}
+
+#ifndef _WIN32
+
+void *dds_thread (void *arg)
+{
+	dds_rows ((const dds_job *) arg);
+	return NULL;
+}
+
+// the number of cpus, for threads 0
+uint32_t dds_cpus (void)
+{
+	long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	return (cpus > 0) ? (uint32_t) cpus : 1;
+}
+
+#else
+
+uint32_t dds_cpus (void)
+{
+	return 1;
+}
+
+#endif
+
+// compresses width * height mbm pixels (of bytes each) into the blocks
+// of format at out, with up to threads threads (0 for one per cpu)
+void dds_compress (unsigned char *out, const unsigned char *in, uint32_t width, uint32_t height,
+	uint32_t bytes, uint32_t format, uint32_t normal, uint32_t threads)
+{
+	dds_job job[DDS_THREADS];
+	uint32_t blocks = (uint32_t) (dds_size (width, height, format) / format);
+	uint32_t count, t;
+#ifndef _WIN32
+	pthread_t thread[DDS_THREADS];
+	uint32_t started[DDS_THREADS] = { 0 };
+#endif
+
+	if (! (width && height)) {
+		return;
+	}
+
+	count = threads ? threads : dds_cpus ();
+	count = (count > ((blocks / DDS_MIN_BLOCKS) + 1)) ? ((blocks / DDS_MIN_BLOCKS) + 1) : count;
+	count = (count > ((height + 3) / 4)) ? ((height + 3) / 4) : count;
+	count = (count > DDS_THREADS) ? DDS_THREADS : count;
+
+	for (t = 0; t < count; t++) {
+		job[t].out = out;
+		job[t].in = in;
+		job[t].width = width;
+		job[t].height = height;
+		job[t].bytes = bytes;
+		job[t].format = format;
+		job[t].normal = normal;
+		job[t].first = t;
+		job[t].step = count;
+	}
+
+#ifndef _WIN32
+	// a thread that can't be started leaves its rows to this one
+	for (t = 1; t < count; t++) {
+		started[t] = (pthread_create (&thread[t], NULL, dds_thread, &job[t]) == 0);
+	}
+
+	dds_rows (&job[0]);
+
+	for (t = 1; t < count; t++) {
+		if (started[t]) {
+			pthread_join (thread[t], NULL);
+
+		} else {
+			dds_rows (&job[t]);
+		}
+	}
+#else
+	for (t = 0; t < count; t++) {
+		dds_rows (&job[t]);
+	}
+#endif
+}
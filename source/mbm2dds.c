@@ -0,0 +1,463 @@
+/*
+ * mbm2dds.c - converts Kerbal Space Program textures to DDS (DXT1/DXT5).
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * 24 bit textures, and 32 bit ones whose alpha is all opaque, become
+ * DXT1. Other 32 bit textures become DXT5, normal maps (type 1) with the
+ * DXT5nm layout KSP expects: x in alpha, y in green.
+ *
+ * With --mips the DDS holds every mip level as well, made from the pixels
+ * already read.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <ctype.h>
+
+// lodepng is only needed for the LodePNGStats of --stats
+#define LODEPNG_NO_COMPILE_ZLIB
+#define LODEPNG_NO_COMPILE_PNG
+#define LODEPNG_NO_COMPILE_DECODER
+#define LODEPNG_NO_COMPILE_ENCODER
+#define LODEPNG_NO_COMPILE_DISK
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
+#define MAGIC 0x50534B03
+
+// mbm header offsets
+#define magic_ofs 0x00
+#define width_ofs 0x04
+#define height_ofs 0x08
+#define type_ofs 0x0C
+#define bits_ofs 0x10
+#define mbm_ofs 0x14
+
+#define bufsz 8192
+
+#include "dds.c"
+#include "mip.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
+
+char *filename = NULL;
+char *infile = NULL;
+char *outfile = NULL;
+char *argfile = NULL;
+
+unsigned char *inbuf = NULL;
+unsigned char *inptr = NULL;
+unsigned char *outbuf = NULL;
+unsigned char *mipbuf = NULL;
+
+uint32_t infilesize;
+uint32_t outfilesize;
+uint32_t bitmapsize;
+uint64_t ddssize;
+uint32_t magic;
+uint32_t erc;
+uint32_t width;
+uint32_t height;
+uint32_t type;
+uint32_t bits;
+uint32_t bytes;
+uint32_t format;
+uint32_t threads = 0;
+uint32_t mips = 0;
+uint32_t mipmode = 0;
+uint32_t levels;
+uint32_t lw, lh;
+size_t ofs;
+uint32_t n;
+
+int cleanup (int rc)
+{
+	const char *errmsg[] = {
+		"",
+		"malloc",
+		"open for read",
+		"open for write",
+		"read image",
+		"write image",
+		"header check",
+		"image type",
+		"image convert",
+	};
+
+	if (filename != NULL) { free (filename); filename = NULL; }
+
+	if (infile != NULL) { free (infile); infile = NULL; }
+
+	if (outfile != NULL) { free (outfile); outfile = NULL; }
+
+	if (inbuf != NULL) { lodepng_free (inbuf); inbuf = NULL; }
+
+	if (mipbuf != NULL) { lodepng_free (mipbuf); mipbuf = NULL; }
+
+	if (outbuf != NULL) { aio_discard (); outbuf = NULL; }
+
+	if (rc) {
+		fprintf (stderr, " ERROR: %s failed\n", errmsg[rc]);
+		fflush (stderr);
+
+	} else {
+		fprintf (stdout, "\n");
+		fflush (stdout);
+	}
+
+	return rc;
+}
+
+int readline (char *str, int limit, FILE *fp)
+{
+	int len;
+	*str = 0;
+	len = 0;
+
+	if (fgets (str, limit, fp)) {
+		len = strlen (str);
+	}
+
+	while (len--) {
+		if (str[len] > 0x20) {
+			len++;
+			break;
+
+		} else {
+			str[len] = 0;
+		}
+	}
+
+	len++;
+	return len;
+}
+
+char *bname (char *str)
+{
+	int len = strlen (str);
+
+	while (len--) {
+		if (str[len] == '.') {
+			str[len] = 0;
+			break;
+		}
+	}
+
+	return str;
+}
+
+int main (int argc, char *argv[])
+{
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--threads=", 10) == 0) {
+			// threads compressing one texture, 0 for one per cpu
+			threads = atoi (argv[arg] + 10);
+
+		} else if (strncmp (argv[arg], "--mips", 6) == 0) {
+			// --mips, or --mips=srgb, --mips=alpha, --mips=srgb,alpha
+			mips = 1;
+			mipmode |= strstr (argv[arg], "srgb") ? MIP_SRGB : 0;
+			mipmode |= strstr (argv[arg], "alpha") ? MIP_ALPHA : 0;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]))) {
+			argfile = argv[arg];
+		}
+	}
+
+	cache_open ("mbm2dds", (mips | (mipmode << 1)));
+	walk_start (".mbm");
+	aio_start ();
+
+	while (1) {
+
+		infile = (char *) malloc (bufsz * sizeof (char));
+		outfile = (char *) malloc (bufsz * sizeof (char));
+		filename = (char *) malloc (bufsz * sizeof (char));
+
+		if (! (infile && outfile && filename)) {
+			erc = 1;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename %s", filename);
+			fflush (stdout);
+
+		} else {
+			fprintf (stdout, "Filename ");
+
+			if (! (readline (filename, bufsz, stdin))) {
+				fprintf (stdout, "none, exiting");
+				fflush (stdout);
+				cleanup (0);
+				break;
+
+			} else {
+				fprintf (stdout, "%s", filename);
+				fflush (stdout);
+			}
+		}
+
+		sprintf (infile, "%s", filename);
+		sprintf (outfile, "%s.dds", bname (filename));
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_read (infile, &inbuf, &infilesize);
+
+		if (erc) {
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		lodepng_stats_add (&stats, LSP_READ, stats_start, infilesize);
+
+		if (cache_fetch (inbuf, infilesize, outfile)) {
+			trace_file_end (0, 0, infilesize, cache_size);
+			stats_file (infile);
+			cleanup (0);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		stats_start = lodepng_stats_clock (&stats);
+
+		if (infilesize < mbm_ofs) {
+			erc = 4;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		magic = * ((uint32_t *) (inbuf + magic_ofs));
+		width = * ((uint32_t *) (inbuf + width_ofs));
+		height = * ((uint32_t *) (inbuf + height_ofs));
+		type = * ((uint32_t *) (inbuf + type_ofs));
+		bits = * ((uint32_t *) (inbuf + bits_ofs));
+
+		if (magic != MAGIC) {
+			erc = 6;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		if ((bits != 24) && (bits != 32)) {
+			erc = 7;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		bytes = (bits / 8);
+		inptr = (inbuf + mbm_ofs);
+
+		// in 64 bits, so that no width and height can wrap past the check
+		if ((uint64_t) (infilesize - mbm_ofs) < ((uint64_t) width * height * bytes)) {
+			erc = 4;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		bitmapsize = (width * height * bytes);
+
+		lodepng_stats_add (&stats, LSP_HEADER, stats_start, mbm_ofs);
+		stats_start = lodepng_stats_clock (&stats);
+		format = DDS_BC1;
+
+		// a normal map keeps its alpha (x), else dxt5 only if it is used
+		if (bytes == 4) {
+			format = (type == 1) ? DDS_BC3 : DDS_BC1;
+
+			for (n = 3; (format == DDS_BC1) && (n < bitmapsize); n += 4) {
+				if (inptr[n] != 0xFF) {
+					format = DDS_BC3;
+				}
+			}
+		}
+
+		lodepng_stats_add (&stats, LSP_CHECK_TYPE, stats_start, bitmapsize);
+
+		levels = mips ? mip_levels (width, height) : 1;
+
+		// the smaller levels are made from the pixels already in memory
+		if (levels > 1) {
+			stats_start = lodepng_stats_clock (&stats);
+			mipbuf = (unsigned char *) lodepng_malloc (mip_chain_size (width, height, bytes, levels));
+
+			if (! mipbuf) {
+				erc = 1;
+				cleanup (erc);
+
+				if (argfile) {
+					break;
+				}
+
+				continue;
+			}
+
+			mip_chain (mipbuf, inptr, width, height, bytes, levels, (mipmode | ((type == 1) ? MIP_NORMAL : 0)));
+			lodepng_stats_add (&stats, LSP_FILTER, stats_start, mip_chain_size (width, height, bytes, levels));
+		}
+
+		// the dds is made in place, in the mapped output file
+		ddssize = DDS_HEADER;
+		lw = width;
+		lh = height;
+
+		for (n = 0; n < levels; n++) {
+			ddssize += dds_size (lw, lh, format);
+			mip_next (&lw, &lh);
+		}
+
+		// blocks of a narrow texture can take more than its pixels
+		if (ddssize > 0xFFFFFFFFULL) {
+			erc = 8;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		outfilesize = (uint32_t) ddssize;
+		outbuf = aio_create (outfile, outfilesize);
+
+		if (! outbuf) {
+			erc = 3;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		dds_header (outbuf, width, height, format, levels);
+		stats_start = lodepng_stats_clock (&stats);
+		dds_compress ((outbuf + DDS_HEADER), inptr, width, height, bytes, format, (type == 1), threads);
+		ofs = (DDS_HEADER + dds_size (width, height, format));
+		inptr = mipbuf;
+		lw = width;
+		lh = height;
+
+		for (n = 1; n < levels; n++) {
+			mip_next (&lw, &lh);
+			dds_compress ((outbuf + ofs), inptr, lw, lh, bytes, format, (type == 1), threads);
+			ofs += dds_size (lw, lh, format);
+			inptr += ((size_t) lw * lh * bytes);
+		}
+
+		lodepng_free (inbuf);
+		inbuf = NULL;
+		lodepng_stats_add (&stats, LSP_CONVERT, stats_start, (outfilesize - DDS_HEADER));
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_commit ();
+		outbuf = NULL;
+
+		if (erc) {
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, outfilesize);
+		cache_store (outfile);
+		trace_file_end (width, height, infilesize, outfilesize);
+		stats_file (infile);
+
+		cleanup (0);
+
+		if (argfile) {
+			break;
+		}
+	}
+
+	aio_finish ();
+	cache_close ();
+	stats_print ("mbm2dds");
+	trace_write ("mbm2dds");
+	cleanup (0);
+
+	// a file named on the command line gives its error as the exit code
+	return argfile ? erc : 0;
+}
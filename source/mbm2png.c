@@ -2,7 +2,7 @@
  * mbm2png.c - converts Kerbal Space Program textures to png images
  *
  * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
- * Last update 28 november 2014
+ * Last update 19 october 2026
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -20,6 +20,9 @@
  * This program uses the "lodepng" library written by Lode Vandevenne.
  * Please see "lodepng.c" and "lodepng.h" for license and copyright
  * information. The lodepng library URL is: <http://lodev.org/lodepng/>.
+ *
+ * With --interlace the png is interlaced (Adam7), so a thumbnail can be
+ * decoded from its first passes alone, see lodepng_decode_preview ().
  */
 
 #include <stdio.h>
@@ -30,8 +33,9 @@
 
 #define LODEPNG_NO_COMPILE_DECODER
 #define LODEPNG_NO_COMPILE_DISK
-#define LODEPNG_NO_COMPILE_ANCILLARY_CHUNKS
 #define LODEPNG_NO_COMPILE_ERROR_TEXT
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
 
 /*
  * lodepng image library
@@ -49,13 +53,23 @@
 #define bits_ofs 0x10
 #define image_ofs 0x14
 
+// png text chunk that remembers the mbm bit depth for png2mbm
+#define BITS_KEY "MBM bits"
+
 #define bufsz 8192
 
-FILE *fp = NULL;
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
+#include "region.c"
 
 char *filename = NULL;
 char *infile = NULL;
 char *outfile = NULL;
+char *argfile = NULL;
 char *buf = NULL;
 
 unsigned char *buffer = NULL;
@@ -63,7 +77,6 @@ unsigned char *image = NULL;
 
 uint32_t imgsize;
 uint32_t magic;
-uint32_t io_size;
 uint32_t width;
 uint32_t height;
 uint32_t type;
@@ -76,6 +89,7 @@ uint32_t y;
 uint32_t src;
 uint32_t dst;
 uint32_t erc;
+uint32_t interlace = 0;
 
 size_t pngsize;
 
@@ -93,10 +107,9 @@ int cleanup (int rc)
 		"header check",
 		"image type",
 		"image convert",
+		"crop",
 	};
 
-	if (fp != NULL) { fclose (fp); fp = NULL; }
-
 	if (filename != NULL) { free (filename); filename = NULL; }
 
 	if (infile != NULL) { free (infile); infile = NULL; }
@@ -105,9 +118,9 @@ int cleanup (int rc)
 
 	if (buf != NULL) { free (buf); buf = NULL; }
 
-	if (buffer != NULL) { free (buffer); buffer = NULL; }
+	if (buffer != NULL) { lodepng_free (buffer); buffer = NULL; }
 
-	if (image != NULL) { free (image); image = NULL; }
+	if (image != NULL) { lodepng_free (image); image = NULL; }
 
 	if (rc) {
 		fprintf (stderr, "\n%s failed\n", errmsg[rc]);
@@ -161,6 +174,23 @@ char *bname (char *str)
 
 int main (int argc, char *argv[])
 {
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strcmp (argv[arg], "--interlace") == 0) {
+			interlace = 1;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]) || region_option (argc, argv, &arg))) {
+			argfile = argv[arg];
+		}
+	}
+
+	cache_open ("mbm2png", interlace);
+	walk_start (".mbm");
+	region_start ();
+	aio_start ();
+
 	while (1) {
 		infile = (char *) malloc (bufsz * sizeof (char));
 		outfile = (char *) malloc (bufsz * sizeof (char));
@@ -172,8 +202,17 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		if (argc == 2) {
-			sprintf (filename, "%s", argv[1]);
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename -> %s", filename);
+			fflush (stdout);
 
 		} else {
 			fprintf (stdout, "Filename ");
@@ -191,35 +230,40 @@ int main (int argc, char *argv[])
 		}
 
 		sprintf (infile, "%s", filename);
-		sprintf (outfile, "%s.png", bname (filename));
-		fp = fopen (infile, "rb");
+		region_name (outfile, bufsz, bname (filename), ".png");
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
+		stats_start = lodepng_stats_clock (&stats);
+		erc = region_crop ? region_read (infile, &buffer, &imgsize) : aio_read (infile, &buffer, &imgsize);
 
-		if (!fp) {
-			cleanup (2);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fseek (fp, 0, SEEK_END);
-		imgsize = (ftell (fp) + 1);
-		fseek (fp, 0, SEEK_SET);
-		imgsize--;
-		buffer = (unsigned char *) malloc (imgsize * sizeof (unsigned char));
-		image = (unsigned char *) malloc (imgsize * sizeof (unsigned char));
+		image = (unsigned char *) lodepng_malloc (imgsize * sizeof (unsigned char));
 
-		if (! (buffer && image)) {
+		if (! image) {
 			cleanup (1);
 			continue;
 		}
 
-		io_size = fread (buffer, sizeof (char), imgsize, fp);
-		fclose (fp);
-		fp = NULL;
+		lodepng_stats_add (&stats, LSP_READ, stats_start, imgsize);
+
+		if (cache_fetch (buffer, imgsize, outfile)) {
+			trace_file_end (0, 0, imgsize, cache_size);
+			stats_file (infile);
+			cleanup (0);
+
+			if (argfile) {
+				break;
+			}
 
-		if (io_size != imgsize) {
-			cleanup (4);
 			continue;
 		}
 
+		stats_start = lodepng_stats_clock (&stats);
 		magic = * ((uint32_t *) (buffer + magic_ofs));
 		width = * ((uint32_t *) (buffer + width_ofs));
 		height = * ((uint32_t *) (buffer + height_ofs));
@@ -238,6 +282,8 @@ int main (int argc, char *argv[])
 
 		bytes = (bits / 8);
 		bpl = width * bytes;
+		lodepng_stats_add (&stats, LSP_HEADER, stats_start, image_ofs);
+		stats_start = lodepng_stats_clock (&stats);
 
 		for (y = 0; y < height; y++) {
 			for (x = 0; x < width; x++) {
@@ -250,24 +296,28 @@ int main (int argc, char *argv[])
 			}
 		}
 
-		free (buffer);
+		lodepng_stats_add (&stats, LSP_FLIP, stats_start, (width * height * bytes));
+		lodepng_free (buffer);
 		buffer = NULL;
 		lodepng_state_init (&state);
-		state.encoder.auto_convert = 0;
+		state.stats = &stats;
+		state.info_png.interlace_method = interlace;
 
+		// auto_convert (the lodepng default) writes the smallest lossless png
+		// type: rgb if the alpha is opaque, grey, palette for few colors...
 		if (bytes == 3) {
 			state.info_raw.colortype = LCT_RGB;
-			state.info_png.color.colortype = LCT_RGB;
+			lodepng_add_text (&state.info_png, BITS_KEY, "24");
 
 		} else {
 			state.info_raw.colortype = LCT_RGBA;
-			state.info_png.color.colortype = LCT_RGBA;
+			lodepng_add_text (&state.info_png, BITS_KEY, "32");
 		}
 
 		erc = lodepng_encode (&buffer, &pngsize, image, width, height, &state);
 		lodepng_state_cleanup (&state);
 
-		free (image);
+		lodepng_free (image);
 		image = NULL;
 
 		if (erc) {
@@ -275,31 +325,30 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		fp = fopen (outfile, "wb");
-
-		if (!fp) {
-			cleanup (3);
-			continue;
-		}
-
-		io_size = fwrite (buffer, sizeof (char), pngsize, fp);
-		free (buffer);
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_write (outfile, buffer, pngsize); // frees buffer
 		buffer = NULL;
 
-		if (io_size != pngsize) {
-			cleanup (4);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fclose (fp);
-		fp = NULL;
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, pngsize);
+		cache_store (outfile);
+		trace_file_end (width, height, imgsize, pngsize);
+		stats_file (infile);
 
 		cleanup (0);
 
-		if (argc == 2) {
+		if (argfile) {
 			break;
 		}
 	}
 
+	aio_finish ();
+	cache_close ();
+	stats_print ("mbm2png");
+	trace_write ("mbm2png");
 	return cleanup (0);
 }
@@ -24,6 +24,22 @@
 #include <inttypes.h>
 #include <ctype.h>
 
+// lodepng is only needed for the LodePNGStats of --stats
+#define LODEPNG_NO_COMPILE_ZLIB
+#define LODEPNG_NO_COMPILE_PNG
+#define LODEPNG_NO_COMPILE_DECODER
+#define LODEPNG_NO_COMPILE_ENCODER
+#define LODEPNG_NO_COMPILE_DISK
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
 #define MAGIC 0x50534B03
 
 // mbm header offsets
@@ -51,11 +67,19 @@
 
 #define bufsz 8192
 
-FILE *fp = NULL;
+#include "tga.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
+#include "region.c"
 
 char *filename = NULL;
 char *infile = NULL;
 char *outfile = NULL;
+char *argfile = NULL;
 char *buf = NULL;
 
 unsigned char *inbuf = NULL;
@@ -67,12 +91,13 @@ uint32_t infilesize;
 uint32_t outfilesize;
 uint32_t bitmapsize;
 uint32_t magic;
-uint32_t io_size;
+uint32_t erc;
 uint32_t width;
 uint32_t height;
 uint32_t type;
 uint32_t bits;
 uint32_t bytes;
+uint32_t rle = 0;
 uint32_t n;
 
 int cleanup (int rc)
@@ -87,10 +112,9 @@ int cleanup (int rc)
 		"header check",
 		"image type",
 		"image convert",
+		"crop",
 	};
 
-	if (fp != NULL) { fclose (fp); fp = NULL; }
-
 	if (filename != NULL) { free (filename); filename = NULL; }
 
 	if (infile != NULL) { free (infile); infile = NULL; }
@@ -99,9 +123,9 @@ int cleanup (int rc)
 
 	if (buf != NULL) { free (buf); buf = NULL; }
 
-	if (inbuf != NULL) { free (inbuf); inbuf = NULL; }
+	if (inbuf != NULL) { lodepng_free (inbuf); inbuf = NULL; }
 
-	if (outbuf != NULL) { free (outbuf); outbuf = NULL; }
+	if (outbuf != NULL) { aio_discard (); outbuf = NULL; }
 
 	if (rc) {
 		fprintf (stderr, " ERROR: %s failed\n", errmsg[rc]);
@@ -155,6 +179,24 @@ char *bname (char *str)
 
 int main (int argc, char *argv[])
 {
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strcmp (argv[arg], "--rle") == 0) {
+			// write run length encoded tga files
+			rle = 1;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]) || region_option (argc, argv, &arg))) {
+			argfile = argv[arg];
+		}
+	}
+
+	cache_open ("mbm2tga", rle);
+	walk_start (".mbm");
+	region_start ();
+	aio_start ();
+
 	while (1) {
 
 		infile = (char *) malloc (bufsz * sizeof (char));
@@ -167,8 +209,17 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		if (argc == 2) {
-			sprintf (filename, "%s", argv[1]);
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename %s", filename);
+			fflush (stdout);
 
 		} else {
 			fprintf (stdout, "Filename ");
@@ -186,35 +237,33 @@ int main (int argc, char *argv[])
 		}
 
 		sprintf (infile, "%s", filename);
-		sprintf (outfile, "%s.tga", bname (filename));
-		fp = fopen (infile, "rb");
-
-		if (!fp) {
-			cleanup (2);
+		region_name (outfile, bufsz, bname (filename), ".tga");
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
+		stats_start = lodepng_stats_clock (&stats);
+		erc = region_crop ? region_read (infile, &inbuf, &infilesize) : aio_read (infile, &inbuf, &infilesize);
+
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fseek (fp, 0, SEEK_END);
-		infilesize = (ftell (fp) + 1);
-		fseek (fp, 0, SEEK_SET);
-		infilesize--;
-		outfilesize = (infilesize - 2);
-		inbuf = (unsigned char *) malloc (infilesize * sizeof (unsigned char));
-		outbuf = (unsigned char *) malloc (outfilesize * sizeof (unsigned char));
+		lodepng_stats_add (&stats, LSP_READ, stats_start, infilesize);
 
-		if (! (inbuf && outbuf)) {
-			cleanup (1);
-			continue;
-		}
+		if (cache_fetch (inbuf, infilesize, outfile)) {
+			trace_file_end (0, 0, infilesize, cache_size);
+			stats_file (infile);
+			cleanup (0);
 
-		io_size = fread (inbuf, sizeof (char), infilesize, fp);
-		fclose (fp);
+			if (argfile) {
+				break;
+			}
 
-		if (io_size != infilesize) {
-			cleanup (4);
 			continue;
 		}
 
+		stats_start = lodepng_stats_clock (&stats);
 		magic = * ((uint32_t *) (inbuf + magic_ofs));
 		width = * ((uint32_t *) (inbuf + width_ofs));
 		height = * ((uint32_t *) (inbuf + height_ofs));
@@ -231,9 +280,31 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
+		bytes = (bits / 8);
+		bitmapsize = (infilesize - mbm_ofs);
+		outfilesize = (infilesize - 2);
+
+		if (rle) {
+			// packets are made from width * height pixels, which must be there
+			if (((uint64_t) width * height * bytes) > bitmapsize) {
+				cleanup (4);
+				continue;
+			}
+
+			outfilesize = (tga_rle_bound (width, height, bytes) + tga_ofs);
+		}
+
+		// the tga is made in place, in the mapped output file
+		outbuf = aio_create (outfile, outfilesize);
+
+		if (! outbuf) {
+			cleanup (3);
+			continue;
+		}
+
 		* ((uint8_t *) (outbuf + IDLength)) = 0;
 		* ((uint8_t *) (outbuf + ColorMapType)) = 0;
-		* ((uint8_t *) (outbuf + ImageType)) = 2;
+		* ((uint8_t *) (outbuf + ImageType)) = rle ? TGA_TRUECOLOR_RLE : TGA_TRUECOLOR;
 		* ((uint16_t *) (outbuf + CMapStart)) = 0;
 		* ((uint16_t *) (outbuf + CMapLength)) = 0;
 		* ((uint8_t *) (outbuf + CMapDepth)) = 0;
@@ -243,52 +314,55 @@ int main (int argc, char *argv[])
 		* ((uint16_t *) (outbuf + Height)) = height;
 		* ((uint8_t *) (outbuf + PixelDepth)) = bits;
 		* ((uint8_t *) (outbuf + ImageDescriptor)) = 0;
+		lodepng_stats_add (&stats, LSP_HEADER, stats_start, (mbm_ofs + tga_ofs));
+		stats_start = lodepng_stats_clock (&stats);
 
 		inptr = (inbuf + mbm_ofs);
 		outptr = (outbuf + tga_ofs);
 
-		bitmapsize = (infilesize - mbm_ofs);
-
-		bytes = (bits / 8);
+		if (rle) {
+			outfilesize = (tga_rle_from_mbm (outptr, inptr, width, height, bytes) + tga_ofs);
+			aio_trim (outfilesize);
 
-		for (n = 0; n < bitmapsize; n += bytes) {
-			outptr[n + 0] = inptr[n + 2];
-			outptr[n + 1] = inptr[n + 1];
-			outptr[n + 2] = inptr[n + 0];
-
-			if (bytes == 4) {
-				outptr[n + 3] = inptr[n + 3];
+		} else {
+			for (n = 0; n < bitmapsize; n += bytes) {
+				outptr[n + 0] = inptr[n + 2];
+				outptr[n + 1] = inptr[n + 1];
+				outptr[n + 2] = inptr[n + 0];
+
+				if (bytes == 4) {
+					outptr[n + 3] = inptr[n + 3];
+				}
 			}
 		}
 
-		free (inbuf);
+		lodepng_free (inbuf);
 		inbuf = NULL;
-		fp = fopen (outfile, "wb");
-
-		if (!fp) {
-			cleanup (3);
-			continue;
-		}
-
-		io_size = fwrite (outbuf, sizeof (char), outfilesize, fp);
-
-		free (outbuf);
+		lodepng_stats_add (&stats, LSP_FLIP, stats_start, bitmapsize);
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_commit ();
 		outbuf = NULL;
 
-		if (io_size != outfilesize) {
-			cleanup (5);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fclose (fp);
-		fp = NULL;
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, outfilesize);
+		cache_store (outfile);
+		trace_file_end (width, height, infilesize, outfilesize);
+		stats_file (infile);
 
 		cleanup (0);
 
-		if (argc == 2) {
+		if (argfile) {
 			break;
 		}
 	}
 
+	aio_finish ();
+	cache_close ();
+	stats_print ("mbm2tga");
+	trace_write ("mbm2tga");
 	return cleanup (0);
 }
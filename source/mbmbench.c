@@ -0,0 +1,411 @@
+/*
+ * mbmbench.c - benchmarks the texture converters on a synthetic corpus
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Generates deterministic KSP-like textures (diffuse rgb, rgba with an
+ * alpha channel, normal maps) as MBM files, then runs mbm2png, png2mbm,
+ * mbm2tga and tga2mbm on each one and reports wall time, MB/s and peak
+ * resident memory of every run as JSON, along with the per phase --stats
+ * of the converter's last run. No libraries needed, but the converters
+ * are run as child processes, so it is POSIX only.
+ *
+ * usage: mbmbench [--bin DIR] [--dir DIR] [--sizes 512,1024,...] [--reps N] [--out FILE]
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define MAGIC 0x50534B03
+
+#define bufsz 8192
+#define dirsz 1024
+#define max_sizes 16
+#define max_reps 64
+
+// corpus kinds
+#define DIFFUSE 0
+#define ALPHA 1
+#define NORMAL 2
+
+const char *kind_name[] = { "diffuse", "alpha", "normal" };
+const uint32_t kind_bits[] = { 24, 32, 32 };
+
+// converter paths, in the order they are run. each one reads the file
+// with the "from" extension and writes the one with the "to" extension.
+const char *tool_name[] = { "mbm2png", "png2mbm", "mbm2tga", "tga2mbm" };
+const char *tool_from[] = { "mbm", "png", "mbm", "tga" };
+const char *tool_to[] = { "png", "mbm", "tga", "mbm" };
+
+#define num_tools 4
+
+FILE *out = NULL;
+
+char bindir[dirsz] = ".";
+char workdir[dirsz] = "mbmbench.tmp";
+char statsfile[bufsz];
+char stats[bufsz];
+
+uint32_t sizes[max_sizes] = { 512, 1024, 2048 };
+uint32_t num_sizes = 3;
+uint32_t reps = 3;
+
+double now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+uint64_t file_size (const char *name)
+{
+	struct stat st;
+	return (stat (name, &st) == 0) ? (uint64_t) st.st_size : 0;
+}
+
+// small deterministic generator, so every run benchmarks the same bytes
+uint32_t hash32 (uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7FEB352D;
+	x ^= x >> 15;
+	x *= 0x846CA68B;
+	x ^= x >> 16;
+	return x;
+}
+
+// smooth value noise in 0..255 with the given cell size (a power of two)
+uint32_t noise (uint32_t x, uint32_t y, uint32_t cell, uint32_t seed)
+{
+	uint32_t cx = x / cell;
+	uint32_t cy = y / cell;
+	uint32_t fx = ((x % cell) * 256) / cell;
+	uint32_t fy = ((y % cell) * 256) / cell;
+	uint32_t v00 = hash32 (seed ^ (cx * 0x9E3779B1) ^ (cy * 0x85EBCA77)) & 0xFF;
+	uint32_t v10 = hash32 (seed ^ ((cx + 1) * 0x9E3779B1) ^ (cy * 0x85EBCA77)) & 0xFF;
+	uint32_t v01 = hash32 (seed ^ (cx * 0x9E3779B1) ^ ((cy + 1) * 0x85EBCA77)) & 0xFF;
+	uint32_t v11 = hash32 (seed ^ ((cx + 1) * 0x9E3779B1) ^ ((cy + 1) * 0x85EBCA77)) & 0xFF;
+	uint32_t top = (v00 * (256 - fx)) + (v10 * fx);
+	uint32_t bottom = (v01 * (256 - fx)) + (v11 * fx);
+	return ((top * (256 - fy)) + (bottom * fy)) >> 16;
+}
+
+// a few octaves of noise plus a little grain, like painted panels with wear
+uint32_t texture (uint32_t x, uint32_t y, uint32_t size, uint32_t seed)
+{
+	uint32_t v = (noise (x, y, size / 4, seed) * 4)
+		+ (noise (x, y, size / 32, seed + 1) * 2)
+		+ noise (x, y, 8, seed + 2)
+		+ (hash32 ((y * size) + x + seed) & 0x0F);
+	return v / 7;
+}
+
+int make_texture (const char *name, uint32_t kind, uint32_t size)
+{
+	FILE *fp;
+	unsigned char *image;
+	uint32_t header[5];
+	uint32_t bytes = kind_bits[kind] / 8;
+	uint32_t x, y, n, v, io_size;
+	uint32_t imgsize = size * size * bytes;
+
+	image = (unsigned char *) malloc (imgsize * sizeof (unsigned char));
+
+	if (! image) {
+		return 1;
+	}
+
+	for (y = 0; y < size; y++) {
+		for (x = 0; x < size; x++) {
+			n = ((y * size) + x) * bytes;
+			v = texture (x, y, size, kind * 101);
+
+			if (kind == NORMAL) {
+				// unity style packed normal: x in alpha, y in green,
+				// red and blue equal, which check_type picks up
+				image[n + 0] = 255;
+				image[n + 1] = noise (x, y, size / 16, 7) / 2 + 64;
+				image[n + 2] = 255;
+				image[n + 3] = v / 2 + 64;
+
+			} else {
+				image[n + 0] = v;
+				image[n + 1] = (v * 3) / 4 + 32;
+				image[n + 2] = v / 2;
+
+				if (kind == ALPHA) {
+					// cut outs plus soft edges
+					v = noise (x, y, size / 8, 11);
+					image[n + 3] = (v < 96) ? 0 : (v > 160) ? 255 : (v - 96) * 4;
+				}
+			}
+		}
+	}
+
+	header[0] = MAGIC;
+	header[1] = size;
+	header[2] = size;
+	header[3] = (kind == NORMAL) ? 1 : 0;
+	header[4] = kind_bits[kind];
+
+	fp = fopen (name, "wb");
+
+	if (! fp) {
+		free (image);
+		return 1;
+	}
+
+	fwrite (header, sizeof (uint32_t), 5, fp);
+	io_size = fwrite (image, sizeof (char), imgsize, fp);
+	fclose (fp);
+	free (image);
+
+	return (io_size != imgsize);
+}
+
+// runs one converter on one file, returns wall seconds (negative on
+// failure) and the peak resident set of the child in kilobytes. the
+// --stats=json output of the converter goes to statsfile.
+double run_tool (const char *tool, const char *file, long *maxrss)
+{
+	char path[bufsz];
+	struct rusage ru;
+	double start, stop;
+	int status, devnull, fd;
+	pid_t pid;
+
+	snprintf (path, bufsz, "%s/%s", bindir, tool);
+	start = now ();
+	pid = fork ();
+
+	if (pid < 0) {
+		return -1.0;
+	}
+
+	if (pid == 0) {
+		devnull = open ("/dev/null", O_WRONLY);
+
+		if (devnull >= 0) {
+			dup2 (devnull, STDOUT_FILENO);
+			close (devnull);
+		}
+
+		fd = open (statsfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if (fd >= 0) {
+			dup2 (fd, STDERR_FILENO);
+			close (fd);
+		}
+
+		execl (path, tool, "--stats=json", file, (char *) NULL);
+		_exit (127);
+	}
+
+	if (wait4 (pid, &status, 0, &ru) != pid) {
+		return -1.0;
+	}
+
+	stop = now ();
+	*maxrss = ru.ru_maxrss;
+
+	if (! (WIFEXITED (status) && (WEXITSTATUS (status) == 0))) {
+		return -1.0;
+	}
+
+	return stop - start;
+}
+
+// reads the json of the last converter run into stats, "null" if there is none
+void read_stats (void)
+{
+	FILE *fp;
+	size_t len = 0;
+
+	fp = fopen (statsfile, "rb");
+
+	if (fp) {
+		len = fread (stats, sizeof (char), (bufsz - 1), fp);
+		fclose (fp);
+	}
+
+	while (len && isspace ((unsigned char) stats[len - 1])) {
+		len--;
+	}
+
+	stats[len] = 0;
+
+	if ((! len) || (stats[0] != '{')) {
+		snprintf (stats, bufsz, "null");
+	}
+}
+
+int compare_double (const void *a, const void *b)
+{
+	double x = * (const double *) a;
+	double y = * (const double *) b;
+	return (x < y) ? -1 : (x > y);
+}
+
+int parse_sizes (const char *str)
+{
+	num_sizes = 0;
+
+	while (*str && (num_sizes < max_sizes)) {
+		sizes[num_sizes] = (uint32_t) strtoul (str, NULL, 10);
+
+		if ((sizes[num_sizes] < 64) || (sizes[num_sizes] > 16384)) {
+			return 1;
+		}
+
+		num_sizes++;
+
+		while (isdigit ((unsigned char) *str)) {
+			str++;
+		}
+
+		if (*str == ',') {
+			str++;
+		}
+	}
+
+	return (num_sizes == 0);
+}
+
+int usage (void)
+{
+	fprintf (stderr, "usage: mbmbench [--bin DIR] [--dir DIR] [--sizes 512,1024,...] [--reps N] [--out FILE]\n");
+	return 1;
+}
+
+int main (int argc, char *argv[])
+{
+	char mbmfile[bufsz];
+	char infile[bufsz];
+	char outfile[bufsz];
+	double times[max_reps];
+	double gen_time, total_time, start, t;
+	uint64_t insize, outsize;
+	long maxrss, peak;
+	uint32_t kind, s, tool, rep;
+	int arg, first = 1;
+
+	out = stdout;
+
+	for (arg = 1; arg < argc; arg++) {
+		if ((strcmp (argv[arg], "--bin") == 0) && ((arg + 1) < argc)) {
+			snprintf (bindir, dirsz, "%s", argv[++arg]);
+
+		} else if ((strcmp (argv[arg], "--dir") == 0) && ((arg + 1) < argc)) {
+			snprintf (workdir, dirsz, "%s", argv[++arg]);
+
+		} else if ((strcmp (argv[arg], "--sizes") == 0) && ((arg + 1) < argc)) {
+			if (parse_sizes (argv[++arg])) {
+				return usage ();
+			}
+
+		} else if ((strcmp (argv[arg], "--reps") == 0) && ((arg + 1) < argc)) {
+			reps = (uint32_t) atoi (argv[++arg]);
+			reps = (reps < 1) ? 1 : (reps > max_reps) ? max_reps : reps;
+
+		} else if ((strcmp (argv[arg], "--out") == 0) && ((arg + 1) < argc)) {
+			out = fopen (argv[++arg], "w");
+
+			if (! out) {
+				fprintf (stderr, "mbmbench: can't open %s\n", argv[arg]);
+				return 1;
+			}
+
+		} else {
+			return usage ();
+		}
+	}
+
+	mkdir (workdir, 0755);
+	snprintf (statsfile, bufsz, "%s/stats.json", workdir);
+	total_time = now ();
+
+	fprintf (out, "{\n  \"reps\": %u,\n  \"results\": [", reps);
+
+	for (kind = 0; kind < 3; kind++) {
+		for (s = 0; s < num_sizes; s++) {
+			snprintf (mbmfile, bufsz, "%s/%s_%u.mbm", workdir, kind_name[kind], sizes[s]);
+			start = now ();
+
+			if (make_texture (mbmfile, kind, sizes[s])) {
+				fprintf (stderr, "mbmbench: can't write %s\n", mbmfile);
+				return 1;
+			}
+
+			gen_time = now () - start;
+
+			for (tool = 0; tool < num_tools; tool++) {
+				snprintf (infile, bufsz, "%s/%s_%u.%s", workdir, kind_name[kind], sizes[s], tool_from[tool]);
+				snprintf (outfile, bufsz, "%s/%s_%u.%s", workdir, kind_name[kind], sizes[s], tool_to[tool]);
+				insize = file_size (infile);
+				peak = 0;
+
+				for (rep = 0; rep < reps; rep++) {
+					t = run_tool (tool_name[tool], infile, &maxrss);
+
+					if (t < 0.0) {
+						fprintf (stderr, "mbmbench: %s %s failed\n", tool_name[tool], infile);
+						return 1;
+					}
+
+					times[rep] = t;
+					peak = (maxrss > peak) ? maxrss : peak;
+				}
+
+				outsize = file_size (outfile);
+				read_stats ();
+				qsort (times, reps, sizeof (double), compare_double);
+				t = times[reps / 2];
+
+				fprintf (out, "%s\n    {\"tool\": \"%s\", \"kind\": \"%s\", \"width\": %u, \"height\": %u, \"bits\": %u,",
+					first ? "" : ",", tool_name[tool], kind_name[kind], sizes[s], sizes[s], kind_bits[kind]);
+				fprintf (out, " \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ",", insize, outsize);
+				fprintf (out, " \"phases\": {\"generate\": %.6f, \"convert_min\": %.6f, \"convert_median\": %.6f, \"convert_max\": %.6f},",
+					gen_time, times[0], t, times[reps - 1]);
+				fprintf (out, " \"mb_per_s\": %.2f, \"peak_rss_kb\": %ld,", (t > 0.0) ? (insize / 1e6) / t : 0.0, peak);
+				fprintf (out, " \"tool_stats\": %s}", stats);
+				first = 0;
+			}
+		}
+	}
+
+	fprintf (out, "\n  ],\n  \"total_seconds\": %.3f\n}\n", now () - total_time);
+
+	if (out != stdout) {
+		fclose (out);
+	}
+
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * mbmc.c - thin client for mbmd: sends conversions to the daemon instead
+ * of running the utility
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * usage: mbmc [--socket=PATH] TOOL [--sample[=N]] [--rle] [--interlace] [FILE]
+ *
+ * Converts FILE, or the files named on stdin (one per line, like the
+ * utilities), with TOOL (mbm2png, png2mbm, mbm2tga or tga2mbm) running
+ * in mbmd. Prints the output file or the error of each, and exits with 1
+ * if any of them failed. POSIX only.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define bufsz 8192
+
+char socket_path[bufsz];
+char *tool = NULL;
+char *argfile = NULL;
+char options[bufsz] = ""; // the options of the job, each after a space
+
+// the same as mbmd's
+void default_socket (char *path)
+{
+	const char *dir = getenv ("XDG_RUNTIME_DIR");
+
+	if (getenv ("MBMD_SOCKET")) {
+		snprintf (path, bufsz, "%s", getenv ("MBMD_SOCKET"));
+
+	} else if (dir && *dir) {
+		snprintf (path, bufsz, "%s/mbmd.sock", dir);
+
+	} else {
+		snprintf (path, bufsz, "/tmp/mbmd-%u.sock", (unsigned) getuid ());
+	}
+}
+
+int readline (char *str, int limit, FILE *fp)
+{
+	int len;
+	*str = 0;
+	len = 0;
+
+	if (fgets (str, limit, fp)) {
+		len = strlen (str);
+	}
+
+	while (len--) {
+		if (str[len] > 0x20) {
+			len++;
+			break;
+
+		} else {
+			str[len] = 0;
+		}
+	}
+
+	len++;
+	return len;
+}
+
+// sends one job and prints the answer. returns 1 if it was converted.
+int convert (FILE *in, FILE *out, const char *file)
+{
+	char path[PATH_MAX];
+	char reply[bufsz];
+
+	// the daemon has a working directory of its own
+	if (! realpath (file, path)) {
+		fprintf (stdout, "%s: no such file\n", file);
+		return 0;
+	}
+
+	fprintf (out, "%s%s %s\n", tool, options, path);
+
+	fflush (out);
+
+	if (! fgets (reply, bufsz, in)) {
+		fprintf (stdout, "%s: no answer from mbmd\n", file);
+		return 0;
+	}
+
+	fprintf (stdout, "%s -> %s", file, reply);
+	return (strncmp (reply, "ok ", 3) == 0);
+}
+
+int main (int argc, char *argv[])
+{
+	struct sockaddr_un addr;
+	char filename[bufsz];
+	FILE *in, *out;
+	int failed = 0;
+	int arg;
+	int fd;
+
+	default_socket (socket_path);
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--socket=", 9) == 0) {
+			snprintf (socket_path, bufsz, "%s", argv[arg] + 9);
+
+		} else if ((strncmp (argv[arg], "--sample", 8) == 0) || (strcmp (argv[arg], "--rle") == 0)
+			|| (strcmp (argv[arg], "--interlace") == 0)) {
+			if ((strlen (options) + strlen (argv[arg]) + 1) < bufsz) {
+				strcat (options, " ");
+				strcat (options, argv[arg]);
+			}
+
+		} else if (! tool) {
+			tool = argv[arg];
+
+		} else {
+			argfile = argv[arg];
+		}
+	}
+
+	if (! tool) {
+		fprintf (stderr, "usage: mbmc [--socket=PATH] TOOL [--sample[=N]] [--rle] [--interlace] [FILE]\n");
+		return 1;
+	}
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+
+	if (strlen (socket_path) >= sizeof (addr.sun_path)) {
+		fprintf (stderr, "mbmc: socket path too long\n");
+		return 1;
+	}
+
+	strcpy (addr.sun_path, socket_path);
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+	if ((fd < 0) || (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0)) {
+		fprintf (stderr, "mbmc: can't connect to mbmd on %s\n", socket_path);
+		return 1;
+	}
+
+	// one stream each way, a socket can't be read and written through one
+	in = fdopen (fd, "r");
+	out = fdopen (dup (fd), "w");
+
+	if (! (in && out)) {
+		fprintf (stderr, "mbmc: fdopen failed\n");
+		return 1;
+	}
+
+	if (argfile) {
+		failed = ! convert (in, out, argfile);
+
+	} else {
+		while (readline (filename, bufsz, stdin)) {
+			failed |= ! convert (in, out, filename);
+			fflush (stdout);
+		}
+	}
+
+	fclose (out);
+	fclose (in);
+	return failed;
+}
@@ -0,0 +1,413 @@
+/*
+ * mbmconv.c - converts between Kerbal Space Program textures, png and tga
+ * images in one step, whatever the input is
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * This program uses the "lodepng" library written by Lode Vandevenne.
+ * Please see "lodepng.c" and "lodepng.h" for license and copyright
+ * information. The lodepng library URL is: <http://lodev.org/lodepng/>.
+ *
+ * usage: mbmconv [--to=mbm|png|tga] [--rle] [--interlace] [--sample[=N]] [FILE]
+ *
+ * The type of the input is told from its first bytes, not its name: the
+ * mbm magic number, the png signature, or a tga header that makes sense.
+ * It is decoded once, into pixels already in the row order the output
+ * wants, and encoded once, so png to tga (or back) needs no mbm on disk.
+ * The outputs are the same files the four utilities would write: the
+ * conversions are those of convert.c, which mbmd does its jobs with.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <ctype.h>
+
+#define LODEPNG_NO_COMPILE_DISK
+#define LODEPNG_NO_COMPILE_ERROR_TEXT
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
+#define MAGIC 0x50534B03
+#define IHDR 0x49484452
+
+// mbm header offsets
+#define magic_ofs 0x00
+#define width_ofs 0x04
+#define height_ofs 0x08
+#define type_ofs 0x0C
+#define bits_ofs 0x10
+#define mbm_ofs 0x14
+
+// png header offset
+#define png_ihdr 0x0C
+
+// tga header offsets
+#define IDLength 0x00
+#define ColorMapType 0x01
+#define ImageType 0x02
+#define CMapStart 0x03
+#define CMapLength 0x05
+#define CMapDepth 0x07
+#define XOffset 0x08
+#define YOffset 0x0A
+#define Width 0x0C
+#define Height 0x0E
+#define PixelDepth 0x10
+#define ImageDescriptor 0x11
+#define tga_ofs 0x12
+
+// png text chunk that remembers the mbm bit depth
+#define BITS_KEY "MBM bits"
+
+#define bufsz 8192
+
+#include "check_type.c"
+#include "tga.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
+#include "convert.c"
+
+const char *fmt_ext[] = { "", ".mbm", ".png", ".tga" };
+
+char *filename = NULL;
+char *infile = NULL;
+char *outfile = NULL;
+char *argfile = NULL;
+
+unsigned char *buffer = NULL; // the input file
+unsigned char *image = NULL; // memory for the pixels
+unsigned char *output = NULL; // a png
+
+uint32_t infilesize;
+uint32_t outfilesize;
+uint32_t interlace = 0;
+uint32_t rle = 0;
+uint32_t sample = 0;
+uint32_t to = FMT_MBM;
+uint32_t erc;
+uint32_t n;
+
+convert_job job;
+
+int cleanup (int rc)
+{
+	if (filename != NULL) { free (filename); filename = NULL; }
+
+	if (infile != NULL) { free (infile); infile = NULL; }
+
+	if (outfile != NULL) { free (outfile); outfile = NULL; }
+
+	if (buffer != NULL) { lodepng_free (buffer); buffer = NULL; }
+
+	if (output != NULL) { lodepng_free (output); output = NULL; }
+
+	if (image != NULL) { lodepng_free (image); image = NULL; }
+
+	aio_discard ();
+
+	if (rc) {
+		fprintf (stderr, "\n%s failed\n", convert_error[rc]);
+		fflush (stderr);
+
+	} else {
+		fprintf (stdout, "\n");
+		fflush (stdout);
+	}
+
+	return rc;
+}
+
+int readline (char *str, int limit, FILE *fp)
+{
+	int len;
+	*str = 0;
+	len = 0;
+
+	if (fgets (str, limit, fp)) {
+		len = strlen (str);
+	}
+
+	while (len--) {
+		if (str[len] > 0x20) {
+			len++;
+			break;
+
+		} else {
+			str[len] = 0;
+		}
+	}
+
+	len++;
+	return len;
+}
+
+char *bname (char *str)
+{
+	int len = strlen (str);
+
+	while (len--) {
+		if (str[len] == '.') {
+			str[len] = 0;
+			break;
+		}
+	}
+
+	return str;
+}
+
+// gives convert_decode () and convert_encode () the memory they ask for:
+// the mapped output file, or memory for the pixels
+unsigned char *make (void *arg, uint32_t what, size_t size)
+{
+	(void) arg;
+
+	if (what == CONVERT_FILE) {
+		return aio_create (outfile, (uint32_t) size);
+	}
+
+	image = (unsigned char *) lodepng_malloc (size);
+	return image;
+}
+
+// writes the output made by convert_encode (). returns 0 or the cleanup code.
+int write_output (void)
+{
+	outfilesize = (uint32_t) job.file_size;
+
+	if (to == FMT_PNG) {
+		output = NULL;
+		return aio_write (outfile, job.file, outfilesize); // frees the png
+	}
+
+	if (to == FMT_TGA) {
+		aio_trim (outfilesize);
+	}
+
+	return aio_commit ();
+}
+
+int main (int argc, char *argv[])
+{
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--to=", 5) == 0) {
+			for (to = FMT_TGA; to > FMT_NONE; to--) {
+				if (strcasecmp (argv[arg] + 5, fmt_ext[to] + 1) == 0) {
+					break;
+				}
+			}
+
+			if (to == FMT_NONE) {
+				fprintf (stderr, "--to must be mbm, png or tga\n");
+				return 1;
+			}
+
+		} else if (strcmp (argv[arg], "--interlace") == 0) {
+			// write adam7 interlaced png files
+			interlace = 1;
+
+		} else if (strcmp (argv[arg], "--rle") == 0) {
+			// write run length encoded tga files
+			rle = 1;
+
+		} else if (strncmp (argv[arg], "--sample", 8) == 0) {
+			// decide the normal map type from a percentage of the rows
+			sample = (argv[arg][8] == '=') ? atoi (argv[arg] + 9) : SAMPLE_PERCENT;
+			sample = (sample > 100) ? 100 : sample;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]))) {
+			argfile = argv[arg];
+		}
+	}
+
+	// -r finds the files of the other two formats, unless told otherwise
+	if (! walk_includes) {
+		for (n = FMT_MBM; n <= FMT_TGA; n++) {
+			if (n != to) {
+				walk_include[walk_includes++] = (n == FMT_MBM) ? "*.mbm" : (n == FMT_PNG) ? "*.png" : "*.tga";
+			}
+		}
+	}
+
+	cache_open ("mbmconv", (to | (rle << 2) | (interlace << 3) | (sample << 4)));
+	walk_start (fmt_ext[to]);
+	aio_start ();
+
+	while (1) {
+		infile = (char *) malloc (bufsz * sizeof (char));
+		outfile = (char *) malloc (bufsz * sizeof (char));
+		filename = (char *) malloc (bufsz * sizeof (char));
+
+		if (! (infile && outfile && filename)) {
+			erc = 1;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename -> %s", filename);
+			fflush (stdout);
+
+		} else {
+			fprintf (stdout, "Filename ");
+
+			if (! (readline (filename, bufsz, stdin))) {
+				fprintf (stdout, "-> none, exiting");
+				fflush (stdout);
+				cleanup (0);
+				break;
+
+			} else {
+				fprintf (stdout, "-> %s", filename);
+				fflush (stdout);
+			}
+		}
+
+		sprintf (infile, "%s", filename);
+		sprintf (outfile, "%s%s", bname (filename), fmt_ext[to]);
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_read (infile, &buffer, &infilesize);
+
+		if (erc) {
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		lodepng_stats_add (&stats, LSP_READ, stats_start, infilesize);
+		stats_start = lodepng_stats_clock (&stats);
+		memset (&job, 0, sizeof (job));
+		job.in = buffer;
+		job.in_size = infilesize;
+		job.from = convert_sniff (buffer, infilesize);
+		job.to = to;
+		job.sample = sample;
+		job.rle = rle;
+		job.interlace = interlace;
+		job.stats = &stats;
+		job.make = make;
+
+		// an input of the output format would be written over itself
+		if ((job.from == FMT_NONE) || (job.from == to)) {
+			erc = 10;
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		if (cache_fetch (buffer, infilesize, outfile)) {
+			trace_file_end (0, 0, infilesize, cache_size);
+			stats_file (infile);
+			cleanup (0);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		erc = convert_decode (&job);
+
+		if (erc) {
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		erc = convert_encode (&job);
+		output = (to == FMT_PNG) ? job.file : NULL;
+
+		if (! erc) {
+			stats_start = lodepng_stats_clock (&stats);
+			erc = write_output ();
+		}
+
+		if (erc) {
+			cleanup (erc);
+
+			if (argfile) {
+				break;
+			}
+
+			continue;
+		}
+
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, outfilesize);
+		cache_store (outfile);
+		trace_file_end (job.width, job.height, infilesize, outfilesize);
+		stats_file (infile);
+
+		cleanup (0);
+
+		if (argfile) {
+			break;
+		}
+	}
+
+	aio_finish ();
+	cache_close ();
+	stats_print ("mbmconv");
+	trace_write ("mbmconv");
+	cleanup (0);
+
+	// a file named on the command line gives its error as the exit code
+	return argfile ? erc : 0;
+}
@@ -0,0 +1,1017 @@
+/*
+ * mbmd.c - conversion daemon: does the work of mbm2png, png2mbm, mbm2tga
+ * and tga2mbm for clients on a local socket, so editor plugins and build
+ * scripts don't pay for starting a converter for every texture.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * usage: mbmd [--socket=PATH] [--threads=N] [--watch=DIR]
+ *
+ * Listens on a Unix socket (default $XDG_RUNTIME_DIR/mbmd.sock, else
+ * /tmp/mbmd-UID.sock). A client sends one job per line:
+ *
+ *   TOOL [--sample[=N]] [--rle] [--interlace] FILE
+ *
+ * TOOL is mbm2png, png2mbm, mbm2tga or tga2mbm, FILE the rest of the line
+ * (an absolute path, the daemon has its own working directory). The
+ * options are those of the utilities, --rle for mbm2tga and --interlace
+ * for mbm2png. Every job is answered with one line, "ok OUTFILE" or
+ * "error MESSAGE", in order. The conversions are those of mbmconv, in
+ * convert.c, so the output is the same file the utility would write.
+ *
+ * A pool of worker threads is started once. Each worker keeps its own
+ * buffers from job to job, so a warm daemon converts a texture without
+ * starting a process or growing its buffers again. A
+ * connection is served by one worker, clients that want several textures
+ * converted at once open several connections. POSIX only.
+ *
+ * With --watch=DIR (Linux only) the daemon also watches DIR and all
+ * folders below it with inotify, and converts every .png or .tga that is
+ * written there to .mbm, and every .mbm to .png, as soon as it is saved.
+ * A file is converted once it has been left alone for MBMD_DEBOUNCE
+ * seconds (editors often write a file more than once), the most recently
+ * saved files first. The files the daemon writes itself are not
+ * converted back.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <ctype.h>
+#include <signal.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <poll.h>
+#include <dirent.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#define LODEPNG_NO_COMPILE_DISK
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
+#define MAGIC 0x50534B03
+#define IHDR 0x49484452
+
+// mbm header offsets
+#define magic_ofs 0x00
+#define width_ofs 0x04
+#define height_ofs 0x08
+#define type_ofs 0x0C
+#define bits_ofs 0x10
+#define mbm_ofs 0x14
+
+// png header offset
+#define png_ihdr 0x0C
+
+// tga header offsets
+#define IDLength 0x00
+#define ColorMapType 0x01
+#define ImageType 0x02
+#define CMapStart 0x03
+#define CMapLength 0x05
+#define CMapDepth 0x07
+#define XOffset 0x08
+#define YOffset 0x0A
+#define Width 0x0C
+#define Height 0x0E
+#define PixelDepth 0x10
+#define ImageDescriptor 0x11
+#define tga_ofs 0x12
+
+// png text chunk that remembers the mbm bit depth
+#define BITS_KEY "MBM bits"
+
+#define bufsz 8192
+
+#define MBMD_THREADS 4 // if the number of cpus can't be found
+#define MBMD_QUEUE 64 // connections waiting for a worker
+#define MBMD_DEBOUNCE 0.1 // seconds a watched file must be left alone
+#define MBMD_WRITTEN 256 // outputs remembered, so they aren't converted back
+
+#include "check_type.c"
+#include "tga.c"
+#include "convert.c"
+
+// what a worker keeps from job to job
+typedef struct mbmd_context {
+	unsigned char *in; // the input file
+	size_t in_cap;
+	unsigned char *out; // the output file
+	size_t out_cap;
+	unsigned char *pixels;
+	size_t pixels_cap;
+	char line[bufsz];
+	size_t line_len;
+	uint32_t jobs;
+} mbmd_context;
+
+char socket_path[bufsz];
+uint32_t threads = 0;
+mode_t file_mask = 022; // the umask mbmd was started with, for its outputs
+
+// connections accepted but not yet taken by a worker
+int queue[MBMD_QUEUE];
+uint32_t queue_head = 0;
+uint32_t queue_used = 0;
+pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+pthread_cond_t queue_space = PTHREAD_COND_INITIALIZER;
+
+// a watched file that was saved
+typedef struct watch_file {
+	char *path;
+	double touched; // time of the last event
+} watch_file;
+
+char *watch_dir = NULL;
+
+// watched files that are due, taken by the workers before connections,
+// newest first. also guarded by queue_lock.
+watch_file ready[MBMD_QUEUE];
+uint32_t ready_used = 0;
+
+// the last outputs written for watched files
+typedef struct written_file {
+	char *path;
+	struct timespec mtime;
+	off_t size;
+} written_file;
+
+written_file written[MBMD_WRITTEN];
+uint32_t written_next = 0;
+pthread_mutex_t written_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// monotonic time in seconds
+double now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec + ((double) ts.tv_nsec / 1e9));
+}
+
+// makes buf hold at least size bytes. it never shrinks, so a warm
+// worker allocates nothing for textures no larger than before.
+int reserve (unsigned char **buf, size_t *cap, size_t size)
+{
+	unsigned char *p;
+
+	if (size <= *cap) {
+		return 1;
+	}
+
+	size = (size < (*cap * 2)) ? (*cap * 2) : size;
+	p = (unsigned char *) realloc (*buf, size);
+
+	if (! p) {
+		return 0;
+	}
+
+	*buf = p;
+	*cap = size;
+	return 1;
+}
+
+// reads a whole file into ctx->in, returns its size or -1
+long read_file (mbmd_context *ctx, const char *name)
+{
+	struct stat st;
+	ssize_t len;
+	size_t done = 0;
+	int fd = open (name, O_RDONLY);
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if ((fstat (fd, &st) != 0) || (! reserve (&ctx->in, &ctx->in_cap, st.st_size + 1))) {
+		close (fd);
+		return -1;
+	}
+
+	while (done < (size_t) st.st_size) {
+		len = read (fd, ctx->in + done, st.st_size - done);
+
+		if (len <= 0) {
+			break;
+		}
+
+		done += len;
+	}
+
+	close (fd);
+	return (done == (size_t) st.st_size) ? (long) done : -1;
+}
+
+// like the utilities, writes a hidden temporary file next to the output
+// and renames it over the output when complete. mkstemp makes it 0600,
+// so it gets the mode fopen would have given it.
+int write_file (const char *name, const unsigned char *data, size_t size)
+{
+	char temp[bufsz];
+	const char *base = strrchr (name, '/');
+	ssize_t len;
+	size_t done = 0;
+	int fd;
+
+	base = base ? (base + 1) : name;
+	snprintf (temp, bufsz, "%.*s.%s.XXXXXX", (int) (base - name), name, base);
+	fd = mkstemp (temp);
+
+	if (fd < 0) {
+		return 0;
+	}
+
+	fchmod (fd, 0666 & ~file_mask);
+
+	while (done < size) {
+		len = write (fd, data + done, size - done);
+
+		if (len <= 0) {
+			break;
+		}
+
+		done += len;
+	}
+
+	if ((close (fd) == 0) && (done == size) && (rename (temp, name) == 0)) {
+		return 1;
+	}
+
+	unlink (temp);
+	return 0;
+}
+
+// gives convert_decode () and convert_encode () the memory they ask for,
+// from the buffers of the worker
+unsigned char *make (void *arg, uint32_t what, size_t size)
+{
+	mbmd_context *ctx = (mbmd_context *) arg;
+
+	if (what == CONVERT_FILE) {
+		return reserve (&ctx->out, &ctx->out_cap, size) ? ctx->out : NULL;
+	}
+
+	return reserve (&ctx->pixels, &ctx->pixels_cap, size) ? ctx->pixels : NULL;
+}
+
+// does what the utility of the same name does, with the conversions of
+// mbmconv. returns 0 or the error number of convert.c.
+int convert (convert_job *job, const char *outfile)
+{
+	int erc;
+
+	// a tool given a file of another format fails like the utility would
+	if (convert_sniff (job->in, job->in_size) != job->from) {
+		return 6;
+	}
+
+	erc = convert_decode (job);
+
+	if (! erc) {
+		erc = convert_encode (job);
+	}
+
+	if ((! erc) && (! write_file (outfile, job->file, job->file_size))) {
+		erc = 5;
+	}
+
+	if (job->to == FMT_PNG) {
+		lodepng_free (job->file);
+	}
+
+	return erc;
+}
+
+// runs one job line, writes the answer into reply
+void run_job (mbmd_context *ctx, char *line, char *reply)
+{
+	char outfile[bufsz - 16]; // leaves room for the reply around it
+	convert_job job;
+	char *tool = line;
+	char *file;
+	char *ext;
+	long size;
+	int len;
+	int erc;
+
+	memset (&job, 0, sizeof (job));
+	job.make = make;
+	job.arg = ctx;
+
+	file = strchr (line, ' ');
+
+	if (! file) {
+		snprintf (reply, bufsz, "error no file\n");
+		return;
+	}
+
+	*file++ = 0;
+
+	while (strncmp (file, "--", 2) == 0) {
+		if (strncmp (file, "--sample", 8) == 0) {
+			job.sample = ((file[8] == '=') ? atoi (file + 9) : SAMPLE_PERCENT);
+			job.sample = (job.sample > 100) ? 100 : job.sample;
+
+		} else if (strncmp (file, "--rle ", 6) == 0) {
+			job.rle = 1;
+
+		} else if (strncmp (file, "--interlace ", 12) == 0) {
+			job.interlace = 1;
+
+		} else {
+			snprintf (reply, bufsz, "error unknown option\n");
+			return;
+		}
+
+		file = strchr (file, ' ');
+
+		if (! file) {
+			snprintf (reply, bufsz, "error no file\n");
+			return;
+		}
+
+		file++;
+	}
+
+	if (strcmp (tool, "mbm2png") == 0) {
+		job.from = FMT_MBM;
+		job.to = FMT_PNG;
+
+	} else if (strcmp (tool, "png2mbm") == 0) {
+		job.from = FMT_PNG;
+		job.to = FMT_MBM;
+
+	} else if (strcmp (tool, "mbm2tga") == 0) {
+		job.from = FMT_MBM;
+		job.to = FMT_TGA;
+
+	} else if (strcmp (tool, "tga2mbm") == 0) {
+		job.from = FMT_TGA;
+		job.to = FMT_MBM;
+
+	} else {
+		snprintf (reply, bufsz, "error unknown tool %s\n", tool);
+		return;
+	}
+
+	ext = (job.to == FMT_PNG) ? ".png" : (job.to == FMT_TGA) ? ".tga" : ".mbm";
+
+	// the same name the utility would give it: the extension replaced
+	len = strlen (file);
+
+	while (len--) {
+		if (file[len] == '.') {
+			break;
+		}
+	}
+
+	len = (len < 0) ? (int) strlen (file) : len;
+
+	if (((size_t) len + strlen (ext)) >= sizeof (outfile)) {
+		snprintf (reply, bufsz, "error name too long\n");
+		return;
+	}
+
+	memcpy (outfile, file, len);
+	strcpy (outfile + len, ext);
+	size = read_file (ctx, file);
+
+	if (size < 0) {
+		erc = 2;
+
+	} else {
+		job.in = ctx->in;
+		job.in_size = size;
+		erc = convert (&job, outfile);
+	}
+
+	ctx->jobs++;
+
+	if (job.png_error) {
+		snprintf (reply, bufsz, "error %s\n", lodepng_error_text (job.png_error));
+
+	} else if (erc) {
+		snprintf (reply, bufsz, "error %s failed\n", convert_error[erc]);
+
+	} else {
+		snprintf (reply, bufsz, "ok %s\n", outfile);
+	}
+}
+
+// answers every line of one connection until the client hangs up
+void serve (mbmd_context *ctx, int fd)
+{
+	char reply[bufsz];
+	char *end;
+	ssize_t len;
+	size_t used;
+
+	ctx->line_len = 0;
+
+	while (1) {
+		end = memchr (ctx->line, '\n', ctx->line_len);
+
+		if (end) {
+			*end = 0;
+
+			if ((end > ctx->line) && (end[-1] == '\r')) {
+				end[-1] = 0;
+			}
+
+			run_job (ctx, ctx->line, reply);
+
+			if (write (fd, reply, strlen (reply)) < 0) {
+				break;
+			}
+
+			used = (end + 1) - ctx->line;
+			memmove (ctx->line, end + 1, ctx->line_len - used);
+			ctx->line_len -= used;
+			continue;
+		}
+
+		if (ctx->line_len == (bufsz - 1)) {
+			snprintf (reply, bufsz, "error line too long\n");
+
+			if (write (fd, reply, strlen (reply)) < 0) {
+				// gone anyway
+			}
+
+			break;
+		}
+
+		len = read (fd, ctx->line + ctx->line_len, (bufsz - 1) - ctx->line_len);
+
+		if (len <= 0) {
+			break;
+		}
+
+		ctx->line_len += len;
+	}
+
+	close (fd);
+}
+
+// returns the tool for a watched file, NULL if it isn't one
+const char *watch_tool (const char *path)
+{
+	const char *ext = strrchr (path, '.');
+
+	if (! ext) {
+		return NULL;
+	}
+
+	if (strcasecmp (ext, ".png") == 0) {
+		return "png2mbm";
+
+	} else if (strcasecmp (ext, ".tga") == 0) {
+		return "tga2mbm";
+
+	} else if (strcasecmp (ext, ".mbm") == 0) {
+		return "mbm2png";
+	}
+
+	return NULL;
+}
+
+// remembers an output, or tells if path is one that hasn't changed since
+int watch_written (const char *path, int remember)
+{
+	struct stat st;
+	uint32_t n;
+	int found = 0;
+
+	if (stat (path, &st) != 0) {
+		return remember ? 0 : 1; // gone, nothing to convert
+	}
+
+	pthread_mutex_lock (&written_lock);
+
+	for (n = 0; n < MBMD_WRITTEN; n++) {
+		if (written[n].path && (strcmp (written[n].path, path) == 0)) {
+			found = ((written[n].size == st.st_size) && (written[n].mtime.tv_sec == st.st_mtim.tv_sec)
+				&& (written[n].mtime.tv_nsec == st.st_mtim.tv_nsec));
+			break;
+		}
+	}
+
+	if (remember) {
+		if (n == MBMD_WRITTEN) {
+			n = written_next;
+			written_next = (written_next + 1) % MBMD_WRITTEN;
+			free (written[n].path);
+			written[n].path = strdup (path);
+		}
+
+		written[n].mtime = st.st_mtim;
+		written[n].size = st.st_size;
+	}
+
+	pthread_mutex_unlock (&written_lock);
+	return found;
+}
+
+// converts a watched file and logs how long after saving it was done
+void watch_job (mbmd_context *ctx, watch_file *file)
+{
+	char line[bufsz];
+	char reply[bufsz];
+	const char *tool = watch_tool (file->path);
+
+	snprintf (line, bufsz, "%s %s", tool, file->path);
+	run_job (ctx, line, reply);
+
+	if (strncmp (reply, "ok ", 3) == 0) {
+		reply[strlen (reply) - 1] = 0;
+		watch_written (reply + 3, 1);
+		fprintf (stderr, "mbmd: %s -> %s (%.0f ms after saving)\n", file->path, reply + 3,
+			(now () - file->touched) * 1e3);
+
+	} else {
+		fprintf (stderr, "mbmd: %s -> %s", file->path, reply);
+	}
+
+	free (file->path);
+}
+
+void *worker (void *arg)
+{
+	mbmd_context *ctx = (mbmd_context *) calloc (1, sizeof (mbmd_context));
+	watch_file file;
+	uint32_t n, newest;
+	int fd;
+	(void) arg;
+
+	if (! ctx) {
+		fprintf (stderr, "mbmd: malloc failed\n");
+		return NULL;
+	}
+
+	while (1) {
+		pthread_mutex_lock (&queue_lock);
+
+		while (! (queue_used || ready_used)) {
+			pthread_cond_wait (&queue_ready, &queue_lock);
+		}
+
+		if (ready_used) {
+			for (n = 1, newest = 0; n < ready_used; n++) {
+				newest = (ready[n].touched > ready[newest].touched) ? n : newest;
+			}
+
+			file = ready[newest];
+			ready[newest] = ready[--ready_used];
+			pthread_mutex_unlock (&queue_lock);
+			watch_job (ctx, &file);
+			continue;
+		}
+
+		fd = queue[queue_head];
+		queue_head = (queue_head + 1) % MBMD_QUEUE;
+		queue_used--;
+		pthread_cond_signal (&queue_space);
+		pthread_mutex_unlock (&queue_lock);
+
+		serve (ctx, fd);
+	}
+
+	return NULL;
+}
+
+#ifdef __linux__
+
+// the folder of every inotify watch, by watch descriptor
+char **watch_dirs = NULL;
+int watch_dirs_size = 0;
+
+// watches dir and every folder below it
+void watch_tree (int fd, const char *dir)
+{
+	char path[bufsz];
+	struct dirent *entry;
+	char **dirs;
+	DIR *dp;
+	int wd = inotify_add_watch (fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+
+	if (wd < 0) {
+		fprintf (stderr, "mbmd: can't watch %s\n", dir);
+		return;
+	}
+
+	if (wd >= watch_dirs_size) {
+		dirs = (char **) realloc (watch_dirs, (wd + 64) * sizeof (char *));
+
+		if (! dirs) {
+			return;
+		}
+
+		memset (dirs + watch_dirs_size, 0, ((wd + 64) - watch_dirs_size) * sizeof (char *));
+		watch_dirs = dirs;
+		watch_dirs_size = (wd + 64);
+	}
+
+	free (watch_dirs[wd]);
+	watch_dirs[wd] = strdup (dir);
+	dp = opendir (dir);
+
+	while (dp && (entry = readdir (dp))) {
+		if ((entry->d_type == DT_DIR) && (entry->d_name[0] != '.')) {
+			snprintf (path, bufsz, "%s/%s", dir, entry->d_name);
+			watch_tree (fd, path);
+		}
+	}
+
+	if (dp) {
+		closedir (dp);
+	}
+}
+
+// watched files waiting to be left alone long enough, only used by the
+// watching thread
+watch_file *pending = NULL;
+uint32_t pending_used = 0;
+uint32_t pending_size = 0;
+
+// adds a saved file to pending, or makes an already pending one wait longer
+void watch_pend (const char *path)
+{
+	watch_file *grown;
+	uint32_t n;
+
+	for (n = 0; (n < pending_used) && (strcmp (pending[n].path, path) != 0); n++) {
+	}
+
+	if (n == pending_used) {
+		if (pending_used == pending_size) {
+			grown = (watch_file *) realloc (pending, (pending_size + 64) * sizeof (watch_file));
+
+			if (! grown) {
+				return;
+			}
+
+			pending = grown;
+			pending_size += 64;
+		}
+
+		pending[pending_used++].path = strdup (path);
+	}
+
+	pending[n].touched = now ();
+}
+
+// after events were lost: pends every file below dir that was changed
+// since the events last seen, as if its save had been seen
+void watch_rescan (const char *dir, const struct timespec *since)
+{
+	char path[bufsz];
+	struct stat st;
+	struct dirent *entry;
+	DIR *dp = opendir (dir);
+
+	while (dp && (entry = readdir (dp))) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		snprintf (path, bufsz, "%s/%s", dir, entry->d_name);
+
+		if (entry->d_type == DT_DIR) {
+			watch_rescan (path, since);
+
+		} else if (watch_tool (path) && (stat (path, &st) == 0) && ((st.st_mtim.tv_sec > since->tv_sec)
+			|| ((st.st_mtim.tv_sec == since->tv_sec) && (st.st_mtim.tv_nsec >= since->tv_nsec)))) {
+			watch_pend (path); // our own outputs are left out later, as always
+		}
+	}
+
+	if (dp) {
+		closedir (dp);
+	}
+}
+
+// the watching thread. saved files wait in pending until they have been
+// left alone long enough, then are handed to the workers.
+void *watcher (void *arg)
+{
+	char events[64 * 1024] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+	char path[bufsz];
+	struct inotify_event *ev;
+	struct pollfd pfd;
+	struct timespec seen, reading;
+	uint32_t n;
+	double first;
+	ssize_t len;
+	int wait;
+	char *p;
+	(void) arg;
+
+	pfd.fd = inotify_init1 (IN_CLOEXEC);
+	pfd.events = POLLIN;
+
+	if (pfd.fd < 0) {
+		perror ("mbmd: inotify");
+		return NULL;
+	}
+
+	clock_gettime (CLOCK_REALTIME, &seen);
+	watch_tree (pfd.fd, watch_dir);
+	fprintf (stderr, "mbmd: watching %s\n", watch_dir);
+	fflush (stderr);
+
+	while (1) {
+		for (n = 0, first = 0; n < pending_used; n++) {
+			first = ((! n) || (pending[n].touched < first)) ? pending[n].touched : first;
+		}
+
+		// at least a millisecond, in case the workers have no room yet
+		wait = (int) ((first + MBMD_DEBOUNCE - now ()) * 1e3) + 1;
+		wait = (wait < 1) ? 1 : wait;
+
+		if (poll (&pfd, 1, pending_used ? wait : -1) > 0) {
+			clock_gettime (CLOCK_REALTIME, &reading);
+			len = read (pfd.fd, events, sizeof (events));
+
+			for (p = events; (len > 0) && (p < (events + len)); p += sizeof (struct inotify_event) + ev->len) {
+				ev = (struct inotify_event *) p;
+
+				if (ev->mask & IN_Q_OVERFLOW) {
+					// the kernel dropped events (wd is -1): look at the whole tree
+					fprintf (stderr, "mbmd: too many changes at once, rescanning %s\n", watch_dir);
+					fflush (stderr);
+					watch_tree (pfd.fd, watch_dir);
+					watch_rescan (watch_dir, &seen);
+					continue;
+				}
+
+				if ((ev->wd < 0) || (ev->wd >= watch_dirs_size) || (! watch_dirs[ev->wd]) || (! ev->len)) {
+					continue;
+				}
+
+				snprintf (path, bufsz, "%s/%s", watch_dirs[ev->wd], ev->name);
+
+				if (ev->mask & IN_ISDIR) {
+					if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+						watch_tree (pfd.fd, path); // files saved in it before this are missed
+					}
+
+					continue;
+				}
+
+				if ((! (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) || (! watch_tool (path))) {
+					continue;
+				}
+
+				watch_pend (path);
+			}
+
+			if (len > 0) {
+				seen = reading; // every change before the read was in it, or rescanned
+			}
+		}
+
+		// hand the quiet ones to the workers, while there is room
+		pthread_mutex_lock (&queue_lock);
+
+		for (n = 0; n < pending_used; n++) {
+			if ((now () - pending[n].touched) < MBMD_DEBOUNCE) {
+				continue;
+			}
+
+			if (watch_written (pending[n].path, 0)) {
+				free (pending[n].path); // our own output
+
+			} else if (ready_used < MBMD_QUEUE) {
+				ready[ready_used++] = pending[n];
+				pthread_cond_signal (&queue_ready);
+
+			} else {
+				continue; // next time
+			}
+
+			pending[n--] = pending[--pending_used];
+		}
+
+		pthread_mutex_unlock (&queue_lock);
+	}
+
+	return NULL;
+}
+
+#endif
+
+void quit (int sig)
+{
+	(void) sig;
+	unlink (socket_path);
+	_exit (0);
+}
+
+// makes way for the socket: a socket that refuses connections was left by
+// a daemon that was killed, and is removed. returns NULL if the path is
+// free, else why it isn't.
+const char *free_socket (const struct sockaddr_un *addr)
+{
+	struct stat st;
+	int fd, err;
+
+	if (lstat (addr->sun_path, &st) != 0) {
+		return NULL;
+	}
+
+	if (! S_ISSOCK (st.st_mode)) {
+		return "is not a socket, not removed";
+	}
+
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		return "can't be checked";
+	}
+
+	err = (connect (fd, (const struct sockaddr *) addr, sizeof (*addr)) == 0) ? 0 : errno;
+	close (fd);
+
+	if (! err) {
+		return "is in use, mbmd already running";
+	}
+
+	if (err != ECONNREFUSED) {
+		return "can't be checked";
+	}
+
+	return (unlink (addr->sun_path) == 0) ? NULL : "can't be removed";
+}
+
+void default_socket (char *path)
+{
+	const char *dir = getenv ("XDG_RUNTIME_DIR");
+
+	if (getenv ("MBMD_SOCKET")) {
+		snprintf (path, bufsz, "%s", getenv ("MBMD_SOCKET"));
+
+	} else if (dir && *dir) {
+		snprintf (path, bufsz, "%s/mbmd.sock", dir);
+
+	} else {
+		snprintf (path, bufsz, "/tmp/mbmd-%u.sock", (unsigned) getuid ());
+	}
+}
+
+int main (int argc, char *argv[])
+{
+	struct sockaddr_un addr;
+	const char *err;
+	pthread_t thread;
+	long cpus;
+	uint32_t n;
+	int arg;
+	int fd, client;
+
+	default_socket (socket_path);
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--socket=", 9) == 0) {
+			snprintf (socket_path, bufsz, "%s", argv[arg] + 9);
+
+		} else if (strncmp (argv[arg], "--threads=", 10) == 0) {
+			threads = atoi (argv[arg] + 10);
+
+		} else if (strncmp (argv[arg], "--watch=", 8) == 0) {
+			watch_dir = argv[arg] + 8;
+
+		} else if ((strcmp (argv[arg], "--watch") == 0) && ((arg + 1) < argc)) {
+			watch_dir = argv[++arg];
+
+		} else {
+			fprintf (stderr, "usage: mbmd [--socket=PATH] [--threads=N] [--watch=DIR]\n");
+			return 1;
+		}
+	}
+
+	if (! threads) {
+		cpus = sysconf (_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0) ? cpus : MBMD_THREADS;
+	}
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+
+	if (strlen (socket_path) >= sizeof (addr.sun_path)) {
+		fprintf (stderr, "mbmd: socket path too long\n");
+		return 1;
+	}
+
+	strcpy (addr.sun_path, socket_path);
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0) {
+		perror ("mbmd: socket");
+		return 1;
+	}
+
+	err = free_socket (&addr);
+
+	if (err) {
+		fprintf (stderr, "mbmd: %s %s\n", socket_path, err);
+		return 1;
+	}
+
+	file_mask = umask (0077); // only the user that started it may send jobs
+
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		perror ("mbmd: bind");
+		return 1;
+	}
+
+	umask (file_mask); // the outputs are made as the utilities make them
+
+	if (listen (fd, MBMD_QUEUE) != 0) {
+		perror ("mbmd: listen");
+		return 1;
+	}
+
+	signal (SIGPIPE, SIG_IGN); // a client that hangs up only ends its connection
+	signal (SIGINT, quit);
+	signal (SIGTERM, quit);
+
+	for (n = 0; n < threads; n++) {
+		if (pthread_create (&thread, NULL, worker, NULL) != 0) {
+			perror ("mbmd: pthread_create");
+			unlink (socket_path);
+			return 1;
+		}
+
+		pthread_detach (thread);
+	}
+
+	if (watch_dir) {
+#ifdef __linux__
+		if (pthread_create (&thread, NULL, watcher, NULL) != 0) {
+			perror ("mbmd: pthread_create");
+			unlink (socket_path);
+			return 1;
+		}
+
+		pthread_detach (thread);
+#else
+		fprintf (stderr, "mbmd: --watch needs inotify, Linux only\n");
+#endif
+	}
+
+	fprintf (stderr, "mbmd: %u threads on %s\n", threads, socket_path);
+	fflush (stderr);
+
+	while (1) {
+		client = accept (fd, NULL, NULL);
+
+		if (client < 0) {
+			continue;
+		}
+
+		pthread_mutex_lock (&queue_lock);
+
+		while (queue_used == MBMD_QUEUE) {
+			pthread_cond_wait (&queue_space, &queue_lock);
+		}
+
+		queue[(queue_head + queue_used) % MBMD_QUEUE] = client;
+		queue_used++;
+		pthread_cond_signal (&queue_ready);
+		pthread_mutex_unlock (&queue_lock);
+	}
+
+	return 0;
+}
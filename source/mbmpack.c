@@ -0,0 +1,566 @@
+/*
+ * mbmpack.c - packs Kerbal Space Program textures (MBM files) into one
+ * indexed texture pack, or lists the textures of a pack.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * mbmpack --pack=FILE [-r DIR | names...]: the headers of the textures
+ * are read first, to lay the pack out, then their files are read by a
+ * few threads straight into the pack. A texture is named by its path
+ * below DIR (or as given), without the .mbm, the way KSP names them.
+ * mbmpack --list=FILE prints the index of a pack.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <ctype.h>
+
+// lodepng is only needed for the LodePNGStats of --stats
+#define LODEPNG_NO_COMPILE_ZLIB
+#define LODEPNG_NO_COMPILE_PNG
+#define LODEPNG_NO_COMPILE_DECODER
+#define LODEPNG_NO_COMPILE_ENCODER
+#define LODEPNG_NO_COMPILE_DISK
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
+#define MAGIC 0x50534B03
+
+// mbm header offsets
+#define magic_ofs 0x00
+#define width_ofs 0x04
+#define height_ofs 0x08
+#define type_ofs 0x0C
+#define bits_ofs 0x10
+#define mbm_ofs 0x14
+
+#define bufsz 8192
+
+#define PACK_THREADS 8 // reading the files, more don't help the disk
+
+#include "pack.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
+
+// a texture going into the pack
+typedef struct pack_item {
+	char *path;
+	char *name;
+	pack_entry entry;
+	uint32_t order; // given, for the duplicates
+	uint32_t erc;
+} pack_item;
+
+// what a thread reads: items first, first + step, ...
+typedef struct pack_job {
+	unsigned char *out;
+	pack_item *items;
+	uint32_t count;
+	uint32_t first;
+	uint32_t step;
+} pack_job;
+
+char *filename = NULL;
+char *packfile = NULL;
+char *listfile = NULL;
+
+pack_item *items = NULL;
+uint32_t count = 0;
+uint32_t size = 0;
+uint32_t threads = 0;
+uint32_t errors = 0;
+
+int cleanup (int rc)
+{
+	const char *errmsg[] = {
+		"",
+		"malloc",
+		"open for read",
+		"open for write",
+		"read image",
+		"write image",
+		"header check",
+		"image type",
+		"image convert",
+		"duplicate name",
+	};
+
+	if (rc) {
+		fprintf (stderr, " ERROR: %s failed\n", errmsg[rc]);
+		fflush (stderr);
+		errors++;
+
+	} else {
+		fprintf (stdout, "\n");
+		fflush (stdout);
+	}
+
+	return rc;
+}
+
+int readline (char *str, int limit, FILE *fp)
+{
+	int len;
+	*str = 0;
+	len = 0;
+
+	if (fgets (str, limit, fp)) {
+		len = strlen (str);
+	}
+
+	while (len--) {
+		if (str[len] > 0x20) {
+			len++;
+			break;
+
+		} else {
+			str[len] = 0;
+		}
+	}
+
+	len++;
+	return len;
+}
+
+// the name of a texture: its path below -r (or as given), without a
+// leading ./ or the .mbm
+char *pack_name (const char *path)
+{
+	size_t root = (walk_root ? strlen (walk_root) : 0);
+	char *name;
+	char *dot;
+
+	if (walk_root && (strncmp (path, walk_root, root) == 0) && (path[root] == '/')) {
+		path += (root + 1);
+	}
+
+	while (strncmp (path, "./", 2) == 0) {
+		path += 2;
+	}
+
+	name = strdup (path);
+	dot = name ? strrchr (name, '.') : NULL;
+
+	if (dot && (! strchr (dot, '/'))) {
+		*dot = 0;
+	}
+
+	return name;
+}
+
+// reads the mbm header of a file and adds it to the items
+int pack_add (const char *path)
+{
+	unsigned char head[mbm_ofs];
+	pack_item *grown;
+	pack_item *item;
+	long filesize;
+	FILE *fp;
+
+	if (count == size) {
+		grown = (pack_item *) realloc (items, (size + 256) * sizeof (pack_item));
+
+		if (! grown) {
+			return 1;
+		}
+
+		items = grown;
+		size += 256;
+	}
+
+	item = &items[count];
+	memset (item, 0, sizeof (pack_item));
+	fp = fopen (path, "rb");
+
+	if (! fp) {
+		return 2;
+	}
+
+	fseek (fp, 0, SEEK_END);
+	filesize = ftell (fp);
+	fseek (fp, 0, SEEK_SET);
+
+	if ((filesize < mbm_ofs) || (fread (head, 1, mbm_ofs, fp) != mbm_ofs)) {
+		fclose (fp);
+		return 4;
+	}
+
+	fclose (fp);
+	item->entry.width = * ((uint32_t *) (head + width_ofs));
+	item->entry.height = * ((uint32_t *) (head + height_ofs));
+	item->entry.type = * ((uint32_t *) (head + type_ofs));
+	item->entry.bits = * ((uint32_t *) (head + bits_ofs));
+
+	if (* ((uint32_t *) (head + magic_ofs)) != MAGIC) {
+		return 6;
+	}
+
+	if ((item->entry.bits != 24) && (item->entry.bits != 32)) {
+		return 7;
+	}
+
+	if ((uint64_t) (filesize - mbm_ofs) < pack_pixel_size (&item->entry)) {
+		return 4;
+	}
+
+	item->path = strdup (path);
+	item->name = pack_name (path);
+
+	if (! (item->path && item->name)) {
+		free (item->path);
+		free (item->name);
+		return 1;
+	}
+
+	item->entry.name_len = strlen (item->name);
+	item->entry.hash = pack_hash (item->name, item->entry.name_len);
+	item->order = count++;
+	return 0;
+}
+
+int pack_item_compare (const void *a, const void *b)
+{
+	const pack_item *x = (const pack_item *) a;
+	const pack_item *y = (const pack_item *) b;
+
+	if (x->entry.hash != y->entry.hash) {
+		return (x->entry.hash < y->entry.hash) ? -1 : 1;
+	}
+
+	if (strcmp (x->name, y->name)) {
+		return strcmp (x->name, y->name);
+	}
+
+	return (x->order < y->order) ? -1 : 1;
+}
+
+// reads the mbm files of a job into their places in the pack
+void pack_read (const pack_job *job)
+{
+	pack_item *item;
+	uint64_t bytes;
+	uint32_t n;
+	FILE *fp;
+
+	for (n = job->first; n < job->count; n += job->step) {
+		item = &job->items[n];
+		bytes = (PACK_MBM + pack_pixel_size (&item->entry));
+		fp = fopen (item->path, "rb");
+
+		if (! fp) {
+			item->erc = 2;
+			continue;
+		}
+
+		if (fread (job->out + item->entry.offset, 1, bytes, fp) != bytes) {
+			item->erc = 4;
+		}
+
+		fclose (fp);
+	}
+}
+
+#ifndef _WIN32
+
+void *pack_thread (void *arg)
+{
+	pack_read ((const pack_job *) arg);
+	return NULL;
+}
+
+#endif
+
+// reads every item into the pack at out, with up to threads threads (0
+// for one per cpu)
+void pack_read_all (unsigned char *out)
+{
+	pack_job job[PACK_THREADS];
+	uint32_t jobs, t;
+#ifndef _WIN32
+	pthread_t thread[PACK_THREADS];
+	uint32_t started[PACK_THREADS] = { 0 };
+	long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+	jobs = threads ? threads : ((cpus > 0) ? (uint32_t) cpus : 1);
+#else
+	jobs = 1;
+#endif
+	jobs = (jobs > PACK_THREADS) ? PACK_THREADS : jobs;
+	jobs = (jobs > count) ? count : jobs;
+
+	for (t = 0; t < jobs; t++) {
+		job[t].out = out;
+		job[t].items = items;
+		job[t].count = count;
+		job[t].first = t;
+		job[t].step = jobs;
+	}
+
+#ifndef _WIN32
+	// a thread that can't be started leaves its files to this one
+	for (t = 1; t < jobs; t++) {
+		started[t] = (pthread_create (&thread[t], NULL, pack_thread, &job[t]) == 0);
+	}
+
+	if (jobs) {
+		pack_read (&job[0]);
+	}
+
+	for (t = 1; t < jobs; t++) {
+		if (started[t]) {
+			pthread_join (thread[t], NULL);
+
+		} else {
+			pack_read (&job[t]);
+		}
+	}
+#else
+	for (t = 0; t < jobs; t++) {
+		pack_read (&job[t]);
+	}
+#endif
+}
+
+// prints the index of a pack
+int pack_list (const char *name)
+{
+	const pack_entry *entry;
+	pack_file pack;
+	uint32_t n;
+	int erc;
+
+	fprintf (stdout, "Pack %s", name);
+	fflush (stdout);
+	erc = pack_open (&pack, name);
+
+	if (erc) {
+		return cleanup (erc);
+	}
+
+	fprintf (stdout, ", %u textures\n", pack.count);
+
+	for (n = 0; n < pack.count; n++) {
+		entry = &pack.index[n];
+		fprintf (stdout, "%5u x %-5u %2u bit type %u  %.*s\n", entry->width, entry->height,
+			entry->bits, entry->type, (int) entry->name_len, pack.names + entry->name);
+	}
+
+	pack_close (&pack);
+	fflush (stdout);
+	return 0;
+}
+
+// lays the pack out, reads the textures into it and puts it in place
+int pack_build (void)
+{
+	unsigned char *out;
+	pack_head *head;
+	uint64_t offset, names, end, total;
+	uint32_t n, kept;
+	int erc;
+
+	// by hash and name, the order pack_find () searches. a name that is
+	// there twice keeps its first texture.
+	if (count) {
+		qsort (items, count, sizeof (pack_item), pack_item_compare);
+	}
+
+	for (n = 0, kept = 0; n < count; n++) {
+		if (kept && (strcmp (items[kept - 1].name, items[n].name) == 0)) {
+			fprintf (stdout, "Filename %s", items[n].path);
+			fflush (stdout);
+			cleanup (9);
+			free (items[n].path);
+			free (items[n].name);
+			continue;
+		}
+
+		items[kept++] = items[n];
+	}
+
+	count = kept;
+	names = (sizeof (pack_head) + ((uint64_t) count * sizeof (pack_entry)));
+	offset = names;
+
+	for (n = 0; n < count; n++) {
+		items[n].entry.name = (uint32_t) (offset - names);
+		offset += items[n].entry.name_len;
+	}
+
+	end = offset;
+	total = end;
+
+	for (n = 0; n < count; n++) {
+		// the pixels on a page boundary, the mbm header just before them
+		offset = ((((total + PACK_MBM) + PACK_PAGE - 1) / PACK_PAGE) * PACK_PAGE) - PACK_MBM;
+		items[n].entry.offset = offset;
+		total = (offset + PACK_MBM + pack_pixel_size (&items[n].entry));
+	}
+
+	fprintf (stdout, "Pack %s, %u textures", packfile, count);
+	fflush (stdout);
+
+	if (total > 0xFFFFFFFFULL) {
+		return cleanup (5); // at most 4 GB, split bigger sets
+	}
+
+	out = aio_create (packfile, (uint32_t) total);
+
+	if (! out) {
+		return cleanup (3);
+	}
+
+	head = (pack_head *) out;
+	memset (out, 0, (size_t) names);
+	head->magic = PACK_MAGIC;
+	head->version = PACK_VERSION;
+	head->count = count;
+	head->page = PACK_PAGE;
+	head->names = (uint32_t) names;
+	head->names_size = (uint32_t) (end - names);
+	head->size = total;
+
+	for (n = 0; n < count; n++) {
+		memcpy (out + sizeof (pack_head) + (n * sizeof (pack_entry)), &items[n].entry, sizeof (pack_entry));
+		memcpy (out + names + items[n].entry.name, items[n].name, items[n].entry.name_len);
+	}
+
+	// the gaps in front of the pages
+	for (n = 0, offset = end; n < count; n++) {
+		memset (out + offset, 0, (size_t) (items[n].entry.offset - offset));
+		offset = (items[n].entry.offset + PACK_MBM + pack_pixel_size (&items[n].entry));
+	}
+
+	stats_start = lodepng_stats_clock (&stats);
+	pack_read_all (out);
+	lodepng_stats_add (&stats, LSP_READ, stats_start, (size_t) total);
+
+	for (n = 0; n < count; n++) {
+		if (items[n].erc) {
+			fprintf (stdout, "\nFilename %s", items[n].path);
+			fflush (stdout);
+			erc = items[n].erc;
+			aio_discard ();
+			return cleanup (erc);
+		}
+	}
+
+	stats_start = lodepng_stats_clock (&stats);
+	erc = aio_commit ();
+	lodepng_stats_add (&stats, LSP_WRITE, stats_start, (size_t) total);
+	return cleanup (erc);
+}
+
+int main (int argc, char *argv[])
+{
+	int named = 0;
+	int arg;
+	int erc;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--pack=", 7) == 0) {
+			packfile = argv[arg] + 7;
+
+		} else if (strncmp (argv[arg], "--list=", 7) == 0) {
+			listfile = argv[arg] + 7;
+
+		} else if (strncmp (argv[arg], "--threads=", 10) == 0) {
+			// threads reading the files, 0 for one per cpu
+			threads = atoi (argv[arg] + 10);
+
+		} else if (! (stats_option (argv[arg]) || walk_option (argc, argv, &arg))) {
+			if (argv[arg][0] != '-') {
+				continue; // a name, taken below
+			}
+
+			fprintf (stderr, "unknown option %s\n", argv[arg]);
+			return 1;
+		}
+	}
+
+	if (listfile) {
+		return pack_list (listfile);
+	}
+
+	if (! packfile) {
+		fprintf (stderr, "usage: mbmpack --pack=FILE [--threads=N] [-r DIR | FILE.mbm ...]\n"
+			"       mbmpack --list=FILE\n");
+		return 1;
+	}
+
+	filename = (char *) malloc (bufsz * sizeof (char));
+
+	if (! filename) {
+		return cleanup (1);
+	}
+
+	walk_start (".mbm");
+	stats_start = lodepng_stats_clock (&stats);
+
+	for (arg = 1; arg < argc; arg++) {
+		// names given after the options (the one after -r is its folder)
+		if ((argv[arg][0] == '-') || ((arg > 1) && (strcmp (argv[arg - 1], "-r") == 0))) {
+			continue;
+		}
+
+		fprintf (stdout, "Filename %s", argv[arg]);
+		fflush (stdout);
+		cleanup (pack_add (argv[arg]));
+		named++;
+	}
+
+	if (walk_root) {
+		while (walk_next (filename, bufsz)) {
+			fprintf (stdout, "Filename %s", filename);
+			fflush (stdout);
+			cleanup (pack_add (filename));
+		}
+
+	} else if (! named) {
+		while (readline (filename, bufsz, stdin)) {
+			fprintf (stdout, "Filename %s", filename);
+			fflush (stdout);
+			cleanup (pack_add (filename));
+		}
+	}
+
+	lodepng_stats_add (&stats, LSP_HEADER, stats_start, (size_t) count * mbm_ofs);
+	erc = pack_build ();
+
+	for (arg = 0; arg < (int) count; arg++) {
+		free (items[arg].path);
+		free (items[arg].name);
+	}
+
+	free (items);
+	free (filename);
+	stats_print ("mbmpack");
+	return (erc || errors) ? 1 : 0;
+}
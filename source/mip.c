@@ -0,0 +1,274 @@
+/*
+ * mip.c - makes the smaller mip levels of Kerbal Space Program textures,
+ * each half the size of the one before, down to 1x1. Used by mbm2dds.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// each pixel of a level is the average of 2x2 pixels of the one above
+// (a box filter). an odd last row or column is left out, and a side of
+// 1 pixel stays 1. the levels are made together, a row at a time: as
+// soon as a level has the two rows the next one needs, that row is made,
+// so the rows are still in the cache when they are read again.
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_SSE2
+#endif
+
+#define MIP_SRGB 0x01 // average the colors as light (linear), not as srgb values
+#define MIP_ALPHA 0x02 // weight the colors by their alpha
+#define MIP_NORMAL 0x04 // a normal map (y, y, y, x): average the normals, renormalized
+#define MIP_LEVELS 32 // most levels, a 1x1 is reached well before
+#define MIP_LINEAR 16384 // steps of the linear to srgb table
+
+float mip_to_linear[256];
+unsigned char mip_to_srgb[MIP_LINEAR + 1];
+int mip_tables = 0;
+
+// the number of levels of a texture, itself included
+uint32_t mip_levels (uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+
+	while ((width > 1) || (height > 1)) {
+		width = (width > 1) ? (width / 2) : 1;
+		height = (height > 1) ? (height / 2) : 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+// the size of a level below width x height
+void mip_next (uint32_t *width, uint32_t *height)
+{
+	*width = (*width > 1) ? (*width / 2) : 1;
+	*height = (*height > 1) ? (*height / 2) : 1;
+}
+
+// the bytes of levels 1 to levels - 1, as mip_chain () lays them out
+size_t mip_chain_size (uint32_t width, uint32_t height, uint32_t bytes, uint32_t levels)
+{
+	size_t size = 0;
+	uint32_t n;
+
+	for (n = 1; n < levels; n++) {
+		mip_next (&width, &height);
+		size += ((size_t) width * height * bytes);
+	}
+
+	return size;
+}
+
+void mip_srgb_tables (void)
+{
+	double v;
+	uint32_t n;
+
+	for (n = 0; n < 256; n++) {
+		v = (n / 255.0);
+		mip_to_linear[n] = (float) ((v <= 0.04045) ? (v / 12.92) : pow ((v + 0.055) / 1.055, 2.4));
+	}
+
+	for (n = 0; n <= MIP_LINEAR; n++) {
+		v = ((double) n / MIP_LINEAR);
+		v = (v <= 0.0031308) ? (v * 12.92) : ((1.055 * pow (v, 1.0 / 2.4)) - 0.055);
+		mip_to_srgb[n] = (unsigned char) ((v * 255.0) + 0.5);
+	}
+
+	mip_tables = 1;
+}
+
+// a channel from the sum of 4 weighted values (linear if MIP_SRGB), or
+// from plain, the sum of the 4 unweighted ones, if all the weights are 0
+unsigned char mip_channel (float sum, float weight, float plain, uint32_t mode)
+{
+	float v;
+
+	if (weight <= 0.0f) {
+		sum = plain;
+		weight = 4.0f;
+	}
+
+	v = (sum / weight);
+
+	if (mode & MIP_SRGB) {
+		v = (v < 0.0f) ? 0.0f : ((v > 1.0f) ? 1.0f : v);
+		return mip_to_srgb[(uint32_t) ((v * MIP_LINEAR) + 0.5f)];
+	}
+
+	v = (v < 0.0f) ? 0.0f : ((v > 255.0f) ? 255.0f : v);
+	return (unsigned char) (v + 0.5f);
+}
+
+// the average of 4 normals of a (y, y, y, x) normal map, made unit
+// length again. z is not stored, it is what makes each one unit length.
+void mip_normal (unsigned char *out, const unsigned char *p[4])
+{
+	float x = 0.0f, y = 0.0f, z = 0.0f;
+	float nx, ny, nz, len;
+	uint32_t n;
+
+	for (n = 0; n < 4; n++) {
+		nx = ((p[n][3] / 127.5f) - 1.0f);
+		ny = ((p[n][1] / 127.5f) - 1.0f);
+		nz = (1.0f - (nx * nx) - (ny * ny));
+		x += nx;
+		y += ny;
+		z += (nz > 0.0f) ? sqrtf (nz) : 0.0f;
+	}
+
+	len = sqrtf ((x * x) + (y * y) + (z * z));
+
+	if (len > 0.0f) {
+		x /= len;
+		y /= len;
+
+	} else {
+		x = y = 0.0f;
+	}
+
+	out[0] = out[1] = out[2] = (unsigned char) (((y + 1.0f) * 127.5f) + 0.5f);
+	out[3] = (unsigned char) (((x + 1.0f) * 127.5f) + 0.5f);
+}
+
+// one row of a level (width wo) from rows a and b of the level above
+// (width wi)
+void mip_row (unsigned char *out, const unsigned char *a, const unsigned char *b,
+	uint32_t wi, uint32_t wo, uint32_t bytes, uint32_t mode)
+{
+	const unsigned char *p[4];
+	float sum, plain, weight, v, w[4];
+	uint32_t x = 0;
+	uint32_t c, n, x1;
+
+#ifdef MIP_SSE2
+	// 2 pixels from 4 of each row: the rows are added as 16 bit values,
+	// then the neighbours in each half, + 2 and / 4
+	__m128i zero = _mm_setzero_si128 ();
+	__m128i two = _mm_set1_epi16 (2);
+	__m128i ra, rb, lo, hi;
+
+	if ((bytes == 4) && (! mode) && (wi > 1)) {
+		for (; (x + 2) <= wo; x += 2, out += 8) {
+			ra = _mm_loadu_si128 ((const __m128i *) (a + (x * 8)));
+			rb = _mm_loadu_si128 ((const __m128i *) (b + (x * 8)));
+			lo = _mm_add_epi16 (_mm_unpacklo_epi8 (ra, zero), _mm_unpacklo_epi8 (rb, zero));
+			hi = _mm_add_epi16 (_mm_unpackhi_epi8 (ra, zero), _mm_unpackhi_epi8 (rb, zero));
+			lo = _mm_add_epi16 (lo, _mm_srli_si128 (lo, 8));
+			hi = _mm_add_epi16 (hi, _mm_srli_si128 (hi, 8));
+			lo = _mm_srli_epi16 (_mm_add_epi16 (_mm_unpacklo_epi64 (lo, hi), two), 2);
+			_mm_storel_epi64 ((__m128i *) out, _mm_packus_epi16 (lo, lo));
+		}
+	}
+#endif
+
+	for (; x < wo; x++, out += bytes) {
+		x1 = (((x * 2) + 1) < wi) ? ((x * 2) + 1) : (x * 2);
+		p[0] = (a + ((x * 2) * bytes));
+		p[1] = (a + (x1 * bytes));
+		p[2] = (b + ((x * 2) * bytes));
+		p[3] = (b + (x1 * bytes));
+
+		if ((mode & MIP_NORMAL) && (bytes == 4)) {
+			mip_normal (out, p);
+			continue;
+		}
+
+		for (n = 0; n < 4; n++) {
+			w[n] = ((mode & MIP_ALPHA) && (bytes == 4)) ? p[n][3] : 1.0f;
+		}
+
+		for (c = 0; c < bytes; c++) {
+			if ((c == 3) || (! (mode & (MIP_SRGB | MIP_ALPHA)))) {
+				// alpha, and plain colors, are a plain average
+				out[c] = (unsigned char) ((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+				continue;
+			}
+
+			sum = plain = 0.0f;
+			weight = (w[0] + w[1] + w[2] + w[3]);
+
+			for (n = 0; n < 4; n++) {
+				v = ((mode & MIP_SRGB) ? mip_to_linear[p[n][c]] : p[n][c]);
+				sum += (w[n] * v);
+				plain += v;
+			}
+
+			out[c] = mip_channel (sum, weight, plain, mode);
+		}
+	}
+}
+
+// makes levels 1 to levels - 1 of the width x height pixels at in, one
+// after the other at out (mip_chain_size () bytes), in mbm row order.
+// each row of a level is made as soon as the level above has its two rows.
+void mip_chain (unsigned char *out, const unsigned char *in, uint32_t width, uint32_t height,
+	uint32_t bytes, uint32_t levels, uint32_t mode)
+{
+	const unsigned char *above;
+	size_t ofs[MIP_LEVELS];
+	uint32_t w[MIP_LEVELS], h[MIP_LEVELS], next[MIP_LEVELS];
+	size_t bpl[MIP_LEVELS];
+	uint32_t n, last, y;
+
+	if ((mode & MIP_SRGB) && (! mip_tables)) {
+		mip_srgb_tables ();
+	}
+
+	levels = (levels > MIP_LEVELS) ? MIP_LEVELS : levels;
+	ofs[0] = ofs[1] = 0;
+	w[0] = width;
+	h[0] = height;
+
+	for (n = 1; n < levels; n++) {
+		w[n] = w[n - 1];
+		h[n] = h[n - 1];
+		mip_next (&w[n], &h[n]);
+		ofs[n] = ((n == 1) ? 0 : (ofs[n - 1] + ((size_t) w[n - 1] * h[n - 1] * bytes)));
+		next[n] = 0;
+	}
+
+	for (n = 0; n < levels; n++) {
+		bpl[n] = ((size_t) w[n] * bytes);
+	}
+
+	while ((levels > 1) && (next[1] < h[1])) {
+		// a row of level 1, then whatever rows it lets the levels below make
+		for (n = 1; n < levels; n++) {
+			y = next[n];
+
+			if (y >= h[n]) {
+				break;
+			}
+
+			last = (((y * 2) + 1) < h[n - 1]) ? ((y * 2) + 1) : (y * 2);
+
+			if ((n > 1) && (last >= next[n - 1])) {
+				break;
+			}
+
+			above = ((n == 1) ? in : (out + ofs[n - 1]));
+			mip_row ((out + ofs[n] + (y * bpl[n])), (above + ((y * 2) * bpl[n - 1])),
+				(above + (last * bpl[n - 1])), w[n - 1], w[n], bytes, mode);
+			next[n]++;
+		}
+	}
+}
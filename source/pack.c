@@ -0,0 +1,291 @@
+/*
+ * pack.c - the texture pack: many MBM files in one, with an index sorted
+ * for lookups straight from a mapping of the file. Made by mbmpack, and
+ * read by any program that includes this file.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// the layout, all little endian:
+//
+//   the header (pack_head, 32 bytes)
+//   count index entries (pack_entry, 40 bytes each), by hash, then name
+//   the names, one after the other, without a 0 at the end
+//   the mbm files, each placed so that its pixels (past the 20 byte mbm
+//   header) start on a PACK_PAGE boundary
+//
+// a program maps the pack once and finds a texture with a binary search
+// of the index. its mbm file, or its pixels alone, are then used right
+// from the mapping, without being copied.
+//
+// usage:
+//
+//   pack_file pack;
+//   const pack_entry *entry;
+//
+//   if (pack_open (&pack, "textures.pak") == 0) {
+//       entry = pack_find (&pack, "Squad/Parts/Engine/model000");
+//       if (entry) upload (pack_pixels (&pack, entry), entry->width, ...);
+//       pack_close (&pack);
+//   }
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define PACK_MAGIC 0x50534B50 // "PKSP"
+#define PACK_VERSION 1
+#define PACK_PAGE 4096
+#define PACK_MBM 20 // the mbm header in front of the pixels
+
+typedef struct pack_head {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count; // of textures
+	uint32_t page; // the pixels are aligned to
+	uint32_t names; // where the names start
+	uint32_t names_size;
+	uint64_t size; // of the whole pack
+} pack_head;
+
+typedef struct pack_entry {
+	uint64_t hash; // of the name, pack_hash ()
+	uint64_t offset; // of the mbm file, its pixels at offset + PACK_MBM
+	uint32_t width;
+	uint32_t height;
+	uint32_t type; // as in the mbm header
+	uint32_t bits;
+	uint32_t name; // from the start of the names
+	uint32_t name_len;
+} pack_entry;
+
+typedef struct pack_file {
+	unsigned char *map; // the whole pack
+	size_t size;
+	uint32_t count;
+	const pack_entry *index;
+	const char *names;
+	int mapped;
+} pack_file;
+
+// fnv-1a, 64 bit
+uint64_t pack_hash (const char *name, size_t len)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	size_t n;
+
+	for (n = 0; n < len; n++) {
+		hash ^= (unsigned char) name[n];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+// the bytes of the pixels of an entry
+uint64_t pack_pixel_size (const pack_entry *entry)
+{
+	return ((uint64_t) entry->width * entry->height * (entry->bits / 8));
+}
+
+// checks the header and every entry of a pack read or mapped whole
+int pack_check (pack_file *pack)
+{
+	const pack_head *head = (const pack_head *) pack->map;
+	const pack_entry *entry;
+	uint32_t n;
+
+	if ((pack->size < sizeof (pack_head)) || (head->magic != PACK_MAGIC)) {
+		return 6;
+	}
+
+	if ((head->version != PACK_VERSION) || (head->size != pack->size)
+		|| (head->count > ((pack->size - sizeof (pack_head)) / sizeof (pack_entry)))
+		|| (head->names < (sizeof (pack_head) + ((uint64_t) head->count * sizeof (pack_entry))))
+		|| (((uint64_t) head->names + head->names_size) > pack->size)) {
+		return 6;
+	}
+
+	pack->count = head->count;
+	pack->index = (const pack_entry *) (pack->map + sizeof (pack_head));
+	pack->names = (const char *) (pack->map + head->names);
+
+	for (n = 0; n < pack->count; n++) {
+		entry = &pack->index[n];
+
+		if ((((uint64_t) entry->name + entry->name_len) > head->names_size)
+			|| ((entry->bits != 24) && (entry->bits != 32))
+			|| (entry->offset > pack->size)
+			|| ((pack->size - entry->offset) < (PACK_MBM + pack_pixel_size (entry)))) {
+			return 6;
+		}
+	}
+
+	return 0;
+}
+
+void pack_close (pack_file *pack)
+{
+	if (pack->map) {
+#ifndef _WIN32
+		if (pack->mapped) {
+			munmap (pack->map, pack->size);
+
+		} else {
+			free (pack->map);
+		}
+#else
+		free (pack->map);
+#endif
+	}
+
+	memset (pack, 0, sizeof (pack_file));
+}
+
+// maps a pack (reads it, other than on posix). returns 0, or the error
+// numbers of the converters: 1 malloc, 2 open for read, 4 read, 6 header
+int pack_open (pack_file *pack, const char *name)
+{
+	int erc;
+#ifndef _WIN32
+	struct stat st;
+	int fd;
+
+	memset (pack, 0, sizeof (pack_file));
+	fd = open (name, O_RDONLY);
+
+	if (fd < 0) {
+		return 2;
+	}
+
+	if ((fstat (fd, &st) != 0) || (st.st_size < (off_t) sizeof (pack_head))) {
+		close (fd);
+		return 4;
+	}
+
+	pack->size = (size_t) st.st_size;
+	pack->map = (unsigned char *) mmap (NULL, pack->size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd); // the mapping stays
+
+	if (pack->map == MAP_FAILED) {
+		pack->map = NULL;
+		return 4;
+	}
+
+	pack->mapped = 1;
+#else
+	FILE *fp;
+	long size;
+
+	memset (pack, 0, sizeof (pack_file));
+	fp = fopen (name, "rb");
+
+	if (! fp) {
+		return 2;
+	}
+
+	fseek (fp, 0, SEEK_END);
+	size = ftell (fp);
+	fseek (fp, 0, SEEK_SET);
+
+	if (size < (long) sizeof (pack_head)) {
+		fclose (fp);
+		return 4;
+	}
+
+	pack->size = (size_t) size;
+	pack->map = (unsigned char *) malloc (pack->size);
+
+	if (! pack->map) {
+		fclose (fp);
+		return 1;
+	}
+
+	if (fread (pack->map, 1, pack->size, fp) != pack->size) {
+		fclose (fp);
+		pack_close (pack);
+		return 4;
+	}
+
+	fclose (fp);
+#endif
+
+	erc = pack_check (pack);
+
+	if (erc) {
+		pack_close (pack);
+	}
+
+	return erc;
+}
+
+// orders entries by hash, then name
+int pack_compare (const pack_file *pack, const pack_entry *entry, uint64_t hash, const char *name, size_t len)
+{
+	int cmp;
+
+	if (entry->hash != hash) {
+		return (entry->hash < hash) ? -1 : 1;
+	}
+
+	cmp = memcmp (pack->names + entry->name, name, (entry->name_len < len) ? entry->name_len : len);
+	return cmp ? cmp : ((entry->name_len < len) ? -1 : (entry->name_len > len));
+}
+
+// the entry of a texture, NULL if the pack doesn't have it
+const pack_entry *pack_find (const pack_file *pack, const char *name)
+{
+	size_t len = strlen (name);
+	uint64_t hash = pack_hash (name, len);
+	uint32_t lo = 0;
+	uint32_t hi = pack->count;
+	uint32_t mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = (lo + ((hi - lo) / 2));
+		cmp = pack_compare (pack, &pack->index[mid], hash, name, len);
+
+		if (cmp == 0) {
+			return &pack->index[mid];
+		}
+
+		if (cmp < 0) {
+			lo = (mid + 1);
+
+		} else {
+			hi = mid;
+		}
+	}
+
+	return NULL;
+}
+
+// the mbm file of an entry, header and pixels, in the pack
+const unsigned char *pack_mbm (const pack_file *pack, const pack_entry *entry)
+{
+	return (pack->map + entry->offset);
+}
+
+// the pixels of an entry, in mbm order, page aligned in the pack
+const unsigned char *pack_pixels (const pack_file *pack, const pack_entry *entry)
+{
+	return (pack->map + entry->offset + PACK_MBM);
+}
@@ -2,7 +2,7 @@
  * png2mbm.c - converts png images to Kerbal Space Program textures
  *
  * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
- * Last update 28 november 2014
+ * Last update 19 october 2026
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -30,8 +30,9 @@
 
 #define LODEPNG_NO_COMPILE_ENCODER
 #define LODEPNG_NO_COMPILE_DISK
-#define LODEPNG_NO_COMPILE_ANCILLARY_CHUNKS
 #define LODEPNG_NO_COMPILE_ERROR_TEXT
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
 
 /*
  * lodepng image library
@@ -55,13 +56,23 @@
 #define png_bitdepth 0x18
 #define png_compression 0x19
 
+// png text chunk written by mbm2png with the original mbm bit depth
+#define BITS_KEY "MBM bits"
+
 #define bufsz 8192
 
-FILE *fp = NULL;
+#include "check_type.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
 
 char *filename = NULL;
 char *infile = NULL;
 char *outfile = NULL;
+char *argfile = NULL;
 char *buf = NULL;
 
 unsigned char *buffer = NULL;
@@ -75,13 +86,10 @@ uint32_t width;
 uint32_t height;
 uint32_t type;
 uint32_t bits;
+uint32_t sample = 0;
 uint32_t bytes;
 uint32_t bpl;
 uint32_t n;
-uint32_t x;
-uint32_t y;
-uint32_t src;
-uint32_t dst;
 uint32_t erc;
 
 size_t pngsize;
@@ -100,10 +108,9 @@ int cleanup (int rc)
 		"header check",
 		"image type",
 		"image convert",
+		"image decode",
 	};
 
-	if (fp != NULL) { fclose (fp); fp = NULL; }
-
 	if (filename != NULL) { free (filename); filename = NULL; }
 
 	if (infile != NULL) { free (infile); infile = NULL; }
@@ -112,9 +119,9 @@ int cleanup (int rc)
 
 	if (buf != NULL) { free (buf); buf = NULL; }
 
-	if (buffer != NULL) { free (buffer); buffer = NULL; }
+	if (buffer != NULL) { lodepng_free (buffer); buffer = NULL; }
 
-	if (image != NULL) { free (image); image = NULL; }
+	if (image != NULL) { aio_discard (); image = NULL; }
 
 	if (rc) {
 		fprintf (stderr, "\n%s failed\n", errmsg[rc]);
@@ -128,28 +135,6 @@ int cleanup (int rc)
 	return rc;
 }
 
-uint32_t check_type (const unsigned char *buf, uint32_t bytes)
-{
-	uint32_t r, b, x, count, delta = 0;
-
-	for (x = 0; x < bytes; x += 4) {
-
-		r = * (buf + x + 0);
-		b = * (buf + x + 2);
-
-		if (r != b) {
-			count++;
-			delta += (r < b) ? (b - r) : (r - b);
-		}
-	}
-
-	if (count) {
-		delta /= count;
-	}
-
-	return (delta < 8) ? 1 : 0;
-}
-
 uint32_t big_endian (const unsigned char *buf, uint32_t cnt)
 {
 	uint32_t n;
@@ -203,6 +188,24 @@ char *bname (char *str)
 
 int main (int argc, char *argv[])
 {
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--sample", 8) == 0) {
+			// decide the normal map type from a percentage of the rows
+			sample = (argv[arg][8] == '=') ? atoi (argv[arg] + 9) : SAMPLE_PERCENT;
+			sample = (sample > 100) ? 100 : sample;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]))) {
+			argfile = argv[arg];
+		}
+	}
+
+	cache_open ("png2mbm", sample);
+	walk_start (".png");
+	aio_start ();
+
 	while (1) {
 		infile = (char *) malloc (bufsz * sizeof (char));
 		outfile = (char *) malloc (bufsz * sizeof (char));
@@ -214,8 +217,17 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		if (argc == 2) {
-			sprintf (filename, "%s", argv[1]);
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename -> %s", filename);
+			fflush (stdout);
 
 		} else {
 			fprintf (stdout, "Filename ");
@@ -234,30 +246,29 @@ int main (int argc, char *argv[])
 
 		sprintf (infile, "%s", filename);
 		sprintf (outfile, "%s.mbm", bname (filename));
-		fp = fopen (infile, "rb");
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_read (infile, &buffer, &io_size);
+		pngsize = io_size;
 
-		if (!fp) {
-			cleanup (2);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fseek (fp, 0, SEEK_END);
-		pngsize = (ftell (fp) + 1);
-		fseek (fp, 0, SEEK_SET);
-		pngsize--;
-		buffer = (unsigned char *) malloc (pngsize * sizeof (unsigned char));
+		lodepng_stats_add (&stats, LSP_READ, stats_start, pngsize);
 
-		if (! buffer) {
-			cleanup (1);
-			continue;
-		}
+		if (cache_fetch (buffer, pngsize, outfile)) {
+			trace_file_end (0, 0, pngsize, cache_size);
+			stats_file (infile);
+			cleanup (0);
 
-		io_size = fread (buffer, sizeof (char), pngsize, fp);
-		fclose (fp);
-		fp = NULL;
+			if (argfile) {
+				break;
+			}
 
-		if (io_size != pngsize) {
-			cleanup (4);
 			continue;
 		}
 
@@ -268,29 +279,47 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		width = (uint32_t) big_endian ((buffer + png_width), sizeof (uint32_t));
-		height = (uint32_t) big_endian ((buffer + png_height), sizeof (uint32_t));
-		type = (uint8_t) big_endian ((buffer + png_compression), sizeof (uint8_t));
+		lodepng_state_init (&state);
+		state.stats = &stats;
+		erc = lodepng_inspect_chunks (&width, &height, &state, buffer, pngsize);
 
-		if (! (type == LCT_RGB || type == LCT_RGBA)) {
-			cleanup (8);
+		if (erc) {
+			lodepng_state_cleanup (&state);
+			cleanup (9);
 			continue;
 		}
 
-		if (type == LCT_RGB) {
-			bits = 24;
+		// any png type is accepted. the mbm gets an alpha channel if the png
+		// can have one, or if mbm2png noted that the original mbm had one.
+		bits = lodepng_can_have_alpha (&state.info_png.color) ? 32 : 24;
 
-		} else if (type == LCT_RGBA) {
-			bits = 32;
+		for (n = 0; n < state.info_png.text_num; n++) {
+			if (strcmp (state.info_png.text_keys[n], BITS_KEY) == 0) {
+				if (atoi (state.info_png.text_strings[n]) == 32) {
+					bits = 32;
+				}
+			}
 		}
 
 		bytes = (bits / 8);
 		bpl = width * bytes;
 		imgsize = (width * height * bytes);
-		lodepng_state_init (&state);
-		state.info_raw.colortype = type;
-		state.info_png.color.colortype = type;
-		erc = lodepng_decode (&image, &width, &height, &state, buffer, pngsize);
+		state.info_raw.colortype = (bytes == 4) ? LCT_RGBA : LCT_RGB;
+		state.info_raw.bitdepth = 8;
+
+		// the header and the pixels, made in place in the mapped output file
+		image = aio_create (outfile, (imgsize + image_ofs));
+
+		if (! image) {
+			lodepng_state_cleanup (&state);
+			cleanup (3);
+			continue;
+		}
+
+		// mbm rows are bottom-up: the top row of the png goes last, the
+		// decoder writes each row straight into its place
+		erc = lodepng_decode_into ((image + image_ofs + (bpl * (height - 1))), -((long) bpl),
+			width, height, &state, buffer, pngsize);
 		lodepng_state_cleanup (&state);
 
 		if (erc) {
@@ -298,69 +327,48 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		free (buffer);
+		lodepng_free (buffer);
 		buffer = NULL;
 
 		if (bytes == 4) {
-			type = check_type (image, imgsize);
+			stats_start = lodepng_stats_clock (&stats);
+			type = check_type ((image + image_ofs), width, height, sample);
+			lodepng_stats_add (&stats, LSP_CHECK_TYPE, stats_start, imgsize);
 
 		} else {
 			type = 0;
 		}
 
-		buffer = (unsigned char *) malloc (imgsize * sizeof (unsigned char));
-
-		if (! buffer) {
-			fclose (fp);
-			fp = NULL;
-			cleanup (1);
-			continue;
-		}
-
-		for (y = 0; y < height; y++) {
-			for (x = 0; x < width; x++) {
-				src = (bytes * x) + (bpl * (height-y-1));
-				dst = (bytes * width * y) + (bytes * x);
-
-				for (n = 0; n < bytes; n++) {
-					buffer[dst + n] = image[src + n];
-				}
-			}
-		}
-
-		free (image);
-		image = NULL;
-		fp = fopen (outfile, "wb");
-
-		if (!fp) {
-			cleanup (3);
-			continue;
-		}
-
+		stats_start = lodepng_stats_clock (&stats);
 		magic = MAGIC;
-		fwrite (&magic, sizeof (uint32_t), 1, fp);
-		fwrite (&width, sizeof (uint32_t), 1, fp);
-		fwrite (&height, sizeof (uint32_t), 1, fp);
-		fwrite (&type, sizeof (uint32_t), 1, fp);
-		fwrite (&bits, sizeof (uint32_t), 1, fp);
-		io_size = fwrite (buffer, sizeof (char), imgsize, fp);
-		free (buffer);
-		buffer = NULL;
+		* ((uint32_t *) (image + magic_ofs)) = magic;
+		* ((uint32_t *) (image + width_ofs)) = width;
+		* ((uint32_t *) (image + height_ofs)) = height;
+		* ((uint32_t *) (image + type_ofs)) = type;
+		* ((uint32_t *) (image + bits_ofs)) = bits;
+		erc = aio_commit ();
+		image = NULL;
 
-		if (io_size != imgsize) {
-			cleanup (5);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		fclose (fp);
-		fp = NULL;
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, (imgsize + image_ofs));
+		cache_store (outfile);
+		trace_file_end (width, height, pngsize, (imgsize + image_ofs));
+		stats_file (infile);
 
 		cleanup (0);
 
-		if (argc == 2) {
+		if (argfile) {
 			break;
 		}
 	}
 
+	aio_finish ();
+	cache_close ();
+	stats_print ("png2mbm");
+	trace_write ("png2mbm");
 	return cleanup (0);
 }
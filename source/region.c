@@ -0,0 +1,198 @@
+/*
+ * region.c - the --crop option: reads one rectangle of an MBM file, and
+ * only the rows it needs, as if it were a small MBM of its own. Shared by
+ * mbm2png and mbm2tga, needs aio.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// the pixels of an mbm come right after its 20 byte header, a row after
+// the other, bottom row first, so the part of each row in the rectangle
+// is read on its own (pread) and nothing else of the file is. x and y
+// are counted from the top left corner, as the png or tga shows it. a
+// rectangle past the edge of the texture is cut to it.
+//
+// the rectangle read has an mbm header of its own, so the utilities (and
+// the cache) treat it as the whole file. its output is named after it,
+// name_XxY_WxH.png, so it never replaces the output of the whole texture.
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#define REGION_MBM 20 // the mbm header
+
+uint32_t region_crop = 0;
+uint32_t region_x;
+uint32_t region_y;
+uint32_t region_width;
+uint32_t region_height;
+
+// returns 1 (and may use the next argument) for --crop x,y,w,h or
+// --crop=x,y,w,h
+int region_option (int argc, char *argv[], int *arg)
+{
+	const char *opt = argv[*arg];
+
+	if ((strcmp (opt, "--crop") == 0) && ((*arg + 1) < argc)) {
+		opt = argv[++*arg];
+
+	} else if (strncmp (opt, "--crop=", 7) == 0) {
+		opt += 7;
+
+	} else {
+		return 0;
+	}
+
+	if ((sscanf (opt, "%u,%u,%u,%u", &region_x, &region_y, &region_width, &region_height) != 4)
+		|| (! region_width) || (! region_height)) {
+		fprintf (stderr, "--crop: x,y,width,height expected, not %s\n", opt);
+		exit (1);
+	}
+
+	region_crop = 1;
+	return 1;
+}
+
+// the output name for base (the input without its extension) and ext
+void region_name (char *outfile, int limit, const char *base, const char *ext)
+{
+	if (region_crop) {
+		snprintf (outfile, limit, "%s_%ux%u_%ux%u%s", base, region_x, region_y, region_width, region_height, ext);
+
+	} else {
+		snprintf (outfile, limit, "%s%s", base, ext);
+	}
+}
+
+// a crop reads files its own way, so they aren't read ahead by --aio
+void region_start (void)
+{
+	if (region_crop) {
+		aio_want = AIO_OFF;
+	}
+}
+
+#ifndef _WIN32
+
+int region_get (int fd, unsigned char *buf, size_t size, uint64_t offset)
+{
+	ssize_t got;
+
+	while (size) {
+		got = pread (fd, buf, size, (off_t) offset);
+
+		if (got <= 0) {
+			return 4;
+		}
+
+		buf += got;
+		size -= got;
+		offset += got;
+	}
+
+	return 0;
+}
+
+#else
+
+int region_get (int fd, unsigned char *buf, size_t size, uint64_t offset)
+{
+	if (_lseeki64 (fd, (__int64) offset, SEEK_SET) < 0) {
+		return 4;
+	}
+
+	return (_read (fd, buf, (unsigned int) size) == (int) size) ? 0 : 4;
+}
+
+#endif
+
+// gives the rectangle of --crop of an mbm file as an mbm, in a buffer to
+// free with lodepng_free (). returns 0, the error numbers of aio_read (),
+// 6 if it is not an mbm, 7 if its pixels aren't 24 or 32 bit, or 9 if
+// the rectangle is outside of the texture.
+int region_read (const char *name, unsigned char **buf, uint32_t *size)
+{
+	unsigned char head[REGION_MBM];
+	unsigned char *out;
+	uint32_t width, height, bytes, w, h, row, j;
+	int erc = 0;
+	int fd;
+
+	memset (head, 0, REGION_MBM);
+#ifndef _WIN32
+	fd = open (name, O_RDONLY | O_CLOEXEC);
+#else
+	fd = _open (name, _O_RDONLY | _O_BINARY);
+#endif
+
+	if (fd < 0) {
+		return 2;
+	}
+
+	erc = region_get (fd, head, REGION_MBM, 0);
+	width = * ((uint32_t *) (head + 4));
+	height = * ((uint32_t *) (head + 8));
+	bytes = (* ((uint32_t *) (head + 16)) / 8);
+
+	if (! erc) {
+		erc = (* ((uint32_t *) head) != MAGIC) ? 6 : (((bytes != 3) && (bytes != 4)) ? 7 : 0);
+	}
+
+	if ((! erc) && ((region_x >= width) || (region_y >= height))) {
+		erc = 9;
+	}
+
+	w = (region_width < (width - region_x)) ? region_width : (width - region_x);
+	h = (region_height < (height - region_y)) ? region_height : (height - region_y);
+	out = erc ? NULL : (unsigned char *) lodepng_malloc (REGION_MBM + ((size_t) w * h * bytes));
+
+	if ((! erc) && (! out)) {
+		erc = 1;
+	}
+
+	if (! erc) {
+		memcpy (out, head, REGION_MBM);
+		memcpy (out + 4, &w, 4);
+		memcpy (out + 8, &h, 4);
+
+		// out row j (from the bottom) is file row (height - y - h) + j
+		for (j = 0; (! erc) && (j < h); j++) {
+			row = ((height - region_y - h) + j);
+			erc = region_get (fd, (out + REGION_MBM + ((size_t) j * w * bytes)), ((size_t) w * bytes),
+				(REGION_MBM + ((((uint64_t) row * width) + region_x) * bytes)));
+		}
+
+		if (erc) {
+			lodepng_free (out);
+		}
+	}
+
+#ifndef _WIN32
+	close (fd);
+#else
+	_close (fd);
+#endif
+
+	if (! erc) {
+		*buf = out;
+		*size = (uint32_t) (REGION_MBM + ((size_t) w * h * bytes));
+	}
+
+	return erc;
+}
@@ -0,0 +1,264 @@
+/*
+ * stats.c - the --stats option: time spent and bytes produced by each
+ * phase of a conversion, summed over all files of a run, and the memory
+ * each file needed. Shared by the converters, the totals are kept in a
+ * LodePNGStats from lodepng, the memory is counted by alloc.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// --stats prints a table, --stats=json prints json. both go to stderr
+// so they don't mix with the filename prompts on stdout.
+#define STATS_TABLE 1
+#define STATS_JSON 2
+
+// the clock is only set by --stats or --trace, so without them every
+// lodepng_stats_add () returns right away
+LodePNGStats stats;
+
+uint32_t stats_mode = 0;
+uint32_t stats_files = 0;
+double stats_begin; // start of the run
+double stats_start; // start of the phase being timed
+
+// the memory counts of every file converted, for the report
+typedef struct stats_record {
+	char *name;
+	mem_stats mem;
+} stats_record;
+
+stats_record *stats_records = NULL;
+uint32_t stats_records_size = 0;
+
+// monotonic time in seconds
+double stats_clock (void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter (&count);
+	QueryPerformanceFrequency (&freq);
+	return ((double) count.QuadPart / (double) freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ((double) ts.tv_sec + ((double) ts.tv_nsec / 1e9));
+#endif
+}
+
+// returns 1 if arg is --stats or --stats=json
+int stats_option (const char *arg)
+{
+	if (strncmp (arg, "--stats", 7) != 0) {
+		return 0;
+	}
+
+	stats_mode = (strcmp (arg + 7, "=json") == 0) ? STATS_JSON : STATS_TABLE;
+
+	if (! stats.clock) { // --trace may have set it up already
+		lodepng_stats_init (&stats, stats_clock);
+		stats_begin = stats_clock ();
+	}
+
+	return 1;
+}
+
+// writes a json string, escaping what json needs escaped
+void json_string (FILE *fp, const char *str)
+{
+	fputc ('"', fp);
+
+	for (; *str; str++) {
+		if ((*str == '"') || (*str == '\\')) {
+			fprintf (fp, "\\%c", *str);
+
+		} else if ((unsigned char) *str < 0x20) {
+			fprintf (fp, "\\u%04x", (unsigned char) *str);
+
+		} else {
+			fputc (*str, fp);
+		}
+	}
+
+	fputc ('"', fp);
+}
+
+// counts a converted file and keeps its memory counts. the records are
+// grown with plain realloc, so they don't count themselves.
+void stats_file (const char *name)
+{
+	stats_record *records;
+
+	stats_files++;
+
+	if (! stats_mode) {
+		return;
+	}
+
+	if (stats_files > stats_records_size) {
+		records = (stats_record *) realloc (stats_records, (stats_records_size + 64) * sizeof (stats_record));
+
+		if (! records) {
+			return;
+		}
+
+		stats_records = records;
+		stats_records_size += 64;
+	}
+
+	stats_records[stats_files - 1].name = strdup (name);
+	stats_records[stats_files - 1].mem = mem;
+}
+
+// sums the records: largest peak, all allocations, all growth
+void stats_memory (mem_stats *total)
+{
+	uint32_t n;
+	int site;
+
+	memset (total, 0, sizeof (mem_stats));
+
+	for (n = 0; (n < stats_files) && (n < stats_records_size); n++) {
+		total->peak = (stats_records[n].mem.peak > total->peak) ? stats_records[n].mem.peak : total->peak;
+		total->allocs += stats_records[n].mem.allocs;
+
+		for (site = 0; site < LAS_NUM_SITES; site++) {
+			total->grows[site] += stats_records[n].mem.grows[site];
+			total->grow_bytes[site] += stats_records[n].mem.grow_bytes[site];
+		}
+	}
+}
+
+// sum of the reallocs that grew a block, over all sites
+uint64_t stats_grows (const mem_stats *m)
+{
+	uint64_t grows = 0;
+	int site;
+
+	for (site = 0; site < LAS_NUM_SITES; site++) {
+		grows += m->grows[site];
+	}
+
+	return grows;
+}
+
+void stats_print (const char *tool)
+{
+	double total = stats_clock () - stats_begin;
+	double mb;
+	int phase;
+	int first = 1;
+	mem_stats memory;
+	uint32_t n, records;
+	int site;
+
+	if (! stats_mode) {
+		return;
+	}
+
+	stats_memory (&memory);
+	records = (stats_files < stats_records_size) ? stats_files : stats_records_size;
+
+	if (stats_mode == STATS_JSON) {
+		fprintf (stderr, "{\"tool\": \"%s\", \"files\": %u, \"seconds\": %.6f, \"phases\": {",
+			tool, stats_files, total);
+
+		for (phase = 0; phase < LSP_NUM_PHASES; phase++) {
+			if (! stats.count[phase]) {
+				continue;
+			}
+
+			fprintf (stderr, "%s\n  \"%s\": {\"count\": %u, \"seconds\": %.6f, \"bytes\": %lu}",
+				first ? "" : ",", lodepng_stats_phase_name (phase), stats.count[phase],
+				stats.time[phase], (unsigned long) stats.bytes[phase]);
+			first = 0;
+		}
+
+		fprintf (stderr, "\n}, \"memory\": {\"peak_bytes\": %" PRId64 ", \"allocs\": %" PRIu64 ", \"growth\": {",
+			memory.peak, memory.allocs);
+
+		for (site = 0; site < LAS_NUM_SITES; site++) {
+			fprintf (stderr, "%s\"%s\": {\"count\": %" PRIu64 ", \"bytes\": %" PRIu64 "}",
+				site ? ", " : "", mem_site_name[site], memory.grows[site], memory.grow_bytes[site]);
+		}
+
+		fprintf (stderr, "}, \"files\": [");
+
+		for (n = 0; n < records; n++) {
+			fprintf (stderr, "%s\n  {\"file\": ", n ? "," : "");
+			json_string (stderr, stats_records[n].name ? stats_records[n].name : "");
+			fprintf (stderr, ", \"peak_bytes\": %" PRId64 ", \"allocs\": %" PRIu64 ", \"grows\": %" PRIu64 "}",
+				stats_records[n].mem.peak, stats_records[n].mem.allocs, stats_grows (&stats_records[n].mem));
+		}
+
+		fprintf (stderr, "\n]}}\n");
+
+	} else {
+		fprintf (stderr, "\n%s: %u files in %.3f s\n", tool, stats_files, total);
+		fprintf (stderr, "%-12s %8s %12s %8s %12s %10s\n",
+			"phase", "count", "ms", "share", "MB", "MB/s");
+
+		for (phase = 0; phase < LSP_NUM_PHASES; phase++) {
+			if (! stats.count[phase]) {
+				continue;
+			}
+
+			mb = (double) stats.bytes[phase] / 1e6;
+			fprintf (stderr, "%-12s %8u %12.3f %7.1f%% %12.3f %10.1f\n",
+				lodepng_stats_phase_name (phase), stats.count[phase],
+				stats.time[phase] * 1e3,
+				(total > 0) ? (100 * stats.time[phase] / total) : 0.0, mb,
+				(stats.time[phase] > 0) ? (mb / stats.time[phase]) : 0.0);
+		}
+
+		fprintf (stderr, "\n%-32s %12s %10s %8s\n", "file", "peak MB", "allocs", "grows");
+
+		for (n = 0; n < records; n++) {
+			fprintf (stderr, "%-32s %12.3f %10" PRIu64 " %8" PRIu64 "\n",
+				stats_records[n].name ? stats_records[n].name : "",
+				(double) stats_records[n].mem.peak / 1e6, stats_records[n].mem.allocs,
+				stats_grows (&stats_records[n].mem));
+		}
+
+		fprintf (stderr, "%-32s %12.3f %10" PRIu64 " %8" PRIu64 "\n",
+			"(largest peak, total)", (double) memory.peak / 1e6, memory.allocs, stats_grows (&memory));
+		if (stats_grows (&memory)) {
+			fprintf (stderr, "\n%-12s %8s %12s\n", "growth", "count", "MB");
+		}
+
+		for (site = 0; site < LAS_NUM_SITES; site++) {
+			if (memory.grows[site]) {
+				fprintf (stderr, "%-12s %8" PRIu64 " %12.3f\n",
+					mem_site_name[site], memory.grows[site], (double) memory.grow_bytes[site] / 1e6);
+			}
+		}
+	}
+
+	for (n = 0; n < records; n++) {
+		free (stats_records[n].name);
+	}
+
+	free (stats_records);
+	stats_records = NULL;
+	stats_records_size = 0;
+	fflush (stderr);
+}
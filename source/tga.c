@@ -0,0 +1,322 @@
+/*
+ * tga.c - reads and writes the pixels of TGA files for Kerbal Space Program
+ * textures, plain or run length encoded. Shared by tga2mbm, mbm2tga and mbmd.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TGA_SSE2
+#endif
+
+// image types and ImageDescriptor bits
+#define TGA_TRUECOLOR 2
+#define TGA_TRUECOLOR_RLE 10
+#define TGA_RIGHT 0x10 // pixels stored right to left
+#define TGA_TOP 0x20 // rows stored top to bottom
+
+// an rle packet: a count byte (the top bit set for a run of one pixel
+// repeated), then the pixel, or count + 1 different pixels
+#define TGA_RUN 0x80
+#define TGA_PACKET 128 // most pixels in one packet
+#define TGA_MBM_MAX (0xFFFFFFFFULL - 0x14) // most pixel bytes an mbm (its size 32 bit) can hold
+
+typedef struct {
+	uint32_t width;
+	uint32_t height;
+	uint32_t bits;
+	uint32_t bytes;
+	uint32_t imgtype;
+	uint32_t top;
+	uint32_t right;
+	size_t pixel_ofs; // past the header, image id and color map
+	size_t bitmapsize;
+} tga_info;
+
+// parses the header of a tga read whole into buf. returns 0, 4 if the
+// file is too short for its pixels or 6 if it is not a 24 or 32 bit true
+// color tga, plain or rle, or too large for an mbm.
+int tga_header (tga_info *tga, const unsigned char *buf, size_t size)
+{
+	uint64_t pixels;
+	size_t cmap = 0;
+
+	if (size < tga_ofs) {
+		return 4;
+	}
+
+	tga->imgtype = * (uint8_t *) (buf + ImageType);
+	tga->width = * (uint16_t *) (buf + Width);
+	tga->height = * (uint16_t *) (buf + Height);
+	tga->bits = * (uint8_t *) (buf + PixelDepth);
+	tga->bytes = (tga->bits / 8);
+	tga->top = (* (uint8_t *) (buf + ImageDescriptor) & TGA_TOP) ? 1 : 0;
+	tga->right = (* (uint8_t *) (buf + ImageDescriptor) & TGA_RIGHT) ? 1 : 0;
+
+	if (((tga->bits != 24) && (tga->bits != 32))
+		|| ((tga->imgtype != TGA_TRUECOLOR) && (tga->imgtype != TGA_TRUECOLOR_RLE))) {
+		return 6;
+	}
+
+	// a true color tga may still carry a color map, it is not used. its
+	// length sits at an odd offset, so it is read a byte at a time.
+	if (* (uint8_t *) (buf + ColorMapType)) {
+		cmap = (buf[CMapLength] | (buf[CMapLength + 1] << 8));
+		cmap *= ((buf[CMapDepth] + 7) / 8);
+	}
+
+	// up to 65535 x 65535 x 4 bytes, more than an mbm (or a 32 bit size_t)
+	// takes, so the sizes are checked in 64 bits before anything is made
+	pixels = ((uint64_t) tga->width * tga->height);
+
+	if ((pixels * tga->bytes) > TGA_MBM_MAX) {
+		return 6;
+	}
+
+	tga->pixel_ofs = (tga_ofs + * (uint8_t *) (buf + IDLength) + cmap);
+	tga->bitmapsize = (size_t) (pixels * tga->bytes);
+
+	if (size < tga->pixel_ofs) {
+		return 4;
+	}
+
+	if ((tga->imgtype == TGA_TRUECOLOR) && ((size - tga->pixel_ofs) < tga->bitmapsize)) {
+		return 4;
+	}
+
+	// each rle packet (a count byte and at least one pixel) is at most
+	// TGA_PACKET pixels. the packets themselves are checked while they
+	// are expanded.
+	if ((tga->imgtype == TGA_TRUECOLOR_RLE)
+		&& ((size - tga->pixel_ofs) < (((pixels + TGA_PACKET - 1) / TGA_PACKET) * (1 + tga->bytes)))) {
+		return 4;
+	}
+
+	return 0;
+}
+
+// copies the pixels of a tga into mbm order: bottom row first, left to
+// right, red first. tga stores blue first, and its rows and pixels in
+// whichever order the origin bits say.
+void tga_to_mbm (unsigned char *out, const unsigned char *in, const tga_info *tga)
+{
+	size_t bpl = ((size_t) tga->width * tga->bytes);
+	const unsigned char *row;
+	uint32_t x, y;
+	long step;
+	long i;
+
+	step = tga->right ? -((long) tga->bytes) : (long) tga->bytes;
+
+	for (y = 0; y < tga->height; y++) {
+		row = (in + (bpl * (tga->top ? (tga->height - 1 - y) : y)));
+		i = tga->right ? (long) (bpl - tga->bytes) : 0;
+
+		for (x = 0; x < tga->width; x++, i += step, out += tga->bytes) {
+			out[0] = row[i + 2];
+			out[1] = row[i + 1];
+			out[2] = row[i + 0];
+
+			if (tga->bytes == 4) {
+				out[3] = row[i + 3];
+			}
+		}
+	}
+}
+
+// expands the packets of an rle tga (size bytes at in) into mbm order.
+// packets may go on from one row to the next. returns 0, or 4 if the
+// file ends before every pixel is there.
+int tga_rle_to_mbm (unsigned char *out, const unsigned char *in, size_t size, const tga_info *tga)
+{
+	size_t bpl = ((size_t) tga->width * tga->bytes);
+	size_t n = 0;
+	unsigned char *row = NULL;
+	uint32_t x = 0;
+	uint32_t y = 0;
+	uint32_t count;
+	uint32_t run;
+	long step;
+	long i = 0;
+
+	step = tga->right ? -((long) tga->bytes) : (long) tga->bytes;
+
+	while ((y < tga->height) && tga->width) {
+		if (x == 0) {
+			row = (out + (bpl * (tga->top ? (tga->height - 1 - y) : y)));
+			i = tga->right ? (long) (bpl - tga->bytes) : 0;
+		}
+
+		if (n >= size) {
+			return 4;
+		}
+
+		run = (in[n] & TGA_RUN);
+		count = ((in[n] & 0x7F) + 1);
+		n++;
+
+		if ((size - n) < ((run ? 1 : count) * tga->bytes)) {
+			return 4;
+		}
+
+		while (count--) {
+			row[i + 0] = in[n + 2];
+			row[i + 1] = in[n + 1];
+			row[i + 2] = in[n + 0];
+
+			if (tga->bytes == 4) {
+				row[i + 3] = in[n + 3];
+			}
+
+			if (! run) {
+				n += tga->bytes;
+			}
+
+			i += step;
+
+			if (++x == tga->width) {
+				x = 0;
+
+				if (++y == tga->height) {
+					break;
+				}
+
+				row = (out + (bpl * (tga->top ? (tga->height - 1 - y) : y)));
+				i = tga->right ? (long) (bpl - tga->bytes) : 0;
+			}
+		}
+
+		if (run) {
+			n += tga->bytes;
+		}
+	}
+
+	return 0;
+}
+
+// the most bytes the rle packets of an image can take: no runs at all,
+// one count byte per TGA_PACKET pixels, with packets ending at each row
+size_t tga_rle_bound (uint32_t width, uint32_t height, uint32_t bytes)
+{
+	return ((size_t) height * ((((size_t) width * bytes)) + ((width + TGA_PACKET - 1) / TGA_PACKET)));
+}
+
+// the first pixel j (pos <= j < end) that is (want 1) or is not (want 0)
+// equal to the pixel after it, else end. end is below the row width. four
+// neighbours are compared at once, with the equal ones picked out of the
+// byte mask.
+uint32_t tga_scan (const unsigned char *row, uint32_t pos, uint32_t end, uint32_t bytes, uint32_t bpl, uint32_t want)
+{
+	uint32_t j = pos;
+	uint32_t k;
+	uint32_t m;
+
+#ifdef TGA_SSE2
+	__m128i a, b;
+
+	for (; (j < end) && ((((j + 1) * bytes) + 16) <= bpl); j += 4) {
+		a = _mm_loadu_si128 ((const __m128i *) (row + (j * bytes)));
+		b = _mm_loadu_si128 ((const __m128i *) (row + ((j + 1) * bytes)));
+		m = _mm_movemask_epi8 (_mm_cmpeq_epi8 (a, b));
+
+		if (bytes == 4) {
+			m &= (m >> 1) & (m >> 2) & (m >> 3);
+			m = ((m & 0x01) | ((m >> 3) & 0x02) | ((m >> 6) & 0x04) | ((m >> 9) & 0x08));
+
+		} else {
+			m &= (m >> 1) & (m >> 2);
+			m = ((m & 0x01) | ((m >> 2) & 0x02) | ((m >> 4) & 0x04) | ((m >> 6) & 0x08));
+		}
+
+		m = want ? m : (~m & 0x0F);
+
+		if (m) {
+			for (k = 0; ! (m & 1); k++) {
+				m >>= 1;
+			}
+
+			return ((j + k) < end) ? (j + k) : end;
+		}
+	}
+#endif
+
+	for (; j < end; j++) {
+		if ((memcmp (row + (j * bytes), row + ((j + 1) * bytes), bytes) == 0) == (want != 0)) {
+			return j;
+		}
+	}
+
+	return end;
+}
+
+// writes the mbm pixels (bottom row first, red first) as the rle packets
+// of a bottom-left tga, one row at a time. returns the bytes written, at
+// most tga_rle_bound (). two equal pixels already make a run, which is
+// never longer than raw pixels.
+size_t tga_rle_from_mbm (unsigned char *out, const unsigned char *in, uint32_t width, uint32_t height, uint32_t bytes)
+{
+	uint32_t bpl = (width * bytes);
+	const unsigned char *row;
+	const unsigned char *px;
+	unsigned char *start = out;
+	uint32_t x, y, end, len;
+
+	for (y = 0; y < height; y++) {
+		row = (in + ((size_t) bpl * y));
+		x = 0;
+
+		while (x < width) {
+			if (((x + 1) < width) && (memcmp (row + (x * bytes), row + ((x + 1) * bytes), bytes) == 0)) {
+				// a run: up to the first pixel that differs from the next
+				end = (((width - 1) - x) < (TGA_PACKET - 1)) ? (width - 1) : (x + TGA_PACKET - 1);
+				len = ((tga_scan (row, x, end, bytes, bpl, 0) - x) + 1);
+				*out++ = (TGA_RUN | (len - 1));
+				px = (row + (x * bytes));
+				*out++ = px[2];
+				*out++ = px[1];
+				*out++ = px[0];
+
+				if (bytes == 4) {
+					*out++ = px[3];
+				}
+
+			} else {
+				// raw pixels: up to where the next run starts
+				end = (((width - 1) - x) < TGA_PACKET) ? (width - 1) : (x + TGA_PACKET);
+				len = (tga_scan (row, x, end, bytes, bpl, 1) - x);
+				len = ((end == (width - 1)) && ((x + len) == end)) ? (width - x) : len;
+				len = (len > TGA_PACKET) ? TGA_PACKET : len;
+				*out++ = (len - 1);
+
+				for (px = (row + (x * bytes)); px < (row + ((x + len) * bytes)); px += bytes) {
+					*out++ = px[2];
+					*out++ = px[1];
+					*out++ = px[0];
+
+					if (bytes == 4) {
+						*out++ = px[3];
+					}
+				}
+			}
+
+			x += len;
+		}
+	}
+
+	return (out - start);
+}
@@ -2,7 +2,7 @@
  * tga2mbm.c - converts TGA files to Kerbal Space Program textures
  *
  * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
- * Last update 28 november 2014
+ * Last update 19 october 2026
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -24,6 +24,22 @@
 #include <inttypes.h>
 #include <ctype.h>
 
+// lodepng is only needed for the LodePNGStats of --stats
+#define LODEPNG_NO_COMPILE_ZLIB
+#define LODEPNG_NO_COMPILE_PNG
+#define LODEPNG_NO_COMPILE_DECODER
+#define LODEPNG_NO_COMPILE_ENCODER
+#define LODEPNG_NO_COMPILE_DISK
+#define LODEPNG_NO_COMPILE_ALLOCATORS // alloc.c counts them for --stats
+#define LODEPNG_ALLOC_SITES
+
+/*
+ * lodepng image library
+ * Copyright (c) 2005-2014 Lode Vandevenne
+ * Website: http://lodev.org/lodepng
+ */
+#include "../lodepng/lodepng.c"
+
 #define MAGIC 0x50534B03
 
 // mbm header offsets
@@ -51,28 +67,37 @@
 
 #define bufsz 8192
 
-FILE *fp = NULL;
+#include "check_type.c"
+#include "tga.c"
+#include "alloc.c"
+#include "stats.c"
+#include "trace.c"
+#include "cache.c"
+#include "walk.c"
+#include "aio.c"
 
 char *filename = NULL;
 char *infile = NULL;
 char *outfile = NULL;
+char *argfile = NULL;
 
 unsigned char *inbuf = NULL;
-unsigned char *inptr = NULL;
 unsigned char *outbuf = NULL;
 unsigned char *outptr = NULL;
 
 uint32_t infilesize;
 uint32_t outfilesize;
-uint32_t bitmapsize;
 uint32_t io_size;
+uint32_t pixelsize;
+uint32_t erc;
 uint32_t width;
 uint32_t height;
 uint32_t type;
-uint32_t imgtype;
 uint32_t bits;
+uint32_t sample = 0;
+
+tga_info tga;
 uint32_t bytes;
-uint32_t n;
 
 int cleanup (int rc)
 {
@@ -83,20 +108,18 @@ int cleanup (int rc)
 		"open for write failed",
 		"read image failed",
 		"write image failed",
-		"compressed tga not supported",
+		"tga type not supported",
 	};
 
-	if (fp != NULL) { fclose (fp); fp = NULL; }
-
 	if (filename != NULL) { free (filename); filename = NULL; }
 
 	if (infile != NULL) { free (infile); infile = NULL; }
 
 	if (outfile != NULL) { free (outfile); outfile = NULL; }
 
-	if (inbuf != NULL) { free (inbuf); inbuf = NULL; }
+	if (inbuf != NULL) { lodepng_free (inbuf); inbuf = NULL; }
 
-	if (outbuf != NULL) { free (outbuf); outbuf = NULL; }
+	if (outbuf != NULL) { aio_discard (); outbuf = NULL; }
 
 	if (rc) {
 		fprintf (stderr, " ERROR: %s\n", errmsg[rc]);
@@ -110,28 +133,6 @@ int cleanup (int rc)
 	return rc;
 }
 
-uint32_t check_type (const unsigned char *buf, uint32_t bytes)
-{
-	uint32_t r, b, x, count, delta = 0;
-
-	for (x = 0; x < bytes; x += 4) {
-
-		r = * (buf + x + 0);
-		b = * (buf + x + 2);
-
-		if (r != b) {
-			count++;
-			delta += (r < b) ? (b - r) : (r - b);
-		}
-	}
-
-	if (count) {
-		delta /= count;
-	}
-
-	return (delta < 8) ? 1 : 0;
-}
-
 int readline (char *str, int limit, FILE *fp)
 {
 	int len;
@@ -172,6 +173,24 @@ char *bname (char *str)
 
 int main (int argc, char *argv[])
 {
+	int arg;
+
+	for (arg = 1; arg < argc; arg++) {
+		if (strncmp (argv[arg], "--sample", 8) == 0) {
+			// decide the normal map type from a percentage of the rows
+			sample = (argv[arg][8] == '=') ? atoi (argv[arg] + 9) : SAMPLE_PERCENT;
+			sample = (sample > 100) ? 100 : sample;
+
+		} else if (! (stats_option (argv[arg]) || trace_option (argv[arg]) || cache_option (argv[arg])
+			|| walk_option (argc, argv, &arg) || aio_option (argv[arg]))) {
+			argfile = argv[arg];
+		}
+	}
+
+	cache_open ("tga2mbm", sample);
+	walk_start (".tga");
+	aio_start ();
+
 	while (1) {
 
 		infile = (char *) malloc (bufsz * sizeof (char));
@@ -183,8 +202,17 @@ int main (int argc, char *argv[])
 			continue;
 		}
 
-		if (argc == 2) {
-			sprintf (filename, "%s", argv[1]);
+		if (argfile) {
+			sprintf (filename, "%s", argfile);
+
+		} else if (walk_root || aio_mode) {
+			if (! aio_next (filename, bufsz)) {
+				cleanup (0);
+				break;
+			}
+
+			fprintf (stdout, "Filename: %s", filename);
+			fflush (stdout);
 
 		} else {
 			fprintf (stdout, "Filename: ");
@@ -203,76 +231,83 @@ int main (int argc, char *argv[])
 
 		sprintf (infile, "%s", filename);
 		sprintf (outfile, "%s.mbm", bname (filename));
+		walk_mirror (outfile, bufsz);
+		trace_file_begin (infile);
+		mem_file_begin ();
 
-		fp = fopen (infile, "rb");
+		stats_start = lodepng_stats_clock (&stats);
+		erc = aio_read (infile, &inbuf, &io_size);
 
-		if (!fp) {
-			cleanup (2);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		infilesize = tga_ofs; // read header only
-
-		inbuf = (unsigned char *) malloc (infilesize * sizeof (unsigned char));
-
-		io_size = fread (inbuf, sizeof (char), infilesize, fp);
+		infilesize = io_size;
+		lodepng_stats_add (&stats, LSP_READ, stats_start, infilesize);
+		stats_start = lodepng_stats_clock (&stats);
 
-		fclose (fp);
-		fp = NULL;
+		// the header, image id and color map are taken from the same read
+		erc = tga_header (&tga, inbuf, infilesize);
 
-		if (io_size != infilesize) {
-			cleanup (4);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		imgtype = * (uint8_t *) (inbuf + ImageType);
-		width = * (uint16_t *) (inbuf + Width);
-		height = * (uint16_t *) (inbuf + Height);
-		bits = * (uint8_t *) (inbuf + PixelDepth);
-		bytes = (bits / 8);
+		width = tga.width;
+		height = tga.height;
+		bits = tga.bits;
+		bytes = tga.bytes;
+		// tga_header () refuses pixels that don't fit a 32 bit mbm
+		pixelsize = (uint32_t) tga.bitmapsize;
+		outfilesize = (pixelsize + mbm_ofs);
+		lodepng_stats_add (&stats, LSP_HEADER, stats_start, tga.pixel_ofs);
+
+		if (cache_fetch (inbuf, infilesize, outfile)) {
+			trace_file_end (0, 0, infilesize, cache_size);
+			stats_file (infile);
+			cleanup (0);
+
+			if (argfile) {
+				break;
+			}
 
-		if (((bits != 24) && (bits != 32)) || (imgtype != 2)) {
-			cleanup (6);
 			continue;
 		}
 
-		free (inbuf);
-		inbuf = NULL;
-
-		infilesize = ((width * height * bytes) + tga_ofs);
-		outfilesize = ((width * height * bytes) + mbm_ofs);
+		// the mbm is made in place, in the mapped output file
+		outbuf = aio_create (outfile, outfilesize);
 
-		inbuf = (unsigned char *) malloc (infilesize * sizeof (unsigned char));
-		outbuf = (unsigned char *) malloc (outfilesize * sizeof (unsigned char));
-
-		if (! (inbuf && outbuf)) {
-			cleanup (1);
+		if (! outbuf) {
+			cleanup (3);
 			continue;
 		}
 
-		fp = fopen (infile, "rb");
-
-		if (!fp) {
-			cleanup (2);
-			continue;
-		}
+		outptr = (outbuf + mbm_ofs);
+		stats_start = lodepng_stats_clock (&stats);
 
-		io_size = fread (inbuf, sizeof (char), infilesize, fp);
+		// top to bottom or right to left tga are put in mbm order here
+		if (tga.imgtype == TGA_TRUECOLOR_RLE) {
+			erc = tga_rle_to_mbm (outptr, (inbuf + tga.pixel_ofs), (infilesize - tga.pixel_ofs), &tga);
 
-		fclose (fp);
-		fp = NULL;
+		} else {
+			tga_to_mbm (outptr, (inbuf + tga.pixel_ofs), &tga);
+		}
 
-		if (io_size != infilesize) {
-			cleanup (4);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
-		inptr = (inbuf + tga_ofs);
-		outptr = (outbuf + mbm_ofs);
-		bitmapsize = (infilesize - tga_ofs);
+		lodepng_free (inbuf);
+		inbuf = NULL;
+		lodepng_stats_add (&stats, LSP_FLIP, stats_start, pixelsize);
 
 		if (bytes == 4) {
-			type = check_type (inptr, bitmapsize);
+			stats_start = lodepng_stats_clock (&stats);
+			type = check_type (outptr, width, height, sample);
+			lodepng_stats_add (&stats, LSP_CHECK_TYPE, stats_start, pixelsize);
 
 		} else {
 			type = 0;
@@ -283,46 +318,31 @@ int main (int argc, char *argv[])
 		* ((uint32_t *) (outbuf + height_ofs)) = height;
 		* ((uint32_t *) (outbuf + type_ofs)) = type;
 		* ((uint32_t *) (outbuf + bits_ofs)) = bits;
+		stats_start = lodepng_stats_clock (&stats);
 
-		for (n = 0; n < bitmapsize; n += bytes) {
-			outptr[n + 0] = inptr[n + 2];
-			outptr[n + 1] = inptr[n + 1];
-			outptr[n + 2] = inptr[n + 0];
-
-			if (bytes == 4) {
-				outptr[n + 3] = inptr[n + 3];
-			}
-		}
-
-		free (inbuf);
-		inbuf = NULL;
-
-		fp = fopen (outfile, "wb");
-
-		if (!fp) {
-			cleanup (3);
-			continue;
-		}
-
-		io_size = fwrite (outbuf, sizeof (char), outfilesize, fp);
-
-		fclose (fp);
-		fp = NULL;
-
-		free (outbuf);
+		erc = aio_commit ();
 		outbuf = NULL;
 
-		if (io_size != outfilesize) {
-			cleanup (5);
+		if (erc) {
+			cleanup (erc);
 			continue;
 		}
 
+		lodepng_stats_add (&stats, LSP_WRITE, stats_start, outfilesize);
+		cache_store (outfile);
+		trace_file_end (width, height, infilesize, outfilesize);
+		stats_file (infile);
+
 		cleanup (0);
 
-		if (argc == 2) {
+		if (argfile) {
 			break;
 		}
 	}
 
+	aio_finish ();
+	cache_close ();
+	stats_print ("tga2mbm");
+	trace_write ("tga2mbm");
 	return cleanup (0);
 }
@@ -0,0 +1,247 @@
+/*
+ * trace.c - the --trace=FILE option: writes the phases of every file as
+ * Chrome trace event JSON, to be opened in chrome://tracing or Perfetto
+ * (ui.perfetto.dev). Shared by the converters, needs stats.c.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// every thread writes its events into blocks of its own, so recording
+// takes no lock. a new block is pushed onto one list shared by all
+// threads with a compare and swap. the list is only read by
+// trace_write (), after the workers are done. THREAD_LOCAL comes from
+// alloc.c.
+
+#include <stdatomic.h>
+
+#define TRACE_BLOCK 1024
+
+// event kinds
+#define TRACE_PHASE 0
+#define TRACE_FILE 1
+
+typedef struct trace_event {
+	uint32_t kind;
+	uint32_t phase;
+	double start;
+	double end;
+	uint64_t bytes_in;
+	uint64_t bytes_out;
+	uint32_t width;
+	uint32_t height;
+	char *name; // file name of a TRACE_FILE event
+} trace_event;
+
+typedef struct trace_block {
+	struct trace_block *next;
+	uint32_t tid;
+	uint32_t used;
+	trace_event events[TRACE_BLOCK];
+} trace_block;
+
+char *trace_name = NULL;
+
+_Atomic (trace_block *) trace_blocks = NULL;
+atomic_uint trace_threads = 0;
+atomic_uint trace_dropped = 0;
+
+THREAD_LOCAL trace_block *trace_current = NULL;
+THREAD_LOCAL uint32_t trace_tid = 0;
+THREAD_LOCAL char *trace_file = NULL;
+THREAD_LOCAL double trace_file_start;
+
+// returns a free event of the calling thread, NULL if out of memory
+trace_event *trace_new_event (void)
+{
+	trace_block *block = trace_current;
+
+	if ((! block) || (block->used == TRACE_BLOCK)) {
+		block = (trace_block *) malloc (sizeof (trace_block));
+
+		if (! block) {
+			atomic_fetch_add (&trace_dropped, 1);
+			return NULL;
+		}
+
+		if (! trace_tid) {
+			trace_tid = atomic_fetch_add (&trace_threads, 1) + 1;
+		}
+
+		block->tid = trace_tid;
+		block->used = 0;
+		block->next = atomic_load (&trace_blocks);
+
+		while (! atomic_compare_exchange_weak (&trace_blocks, &block->next, block)) {
+			// block->next now holds the new head, try again
+		}
+
+		trace_current = block;
+	}
+
+	return &block->events[block->used++];
+}
+
+// the LodePNGStats callback, called at the end of every phase
+void trace_phase (void *user, LodePNGStatsPhase phase, double start, double end, size_t bytes)
+{
+	trace_event *ev = trace_new_event ();
+	(void) user;
+
+	if (ev) {
+		ev->kind = TRACE_PHASE;
+		ev->phase = phase;
+		ev->start = start;
+		ev->end = end;
+		ev->bytes_out = bytes;
+		ev->name = NULL;
+	}
+}
+
+// returns 1 if arg is --trace=FILE
+int trace_option (const char *arg)
+{
+	if (strncmp (arg, "--trace=", 8) != 0) {
+		return 0;
+	}
+
+	trace_name = (char *) arg + 8;
+
+	if (! stats.clock) {
+		lodepng_stats_init (&stats, stats_clock);
+		stats_begin = stats_clock ();
+	}
+
+	stats.callback = trace_phase;
+	return 1;
+}
+
+// marks the start of a file on the calling thread
+void trace_file_begin (const char *name)
+{
+	if (! trace_name) {
+		return;
+	}
+
+	free (trace_file);
+	trace_file = strdup (name);
+	trace_file_start = stats_clock ();
+}
+
+// marks the end of the file, with its size and counters
+void trace_file_end (uint32_t width, uint32_t height, uint64_t bytes_in, uint64_t bytes_out)
+{
+	trace_event *ev;
+
+	if ((! trace_name) || (! trace_file)) {
+		return;
+	}
+
+	ev = trace_new_event ();
+
+	if (! ev) {
+		free (trace_file);
+		trace_file = NULL;
+		return;
+	}
+
+	ev->kind = TRACE_FILE;
+	ev->start = trace_file_start;
+	ev->end = stats_clock ();
+	ev->width = width;
+	ev->height = height;
+	ev->bytes_in = bytes_in;
+	ev->bytes_out = bytes_out;
+	ev->name = trace_file; // the event owns it now
+	trace_file = NULL;
+}
+
+// writes all events as chrome trace json. timestamps are in
+// microseconds since the start of the run.
+void trace_write (const char *tool)
+{
+	trace_block *block, *next;
+	trace_event *ev;
+	uint32_t n, tid;
+	FILE *fp;
+
+	if (! trace_name) {
+		return;
+	}
+
+	fp = fopen (trace_name, "w");
+
+	if (! fp) {
+		fprintf (stderr, "\ncan't write trace %s\n", trace_name);
+		fflush (stderr);
+	}
+
+	if (fp) {
+		fprintf (fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+		fprintf (fp, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"%s\"}}", tool);
+
+		for (tid = 1; tid <= atomic_load (&trace_threads); tid++) {
+			fprintf (fp, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}",
+				tid, tid);
+		}
+	}
+
+	for (block = atomic_load (&trace_blocks); block; block = next) {
+		next = block->next;
+
+		for (n = 0; fp && (n < block->used); n++) {
+			ev = &block->events[n];
+			fprintf (fp, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, ",
+				block->tid, (ev->start - stats_begin) * 1e6, (ev->end - ev->start) * 1e6);
+
+			if (ev->kind == TRACE_PHASE) {
+				fprintf (fp, "\"cat\": \"phase\", \"name\": \"%s\", \"args\": {\"bytes\": %" PRIu64 "}}",
+					lodepng_stats_phase_name (ev->phase), ev->bytes_out);
+				continue;
+			}
+
+			fprintf (fp, "\"cat\": \"file\", \"name\": ");
+			json_string (fp, ev->name);
+			fprintf (fp, ", \"args\": {\"width\": %u, \"height\": %u, \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 "}}",
+				ev->width, ev->height, ev->bytes_in, ev->bytes_out);
+
+			// counters are drawn per process, at the end of each file
+			fprintf (fp, ",\n{\"ph\": \"C\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"name\": \"file\", "
+				"\"args\": {\"pixels\": %" PRIu64 ", \"bytes_in\": %" PRIu64 ", \"bytes_out\": %" PRIu64 ", \"ratio\": %.4f}}",
+				block->tid, (ev->end - stats_begin) * 1e6, (uint64_t) ev->width * ev->height,
+				ev->bytes_in, ev->bytes_out, ev->bytes_in ? ((double) ev->bytes_out / ev->bytes_in) : 0.0);
+		}
+
+		for (n = 0; n < block->used; n++) {
+			free (block->events[n].name);
+		}
+
+		free (block);
+	}
+
+	atomic_store (&trace_blocks, NULL);
+	trace_current = NULL;
+
+	if (fp) {
+		fprintf (fp, "\n]}\n");
+		fclose (fp);
+	}
+
+	if (atomic_load (&trace_dropped)) {
+		fprintf (stderr, "\ntrace: %u events dropped, out of memory\n", atomic_load (&trace_dropped));
+		fflush (stderr);
+	}
+}
@@ -0,0 +1,509 @@
+/*
+ * walk.c - the -r DIR option: finds the files to convert in DIR and all
+ * folders below it, with several threads, and hands them to the
+ * conversion loop in place of the names read from stdin. Shared by the
+ * converters.
+ *
+ * (c) 2013, 2014 roger a. krupski <rakrupski@verizon.net>
+ * Last update 19 october 2026
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// every walking thread has a queue of folders of its own. it takes the
+// newest one from it, so it stays in the subtree it is in, and puts the
+// folders it finds back into it. a thread with an empty queue takes the
+// oldest folder of another thread, which is the biggest piece of work
+// that thread has. folders are read with getdents64 on Linux (readdir
+// elsewhere) and opened with openat, relative to their parent.
+//
+// --include=GLOB and --exclude=GLOB pick the files (the default is the
+// input type of the utility, in any case). a pattern with a / is matched against the
+// path below DIR, one without against the name. an excluded folder is
+// not walked at all. --out=DIR writes the outputs into a copy of the
+// folder tree under DIR instead of next to the inputs.
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <fnmatch.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#endif
+
+#define WALK_THREADS 4 // at most, folder reading doesn't scale much further
+#define WALK_FILES 256 // files found but not yet converted
+#define WALK_FDS 256 // folders kept open in the queues, the rest by name
+#define WALK_GLOBS 16
+
+char *walk_root = NULL;
+char *walk_out = NULL;
+const char *walk_ext = NULL; // the default, without --include
+const char *walk_include[WALK_GLOBS];
+const char *walk_exclude[WALK_GLOBS];
+uint32_t walk_includes = 0;
+uint32_t walk_excludes = 0;
+
+// returns 1 (and may use the next argument) for -r DIR, --include=GLOB,
+// --exclude=GLOB and --out=DIR
+int walk_option (int argc, char *argv[], int *arg)
+{
+	const char *opt = argv[*arg];
+
+	if ((strcmp (opt, "-r") == 0) && ((*arg + 1) < argc)) {
+		walk_root = argv[++*arg];
+
+	} else if ((strncmp (opt, "--include=", 10) == 0) && (walk_includes < WALK_GLOBS)) {
+		walk_include[walk_includes++] = opt + 10;
+
+	} else if ((strncmp (opt, "--exclude=", 10) == 0) && (walk_excludes < WALK_GLOBS)) {
+		walk_exclude[walk_excludes++] = opt + 10;
+
+	} else if (strncmp (opt, "--out=", 6) == 0) {
+		walk_out = (char *) opt + 6;
+
+	} else {
+		return 0;
+	}
+
+	return 1;
+}
+
+#ifndef _WIN32
+
+// a folder waiting to be read
+typedef struct walk_dir {
+	int fd; // -1 if it has to be opened by name
+	char *path;
+} walk_dir;
+
+typedef struct walk_queue {
+	pthread_mutex_t lock;
+	walk_dir *dirs;
+	uint32_t head; // the oldest
+	uint32_t used;
+	uint32_t size;
+} walk_queue;
+
+walk_queue walk_queues[WALK_THREADS];
+uint32_t walk_threads = 0;
+uint32_t walk_pending = 0; // folders queued or being read
+uint32_t walk_fds = 0; // folders queued with an open fd
+uint32_t walk_running = 0; // threads started
+uint32_t walk_done = 0; // threads finished
+pthread_mutex_t walk_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t walk_work = PTHREAD_COND_INITIALIZER;
+
+// the files found, for walk_next ()
+char *walk_files[WALK_FILES];
+uint32_t walk_head = 0;
+uint32_t walk_used = 0;
+pthread_mutex_t walk_files_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t walk_files_ready = PTHREAD_COND_INITIALIZER;
+pthread_cond_t walk_files_space = PTHREAD_COND_INITIALIZER;
+
+// matches a path below the root (and its name) against a list of globs
+int walk_match (const char **globs, uint32_t count, const char *rel, const char *name)
+{
+	uint32_t n;
+
+	for (n = 0; n < count; n++) {
+		if (fnmatch (globs[n], strchr (globs[n], '/') ? rel : name, FNM_PATHNAME) == 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void walk_push (uint32_t thread, int fd, char *path)
+{
+	walk_queue *q = &walk_queues[thread];
+	walk_dir *dirs;
+	uint32_t n;
+
+	pthread_mutex_lock (&q->lock);
+
+	if (q->used == q->size) {
+		dirs = (walk_dir *) malloc ((q->size + 64) * sizeof (walk_dir));
+
+		if (! dirs) {
+			pthread_mutex_unlock (&q->lock);
+
+			if (fd >= 0) {
+				close (fd);
+			}
+
+			fprintf (stderr, "\n-r: out of memory, %s skipped\n", path);
+			free (path);
+			return;
+		}
+
+		for (n = 0; n < q->used; n++) {
+			dirs[n] = q->dirs[(q->head + n) % q->size];
+		}
+
+		free (q->dirs);
+		q->dirs = dirs;
+		q->head = 0;
+		q->size += 64;
+	}
+
+	q->dirs[(q->head + q->used) % q->size].fd = fd;
+	q->dirs[(q->head + q->used) % q->size].path = path;
+	q->used++;
+	pthread_mutex_unlock (&q->lock);
+
+	pthread_mutex_lock (&walk_lock);
+	walk_pending++;
+	walk_fds += (fd >= 0);
+	pthread_cond_signal (&walk_work);
+	pthread_mutex_unlock (&walk_lock);
+}
+
+// takes the newest folder of the own queue, else the oldest of another
+int walk_pop (uint32_t thread, walk_dir *dir)
+{
+	walk_queue *q;
+	uint32_t n;
+
+	for (n = 0; n < walk_threads; n++) {
+		q = &walk_queues[(thread + n) % walk_threads];
+		pthread_mutex_lock (&q->lock);
+
+		if (q->used) {
+			if (! n) {
+				*dir = q->dirs[(q->head + q->used - 1) % q->size];
+
+			} else {
+				*dir = q->dirs[q->head];
+				q->head = (q->head + 1) % q->size;
+			}
+
+			q->used--;
+			pthread_mutex_unlock (&q->lock);
+			return 1;
+		}
+
+		pthread_mutex_unlock (&q->lock);
+	}
+
+	return 0;
+}
+
+// hands a file to the conversion loop, waits while it is behind
+void walk_found (char *path)
+{
+	pthread_mutex_lock (&walk_files_lock);
+
+	while (walk_used == WALK_FILES) {
+		pthread_cond_wait (&walk_files_space, &walk_files_lock);
+	}
+
+	walk_files[(walk_head + walk_used) % WALK_FILES] = path;
+	walk_used++;
+	pthread_cond_signal (&walk_files_ready);
+	pthread_mutex_unlock (&walk_files_lock);
+}
+
+// looks at one entry of a folder
+void walk_entry (uint32_t thread, int dirfd, const char *path, const char *name, unsigned char type)
+{
+	struct stat st;
+	char *full;
+	size_t len;
+	int fd = -1;
+	int open_fds;
+
+	if ((strcmp (name, ".") == 0) || (strcmp (name, "..") == 0)) {
+		return;
+	}
+
+	if ((type == DT_UNKNOWN) || (type == DT_LNK)) {
+		// links are followed to files, never to folders, which could loop
+		if (fstatat (dirfd, name, &st, (type == DT_LNK) ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+			return;
+		}
+
+		type = S_ISDIR (st.st_mode) ? ((type == DT_LNK) ? DT_LNK : DT_DIR) : (S_ISREG (st.st_mode) ? DT_REG : DT_UNKNOWN);
+	}
+
+	if ((type != DT_DIR) && (type != DT_REG)) {
+		return;
+	}
+
+	len = strlen (path) + strlen (name) + 2;
+	full = (char *) malloc (len);
+
+	if (! full) {
+		return;
+	}
+
+	snprintf (full, len, "%s/%s", path, name);
+
+	if (walk_match (walk_exclude, walk_excludes, full + strlen (walk_root) + 1, name)) {
+		free (full);
+		return;
+	}
+
+	if (type == DT_REG) {
+		len = strlen (name);
+
+		if (walk_includes ? walk_match (walk_include, walk_includes, full + strlen (walk_root) + 1, name)
+			: ((len > strlen (walk_ext)) && (strcasecmp (name + len - strlen (walk_ext), walk_ext) == 0))) {
+			walk_found (full);
+
+		} else {
+			free (full);
+		}
+
+		return;
+	}
+
+	pthread_mutex_lock (&walk_lock);
+	open_fds = walk_fds;
+	pthread_mutex_unlock (&walk_lock);
+
+	if (open_fds < WALK_FDS) {
+		fd = openat (dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	}
+
+	walk_push (thread, fd, full);
+}
+
+// reads one folder
+void walk_read (uint32_t thread, walk_dir *dir)
+{
+	int fd = (dir->fd >= 0) ? dir->fd : open (dir->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+	if (fd < 0) {
+		fprintf (stderr, "\n-r: can't open %s\n", dir->path);
+		return;
+	}
+
+#ifdef __linux__
+	{
+		// the layout of the records getdents64 returns
+		struct walk_dirent {
+			uint64_t d_ino;
+			int64_t d_off;
+			unsigned short d_reclen;
+			unsigned char d_type;
+			char d_name[];
+		} *ent;
+		char buffer[32 * 1024] __attribute__ ((aligned (8)));
+		long len, pos;
+
+		while ((len = syscall (SYS_getdents64, fd, buffer, sizeof (buffer))) > 0) {
+			for (pos = 0; pos < len; pos += ent->d_reclen) {
+				ent = (struct walk_dirent *) (buffer + pos);
+				walk_entry (thread, fd, dir->path, ent->d_name, ent->d_type);
+			}
+		}
+
+		close (fd);
+	}
+#else
+	{
+		struct dirent *ent;
+		DIR *dp = fdopendir (fd);
+
+		if (! dp) {
+			close (fd);
+			return;
+		}
+
+		while ((ent = readdir (dp))) {
+			walk_entry (thread, dirfd (dp), dir->path, ent->d_name, ent->d_type);
+		}
+
+		closedir (dp);
+	}
+#endif
+}
+
+void *walk_thread (void *arg)
+{
+	uint32_t thread = (uint32_t) (uintptr_t) arg;
+	walk_dir dir;
+
+	while (1) {
+		if (walk_pop (thread, &dir)) {
+			pthread_mutex_lock (&walk_lock);
+			walk_fds -= (dir.fd >= 0);
+			pthread_mutex_unlock (&walk_lock);
+
+			walk_read (thread, &dir);
+			free (dir.path);
+
+			pthread_mutex_lock (&walk_lock);
+
+			if (! --walk_pending) {
+				pthread_cond_broadcast (&walk_work); // all done
+			}
+
+			pthread_mutex_unlock (&walk_lock);
+			continue;
+		}
+
+		// nothing to take: wait for more, or stop when nobody has any
+		pthread_mutex_lock (&walk_lock);
+
+		if (! walk_pending) {
+			pthread_mutex_unlock (&walk_lock);
+			break;
+		}
+
+		pthread_cond_wait (&walk_work, &walk_lock);
+		pthread_mutex_unlock (&walk_lock);
+	}
+
+	pthread_mutex_lock (&walk_files_lock);
+	walk_done++;
+	pthread_cond_signal (&walk_files_ready);
+	pthread_mutex_unlock (&walk_files_lock);
+	return NULL;
+}
+
+// starts walking, if -r was given. ext is the input type of the utility.
+void walk_start (const char *ext)
+{
+	pthread_t thread;
+	long cpus;
+	uint32_t n;
+	size_t len;
+
+	if (! walk_root) {
+		return;
+	}
+
+	// no trailing slashes, the paths below are made from it
+	for (len = strlen (walk_root); (len > 1) && (walk_root[len - 1] == '/'); len--) {
+		walk_root[len - 1] = 0;
+	}
+
+	walk_ext = ext;
+	cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	walk_threads = ((cpus > 0) && (cpus < WALK_THREADS)) ? cpus : WALK_THREADS;
+
+	for (n = 0; n < walk_threads; n++) {
+		pthread_mutex_init (&walk_queues[n].lock, NULL);
+	}
+
+	walk_push (0, -1, strdup (walk_root));
+
+	for (n = 0; n < walk_threads; n++) {
+		if (pthread_create (&thread, NULL, walk_thread, (void *) (uintptr_t) n) != 0) {
+			break;
+		}
+
+		pthread_detach (thread);
+	}
+
+	if (! n) {
+		fprintf (stderr, "\n-r: can't start a thread\n");
+		walk_root = NULL;
+	}
+
+	pthread_mutex_lock (&walk_files_lock);
+	walk_running = n;
+	pthread_mutex_unlock (&walk_files_lock);
+}
+
+// the next file found, 0 when there are no more
+int walk_next (char *filename, int limit)
+{
+	char *path;
+
+	pthread_mutex_lock (&walk_files_lock);
+
+	while ((! walk_used) && (walk_done < walk_running)) {
+		pthread_cond_wait (&walk_files_ready, &walk_files_lock);
+	}
+
+	if (! walk_used) {
+		pthread_mutex_unlock (&walk_files_lock);
+		return 0;
+	}
+
+	path = walk_files[walk_head];
+	walk_head = (walk_head + 1) % WALK_FILES;
+	walk_used--;
+	pthread_cond_signal (&walk_files_space);
+	pthread_mutex_unlock (&walk_files_lock);
+
+	snprintf (filename, limit, "%s", path);
+	free (path);
+	return 1;
+}
+
+// with --out, moves an output file name from the walked tree to the same
+// place in the --out tree, and makes the folders it needs
+void walk_mirror (char *outfile, int limit)
+{
+	char path[bufsz];
+	size_t root = (walk_root ? strlen (walk_root) : 0);
+	char *p;
+
+	if ((! walk_root) || (! walk_out) || (strncmp (outfile, walk_root, root) != 0) || (outfile[root] != '/')) {
+		return;
+	}
+
+	snprintf (path, bufsz, "%s%s", walk_out, outfile + root);
+
+	for (p = path + 1; (p = strchr (p, '/')); p++) {
+		*p = 0;
+		mkdir (path, 0777); // fails harmlessly if it is there
+		*p = '/';
+	}
+
+	snprintf (outfile, limit, "%s", path);
+}
+
+#else // windows: no -r, the names still come from stdin
+
+void walk_start (const char *ext)
+{
+	(void) ext;
+
+	if (walk_root) {
+		fprintf (stderr, "\n-r is not supported on windows\n");
+		fflush (stderr);
+		walk_root = NULL;
+	}
+}
+
+int walk_next (char *filename, int limit)
+{
+	(void) filename;
+	(void) limit;
+	return 0;
+}
+
+void walk_mirror (char *outfile, int limit)
+{
+	(void) outfile;
+	(void) limit;
+}
+
+#endif